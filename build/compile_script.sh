@@ -76,11 +76,11 @@ LDFLAGS="-mthumb -mthumb-interwork -mcpu=arm7tdmi -nostartfiles"
 LDFLAGS="$LDFLAGS -T$LDSCRIPT"
 
 # Source files by component
-CORE_FILES="$CORE_DIR/main.c $CORE_DIR/syscalls.c"
+CORE_FILES="$CORE_DIR/main.c $CORE_DIR/display_compositor.c $CORE_DIR/vblank_queue.c $CORE_DIR/memory_system.c $CORE_DIR/crc32.c $CORE_DIR/save_flash.c $CORE_DIR/save_media.c $CORE_DIR/syscalls.c"
 MENU_FILES="$MENU_DIR/menu_system.c $MENU_DIR/menu_definitions.c"
-QR_FILES="$QR_DIR/qr_system.c $QR_DIR/qr_rendering.c $QR_DIR/qr_encoder.c $QR_DIR/reed_solomon.c"
-WALLET_FILES="$WALLET_DIR/wallet_system.c $WALLET_DIR/wallet_menu.c $WALLET_DIR/wallet_menu_ext_stub.c $WALLET_DIR/crypto_types.c"
-PROTECTION_FILES="$PROTECTION_DIR/qr_protection.c $PROTECTION_DIR/qr_protection_menu.c $PROTECTION_DIR/qr_protection_integration.c"
+QR_FILES="$QR_DIR/qr_system.c $QR_DIR/qr_rendering.c $QR_DIR/qr_tile_renderer.c $QR_DIR/qr_affine_renderer.c $QR_DIR/qr_sprite_renderer.c $QR_DIR/qr_scanline_renderer.c $QR_DIR/qr_encoder.c $QR_DIR/reed_solomon.c"
+WALLET_FILES="$WALLET_DIR/wallet_system.c $WALLET_DIR/wallet_record.c $WALLET_DIR/wallet_address.c $WALLET_DIR/wallet_storage.c $WALLET_DIR/wallet_log.c $WALLET_DIR/wallet_search.c $WALLET_DIR/wallet_menu.c $WALLET_DIR/wallet_menu_ext_stub.c $WALLET_DIR/crypto_types.c"
+PROTECTION_FILES="$PROTECTION_DIR/qr_protection.c $PROTECTION_DIR/qr_protection_menu.c $PROTECTION_DIR/qr_protection_integration.c $PROTECTION_DIR/qr_protection_display.c $PROTECTION_DIR/qr_protection_atlas.c $PROTECTION_DIR/qr_protection_palette.c $PROTECTION_DIR/qr_protection_delta.c $PROTECTION_DIR/qr_protection_settings.c"
 DEBUG_FILES="$DEBUG_DIR/qr_debug.c"
 
 # All source files
@@ -141,3 +141,23 @@ if [ -f "$BUILD_DIR/$PROJECT.gba" ]; then
     echo ""
     echo "You can now run this ROM in a GBA emulator!"
 fi
+
+# Show per-section memory usage against the IWRAM and EWRAM limits
+echo ""
+echo "Memory usage:"
+arm-none-eabi-size -A -d "$BUILD_DIR/$PROJECT.elf" | awk '
+    $3 >= 50331648 && $3 < 50364416 { region = "IWRAM" }
+    $3 >= 33554432 && $3 < 33816576 { region = "EWRAM" }
+    $3 >= 134217728 && $3 < 167772160 { region = "ROM" }
+    $3 == "" || $2 == 0 || region == "" { region = ""; next }
+    {
+        printf "  %-6s %-16s %8d bytes\n", region, $1, $2
+        used[region] += $2
+        region = ""
+    }
+    END {
+        printf "  IWRAM total: %6d / 32768 bytes (stack not included)\n", used["IWRAM"]
+        printf "  EWRAM total: %6d / 262144 bytes\n", used["EWRAM"]
+        if (used["IWRAM"] > 32768) print "  WARNING: IWRAM overflow"
+        if (used["EWRAM"] > 262144) print "  WARNING: EWRAM overflow"
+    }'
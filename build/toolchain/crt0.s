@@ -39,6 +39,11 @@ start_vector:
 	msr	cpsr, r0
 	ldr	sp, =__sp_usr
 
+	@ ROM wait states and prefetch (GBA_WAITCNT_SETUP in gba_sections.h)
+	ldr	r0, =0x04000204
+	ldr	r1, =0x4317
+	strh	r1, [r0]
+
 	@ Clear BSS section
 	ldr	r0, =__bss_start__
 	ldr	r1, =__bss_end__
@@ -58,6 +63,25 @@ start_vector:
 	strlt	r3, [r0], #4
 	blt	.copy_data
 
+	@ Copy IWRAM code and data from ROM
+	ldr	r0, =__iwram_start
+	ldr	r1, =__iwram_end
+	ldr	r2, =__iwram_lma
+.copy_iwram:
+	cmp	r0, r1
+	ldrlt	r3, [r2], #4
+	strlt	r3, [r0], #4
+	blt	.copy_iwram
+
+	@ Clear IWRAM BSS
+	ldr	r0, =__iwram_bss_start
+	ldr	r1, =__iwram_bss_end
+	mov	r2, #0
+.clear_iwram_bss:
+	cmp	r0, r1
+	strlt	r2, [r0], #4
+	blt	.clear_iwram_bss
+
 	@ Jump to main
 	ldr	r0, =main
 	bx	r0
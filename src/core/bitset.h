@@ -0,0 +1,87 @@
+/**
+ * @file bitset.h
+ * @brief Fixed-size bit sets kept in arrays of u32 words
+ *
+ * Bit i lives in word i / 32 at position i % 32. Callers own the storage
+ * (declare it with BITSET_WORDS) and pass the number of bits they use.
+ *
+ * @author Claude
+ * @date October 2026
+ * @version 1.0.0
+ */
+
+ #ifndef BITSET_H
+ #define BITSET_H
+
+ #include <tonc.h>
+ #include <string.h>
+
+ #define BITSET_WORDS(bits)  (((bits) + 31) / 32)
+ #define BITSET_MASK(n)      ((1u << (n)) - 1)      // Bits 0 to n - 1, n < 32
+
+ static inline bool bitset_test(const u32 *set, u32 bit) {
+     return (set[bit >> 5] >> (bit & 31)) & 1;
+ }
+
+ static inline void bitset_set(u32 *set, u32 bit) {
+     set[bit >> 5] |= (1u << (bit & 31));
+ }
+
+ static inline void bitset_clear(u32 *set, u32 bit) {
+     set[bit >> 5] &= ~(1u << (bit & 31));
+ }
+
+ static inline void bitset_clear_all(u32 *set, u32 bits) {
+     memset(set, 0, BITSET_WORDS(bits) * sizeof(u32));
+ }
+
+ /**
+  * Set bits 0 to count - 1 and clear the rest
+  */
+ static inline void bitset_set_first(u32 *set, u32 bits, u32 count) {
+     for (u32 w = 0; w < BITSET_WORDS(bits); w++) {
+         u32 base = w * 32;
+         set[w] = count >= base + 32 ? 0xFFFFFFFFu : count > base ? BITSET_MASK(count - base) : 0;
+     }
+ }
+
+ /**
+  * Whether any of bits 0 to count - 1 is set
+  */
+ static inline bool bitset_any_first(const u32 *set, u32 count) {
+     for (u32 w = 0; w * 32 < count; w++) {
+         u32 mask = count >= w * 32 + 32 ? 0xFFFFFFFFu : BITSET_MASK(count - w * 32);
+         if (set[w] & mask) return true;
+     }
+     return false;
+ }
+
+ /**
+  * Number of set bits among bits 0 to count - 1
+  */
+ static inline u32 bitset_count_first(const u32 *set, u32 count) {
+     u32 total = 0;
+
+     for (u32 w = 0; w * 32 < count; w++) {
+         u32 mask = count >= w * 32 + 32 ? 0xFFFFFFFFu : BITSET_MASK(count - w * 32);
+         total += __builtin_popcount(set[w] & mask);
+     }
+     return total;
+ }
+
+ /**
+  * Remove a bit, moving every bit above it down by one
+  * Follows an array element being removed; the top bit becomes clear
+  */
+ static inline void bitset_remove(u32 *set, u32 bits, u32 bit) {
+     u32 w = bit >> 5;
+     u32 below = set[w] & BITSET_MASK(bit & 31);
+
+     set[w] = below | ((set[w] >> 1) & ~BITSET_MASK(bit & 31));
+     for (w++; w < BITSET_WORDS(bits); w++) {
+         set[w - 1] |= set[w] << 31;
+         set[w] >>= 1;
+     }
+ }
+
+ #endif // BITSET_H
@@ -0,0 +1,55 @@
+/**
+ * @file crc32.c
+ * @brief Table-driven CRC-32 (IEEE 802.3, reflected, polynomial 0xEDB88320)
+ *
+ * The table is computed at boot rather than stored in ROM: reading a word
+ * from ROM takes two 16-bit accesses with wait states, from IWRAM one
+ * cycle.
+ *
+ * @author Claude
+ * @date October 2026
+ * @version 1.0.0
+ */
+
+ #include <tonc.h>
+ #include "crc32.h"
+ #include "gba_sections.h"
+
+ #define CRC32_POLYNOMIAL    0xEDB88320u
+
+ IWRAM_BSS static u32 s_crc32_table[256];
+
+ /**
+  * @brief Build the lookup table
+  */
+ void crc32_init(void) {
+     for (u32 i = 0; i < 256; i++) {
+         u32 crc = i;
+         for (int bit = 0; bit < 8; bit++) {
+             crc = (crc & 1) ? (crc >> 1) ^ CRC32_POLYNOMIAL : crc >> 1;
+         }
+         s_crc32_table[i] = crc;
+     }
+ }
+
+ /**
+  * @brief Add bytes to a running CRC
+  *
+  * Runs from IWRAM as ARM code; save loads checksum every byte they read.
+  */
+ IWRAM_CODE u32 crc32_update(u32 crc, const void *data, u32 len) {
+     const u8 *p = data;
+
+     while (len--) {
+         crc = s_crc32_table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+     }
+
+     return crc;
+ }
+
+ /**
+  * @brief CRC-32 of a single buffer
+  */
+ u32 crc32(const void *data, u32 len) {
+     return CRC32_FINISH(crc32_update(CRC32_START, data, len));
+ }
@@ -0,0 +1,45 @@
+/**
+ * @file crc32.h
+ * @brief Table-driven CRC-32 (IEEE 802.3, reflected, polynomial 0xEDB88320)
+ *
+ * Used to validate save data. The 1 KB table lives in IWRAM and the update
+ * loop runs from IWRAM as ARM code, so one byte costs a lookup, a shift
+ * and an XOR.
+ *
+ * @author Claude
+ * @date October 2026
+ * @version 1.0.0
+ */
+
+ #ifndef CRC32_H
+ #define CRC32_H
+
+ #include <tonc.h>
+ #include "gba_sections.h"
+
+ /**
+  * Start value of a running CRC; pass the result through CRC32_FINISH
+  */
+ #define CRC32_START         0xFFFFFFFFu
+ #define CRC32_FINISH(crc)   ((crc) ^ 0xFFFFFFFFu)
+
+ /**
+  * Build the lookup table; call once at boot before any other crc32 call
+  */
+ void crc32_init(void);
+
+ /**
+  * Add bytes to a running CRC
+  * @param crc Running CRC (CRC32_START for the first block)
+  * @param data Bytes to add
+  * @param len Number of bytes
+  * @return Updated running CRC
+  */
+ IWRAM_CODE u32 crc32_update(u32 crc, const void *data, u32 len);
+
+ /**
+  * CRC-32 of a single buffer
+  */
+ u32 crc32(const void *data, u32 len);
+
+ #endif // CRC32_H
@@ -0,0 +1,310 @@
+/**
+ * @file display_compositor.c
+ * @brief Central owner of the video mode, layers and VRAM blocks
+ *
+ * Display state used to be written from many places (menu init, each QR
+ * renderer, the page-flip display), and every screen transition redrew
+ * and re-uploaded everything because nobody knew what was still in VRAM.
+ *
+ * The compositor keeps:
+ * - a shadow of REG_DISPCNT and REG_BG0CNT-REG_BG3CNT, written together
+ *   by display_compositor_vblank() at the start of VBlank
+ * - reservations: screen blocks with a fixed purpose, which
+ *   display_free_blocks() never hands to anyone else
+ * - contents: the owner whose data each screen block and OBJ tile chunk
+ *   currently holds, updated by claims
+ *
+ * @author Claude
+ * @date October 2026
+ * @version 1.0.0
+ */
+
+ #include <tonc.h>
+ #include <string.h>
+ #include "display_compositor.h"
+ #include "menu_system.h"
+ #include "qr_system.h"
+ #include "qr_debug.h"
+
+ // Menu background screen blocks (see menu_sprite.h and menu_init_graphics)
+ #define DISPLAY_MENU_CHAR_BLOCK     1
+ #define DISPLAY_MENU_BLOCKS         (BIT(28) | BIT(29))
+
+ // Bytes of VRAM per screen block, and where OBJ tiles start
+ #define DISPLAY_BLOCK_BYTES         0x800
+ #define DISPLAY_OBJ_VRAM_OFFSET     0x10000
+
+ /**
+  * Compositor state
+  */
+ typedef struct {
+     u16 dispcnt;                            // Pending REG_DISPCNT
+     u16 bgcnt[4];                           // Pending REG_BG0CNT-REG_BG3CNT
+     bool dirty;                             // Pending values not written yet
+     u8 reserved[32];                        // Fixed purpose of each screen block
+     u8 block_owner[32];                     // Whose data each screen block holds
+     u8 obj_owner[DISPLAY_OBJ_CHUNKS];       // Whose data each OBJ tile chunk holds
+ } DisplayCompositor;
+
+ static DisplayCompositor s_compositor;
+
+ /**
+  * @brief Mark screen blocks as reserved for an owner
+  */
+ static void display_reserve(DisplayOwner owner, u32 blocks) {
+     for (int sbb = 0; sbb < 32; sbb++) {
+         if (blocks & BIT(sbb)) {
+             s_compositor.reserved[sbb] = owner;
+         }
+     }
+ }
+
+ /**
+  * @brief Initialize the compositor and reserve the fixed screen blocks
+  *
+  * Nothing is assumed to be in VRAM yet, so every owner's first claim
+  * reports its data as lost.
+  */
+ void display_compositor_init(void) {
+     memset(&s_compositor, 0, sizeof(s_compositor));
+
+     display_reserve(DISPLAY_OWNER_TEXT,
+                     DISPLAY_CBB_BLOCKS(TEXT_CHAR_BLOCK) | BIT(TEXT_SCREEN_BLOCK));
+     display_reserve(DISPLAY_OWNER_MENU,
+                     DISPLAY_CBB_BLOCKS(DISPLAY_MENU_CHAR_BLOCK) | DISPLAY_MENU_BLOCKS);
+     display_reserve(DISPLAY_OWNER_QR_TILES, BIT(QR_TILE_SCREEN_BLOCK));
+     display_reserve(DISPLAY_OWNER_QR_AFFINE,
+                     BIT(QR_AFFINE_CHAR_BLOCK * 8) | BIT(QR_AFFINE_CHAR_BLOCK * 8 + 1) |
+                     BIT(QR_AFFINE_SCREEN_BLOCK));
+
+     // Keep the screen blank until the first screen is committed
+     s_compositor.dispcnt = DCNT_BLANK;
+     s_compositor.dirty = true;
+
+     LOG_INFO(MODULE_SYSTEM, "Display compositor initialized", 0);
+ }
+
+ /**
+  * @brief Switch to a screen at the next VBlank
+  *
+  * The screen's layers replace the whole pending layout, including any
+  * window the previous screen enabled. Every layer's VRAM is claimed for
+  * its owner; owners whose data was overwritten since they last held it
+  * are reported so the caller re-uploads only those.
+  *
+  * @param screen Screen layout
+  * @return Bit mask (BIT(owner)) of owners whose VRAM must be re-uploaded
+  */
+ u32 display_show(const DisplayScreen *screen) {
+     u32 lost = 0;
+     u16 dispcnt = screen->mode;
+
+     for (int bg = 0; bg < 4; bg++) {
+         const DisplayBgLayer *layer = &screen->bg[bg];
+         if (layer->owner == DISPLAY_OWNER_NONE) continue;
+
+         dispcnt |= DCNT_BG0 << bg;
+         s_compositor.bgcnt[bg] = layer->control;
+
+         if (!display_claim(layer->owner, layer->blocks)) {
+             lost |= BIT(layer->owner);
+         }
+     }
+
+     if (screen->obj_owner != DISPLAY_OWNER_NONE) {
+         dispcnt |= DCNT_OBJ | DCNT_OBJ_1D;
+
+         if (!display_claim_obj(screen->obj_owner, screen->obj_first, screen->obj_count)) {
+             lost |= BIT(screen->obj_owner);
+         }
+     }
+
+     s_compositor.dispcnt = dispcnt;
+     s_compositor.dirty = true;
+
+     LOG_INFO(MODULE_SYSTEM, screen->name, lost);
+     return lost;
+ }
+
+ /**
+  * @brief Write the pending display registers
+  *
+  * Must run at the start of VBlank, after the other VBlank steps (page
+  * flips, screen-base switches) have updated the pending layout, so the
+  * whole change becomes visible on the same frame.
+  */
+ void display_compositor_vblank(void) {
+     if (!s_compositor.dirty) return;
+
+     REG_BG0CNT = s_compositor.bgcnt[0];
+     REG_BG1CNT = s_compositor.bgcnt[1];
+     REG_BG2CNT = s_compositor.bgcnt[2];
+     REG_BG3CNT = s_compositor.bgcnt[3];
+     REG_DISPCNT = s_compositor.dispcnt;
+
+     s_compositor.dirty = false;
+ }
+
+ /**
+  * @brief Pending REG_DISPCNT value
+  */
+ u16 display_dispcnt(void) {
+     return s_compositor.dispcnt;
+ }
+
+ /**
+  * @brief Change the video mode at the next VBlank
+  */
+ void display_set_mode(u16 mode) {
+     u16 dispcnt = (s_compositor.dispcnt & ~DCNT_MODE_MASK) | mode;
+     if (dispcnt == s_compositor.dispcnt) return;
+
+     s_compositor.dispcnt = dispcnt;
+     s_compositor.dirty = true;
+ }
+
+ /**
+  * @brief Enable display control bits at the next VBlank
+  */
+ void display_enable(u16 flags) {
+     if ((s_compositor.dispcnt & flags) == flags) return;
+
+     s_compositor.dispcnt |= flags;
+     s_compositor.dirty = true;
+ }
+
+ /**
+  * @brief Disable display control bits at the next VBlank
+  */
+ void display_disable(u16 flags) {
+     if (!(s_compositor.dispcnt & flags)) return;
+
+     s_compositor.dispcnt &= ~flags;
+     s_compositor.dirty = true;
+ }
+
+ /**
+  * @brief Set a background control register at the next VBlank
+  */
+ void display_set_bg(int bg, u16 control) {
+     if (bg < 0 || bg > 3 || s_compositor.bgcnt[bg] == control) return;
+
+     s_compositor.bgcnt[bg] = control;
+     s_compositor.dirty = true;
+ }
+
+ /**
+  * @brief Pending BGxCNT value of a background
+  */
+ u16 display_bg(int bg) {
+     return (bg >= 0 && bg <= 3) ? s_compositor.bgcnt[bg] : 0;
+ }
+
+ /**
+  * @brief Show the other Mode 4/5 page at the next VBlank
+  */
+ void display_flip_page(void) {
+     s_compositor.dispcnt ^= DCNT_PAGE;
+     s_compositor.dirty = true;
+ }
+
+ /**
+  * @brief Blank the screen immediately while VRAM is rewritten
+  *
+  * For setups that overwrite VRAM the current screen still shows.
+  * The next VBlank writes the pending layout, which ends the blank.
+  */
+ void display_blank_now(void) {
+     REG_DISPCNT |= DCNT_BLANK;
+     s_compositor.dirty = true;
+ }
+
+ /**
+  * @brief Record that an owner now holds screen blocks
+  *
+  * @return True if the owner already held every block (data intact)
+  */
+ bool display_claim(DisplayOwner owner, u32 blocks) {
+     bool intact = true;
+
+     for (int sbb = 0; sbb < 32; sbb++) {
+         if (!(blocks & BIT(sbb))) continue;
+
+         if (s_compositor.block_owner[sbb] != owner) {
+             s_compositor.block_owner[sbb] = owner;
+             intact = false;
+         }
+     }
+
+     return intact;
+ }
+
+ /**
+  * @brief Record that an owner now holds OBJ tiles
+  *
+  * @return True if the owner already held every tile (data intact)
+  */
+ bool display_claim_obj(DisplayOwner owner, int first, int count) {
+     bool intact = true;
+
+     if (count <= 0) return true;
+
+     int last = (first + count - 1) / DISPLAY_OBJ_CHUNK_TILES;
+     if (last >= DISPLAY_OBJ_CHUNKS) last = DISPLAY_OBJ_CHUNKS - 1;
+
+     for (int chunk = first / DISPLAY_OBJ_CHUNK_TILES; chunk <= last; chunk++) {
+         if (s_compositor.obj_owner[chunk] != owner) {
+             s_compositor.obj_owner[chunk] = owner;
+             intact = false;
+         }
+     }
+
+     return intact;
+ }
+
+ /**
+  * @brief Record that an owner wrote a byte range of VRAM
+  *
+  * Ranges past the background area (Mode 3 and Mode 4 page 1) also
+  * claim the OBJ tiles they cover.
+  */
+ void display_claim_vram(DisplayOwner owner, u32 offset, u32 size) {
+     if (size == 0) return;
+
+     u32 end = offset + size;
+
+     if (offset < DISPLAY_OBJ_VRAM_OFFSET) {
+         u32 last = ((end < DISPLAY_OBJ_VRAM_OFFSET ? end : DISPLAY_OBJ_VRAM_OFFSET) - 1) /
+                    DISPLAY_BLOCK_BYTES;
+         u32 first = offset / DISPLAY_BLOCK_BYTES;
+         u32 blocks = (last >= 31 ? 0xFFFFFFFFu : (BIT(last + 1) - 1)) & ~(BIT(first) - 1);
+         display_claim(owner, blocks);
+     }
+
+     if (end > DISPLAY_OBJ_VRAM_OFFSET) {
+         u32 start = (offset > DISPLAY_OBJ_VRAM_OFFSET ? offset : DISPLAY_OBJ_VRAM_OFFSET) -
+                     DISPLAY_OBJ_VRAM_OFFSET;
+         u32 first = start / 32;
+         display_claim_obj(owner, first, (end - DISPLAY_OBJ_VRAM_OFFSET + 31) / 32 - first);
+     }
+ }
+
+ /**
+  * @brief Screen blocks that an owner may use for data of its own
+  *
+  * @return Candidates not reserved by any other owner
+  */
+ u32 display_free_blocks(DisplayOwner owner, u32 candidates) {
+     u32 free = 0;
+
+     for (int sbb = 0; sbb < 32; sbb++) {
+         if (!(candidates & BIT(sbb))) continue;
+
+         if (s_compositor.reserved[sbb] == DISPLAY_OWNER_NONE ||
+             s_compositor.reserved[sbb] == owner) {
+             free |= BIT(sbb);
+         }
+     }
+
+     return free;
+ }
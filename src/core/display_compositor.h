@@ -0,0 +1,167 @@
+/**
+ * @file display_compositor.h
+ * @brief Central owner of the video mode, layers and VRAM blocks
+ *
+ * Screens declare the layers they show and the VRAM their layers need
+ * instead of writing REG_DISPCNT and the BG control registers directly.
+ * The compositor keeps a shadow copy of those registers and writes them
+ * together at the start of VBlank, so a mode switch never lands mid-frame.
+ *
+ * It also records which owner last filled each screen block and OBJ tile
+ * range. A claim reports whether the owner's data is still there, so a
+ * screen only re-uploads what another screen actually overwrote.
+ *
+ * @author Claude
+ * @date October 2026
+ * @version 1.0.0
+ */
+
+ #ifndef DISPLAY_COMPOSITOR_H
+ #define DISPLAY_COMPOSITOR_H
+
+ #include <tonc.h>
+
+ /**
+  * Owners of VRAM contents
+  */
+ typedef enum {
+     DISPLAY_OWNER_NONE = 0,
+     DISPLAY_OWNER_TEXT,         // TTE font (CBB 0) and map (SBB 30)
+     DISPLAY_OWNER_MENU,         // Menu background (CBB 1, SBB 28/29) and cursor sprite
+     DISPLAY_OWNER_QR_TILES,     // QR tile set (CBB 2), its maps (SBB 26, atlas maps)
+     DISPLAY_OWNER_QR_AFFINE,    // Affine QR tiles (SBB 24/25) and map (SBB 27)
+     DISPLAY_OWNER_QR_SPRITES,   // QR overlay sprite tiles
+     DISPLAY_OWNER_BITMAP,       // Mode 3/4 framebuffer pixels
+     DISPLAY_OWNER_COUNT
+ } DisplayOwner;
+
+ /**
+  * OBJ tiles are tracked in chunks of this many 4bpp tiles
+  */
+ #define DISPLAY_OBJ_CHUNK_TILES 16
+ #define DISPLAY_OBJ_CHUNKS      (1024 / DISPLAY_OBJ_CHUNK_TILES)
+
+ /**
+  * Screen blocks covered by a char block
+  */
+ #define DISPLAY_CBB_BLOCKS(cbb) (0xFFu << ((cbb) * 8))
+
+ /**
+  * Background layer declared by a screen
+  */
+ typedef struct {
+     DisplayOwner owner;         // Whose data the layer shows (NONE = layer off)
+     u16 control;                // BGxCNT value
+     u32 blocks;                 // Screen blocks holding its tiles and map
+ } DisplayBgLayer;
+
+ /**
+  * Layers of a screen
+  */
+ typedef struct {
+     const char *name;           // For the log
+     u16 mode;                   // DCNT_MODE0..DCNT_MODE5
+     DisplayBgLayer bg[4];       // Backgrounds 0-3
+     DisplayOwner obj_owner;     // Owner of the sprite tiles (NONE = no sprites)
+     u16 obj_first;              // First OBJ tile the sprites use
+     u16 obj_count;              // Number of OBJ tiles the sprites use
+ } DisplayScreen;
+
+ /**
+  * Initialize the compositor and reserve the fixed screen blocks
+  */
+ void display_compositor_init(void);
+
+ /**
+  * Switch to a screen at the next VBlank
+  * Claims the VRAM of every declared layer
+  * @param screen Screen layout
+  * @return Bit mask (BIT(owner)) of owners whose VRAM must be re-uploaded
+  */
+ u32 display_show(const DisplayScreen *screen);
+
+ /**
+  * Write the pending display registers; call at the start of VBlank
+  * after every other VBlank step has updated the layout
+  */
+ void display_compositor_vblank(void);
+
+ /**
+  * Pending REG_DISPCNT value (what the screen will show after VBlank)
+  */
+ u16 display_dispcnt(void);
+
+ /**
+  * Change the video mode at the next VBlank
+  * @param mode DCNT_MODE0..DCNT_MODE5
+  */
+ void display_set_mode(u16 mode);
+
+ /**
+  * Enable display control bits (layers, windows, OBJ mapping) at the next VBlank
+  */
+ void display_enable(u16 flags);
+
+ /**
+  * Disable display control bits at the next VBlank
+  */
+ void display_disable(u16 flags);
+
+ /**
+  * Set a background control register at the next VBlank
+  * @param bg Background 0-3
+  * @param control BGxCNT value
+  */
+ void display_set_bg(int bg, u16 control);
+
+ /**
+  * Pending BGxCNT value of a background
+  */
+ u16 display_bg(int bg);
+
+ /**
+  * Show the other Mode 4/5 page at the next VBlank
+  */
+ void display_flip_page(void);
+
+ /**
+  * Blank the screen immediately while VRAM is rewritten
+  * The next VBlank shows the pending layout again
+  */
+ void display_blank_now(void);
+
+ /**
+  * Record that an owner now holds screen blocks
+  * @param owner New owner
+  * @param blocks Screen block mask (bit n = SBB n)
+  * @return True if the owner already held every block (data intact)
+  */
+ bool display_claim(DisplayOwner owner, u32 blocks);
+
+ /**
+  * Record that an owner now holds OBJ tiles
+  * @param owner New owner
+  * @param first First OBJ tile
+  * @param count Number of tiles
+  * @return True if the owner already held every tile (data intact)
+  */
+ bool display_claim_obj(DisplayOwner owner, int first, int count);
+
+ /**
+  * Record that an owner wrote a byte range of VRAM
+  * Covers screen blocks and OBJ tiles, for bitmap framebuffers
+  * @param owner New owner
+  * @param offset Byte offset from the start of VRAM
+  * @param size Size in bytes
+  */
+ void display_claim_vram(DisplayOwner owner, u32 offset, u32 size);
+
+ /**
+  * Screen blocks that an owner may use for data of its own
+  * @param owner Owner asking for space
+  * @param candidates Screen blocks to choose from
+  * @return Candidates not reserved by any other owner
+  */
+ u32 display_free_blocks(DisplayOwner owner, u32 candidates);
+
+ #endif // DISPLAY_COMPOSITOR_H
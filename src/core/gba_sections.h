@@ -0,0 +1,48 @@
+/**
+ * @file gba_sections.h
+ * @brief Code and data placement in IWRAM and EWRAM
+ *
+ * Everything is built as Thumb and runs from ROM, which has a 16-bit bus
+ * and wait states. Hot loops go to IWRAM (32-bit, no wait states) as ARM
+ * code; large buffers that don't need speed go to EWRAM.
+ *
+ * The sections are laid out by build/toolchain/gba_cart.ld and copied or
+ * cleared by crt0.s before main() runs. The build prints how much of
+ * IWRAM (32 KB) and EWRAM (256 KB) they use.
+ *
+ * @author Claude
+ * @date October 2026
+ * @version 1.0.0
+ */
+
+ #ifndef GBA_SECTIONS_H
+ #define GBA_SECTIONS_H
+
+ #include <tonc.h>
+
+ // libtonc's IWRAM_CODE leaves the instruction set to the compiler flags;
+ // this tree builds with -mthumb, so force ARM and keep the function out
+ // of line (inlined into a ROM caller it would run from ROM again)
+ #undef IWRAM_CODE
+ #define IWRAM_CODE  __attribute__((section(".iwram"), long_call, target("arm"), noinline))
+
+ // Initialized IWRAM data (separate from code to avoid section type conflicts)
+ #undef IWRAM_DATA
+ #define IWRAM_DATA  __attribute__((section(".iwram_data")))
+
+ // Zero-initialized IWRAM data (cleared at startup, not stored in ROM)
+ #define IWRAM_BSS   __attribute__((section(".iwram_bss")))
+
+ // EWRAM data and zero-initialized data (as in libtonc)
+ #undef EWRAM_DATA
+ #define EWRAM_DATA  __attribute__((section(".ewram")))
+ #undef EWRAM_BSS
+ #define EWRAM_BSS   __attribute__((section(".sbss")))
+
+ /**
+  * Wait state setup done by crt0.s: SRAM 8 cycles, ROM WS0 3/1 cycles,
+  * WS2 (flash/EEPROM) 8 cycles, prefetch buffer on
+  */
+ #define GBA_WAITCNT_SETUP   0x4317
+
+ #endif // GBA_SECTIONS_H
@@ -21,6 +21,12 @@
  #include "wallet_menu.h"
  #include "wallet_menu_ext.h"
  #include "qr_protection.h"
+ #include "display_compositor.h"
+ #include "vblank_queue.h"
+ #include "memory_system.h"
+ #include "crc32.h"
+ #include "save_media.h"
+ #include "wallet_storage.h"
  
  // Global QR system state (defined in qr_system.c)
  extern QrSystemState g_qr_state;
@@ -50,9 +56,19 @@
   * Initialize all system components
   */
  void initialize_systems(void) {
-     // Initialize interrupts
+     // Heap regions and the frame arena come first; everything else allocates from them
+     memory_init();
+     crc32_init();
+     
+     // Find the save chip before anything loads settings or the wallet
+     save_media_init();
+     
+     // Initialize interrupts; the VBlank handler drains the commit queue
      irq_init(NULL);
-     irq_add(II_VBLANK, NULL);
+     vblank_queue_init();
+     
+     // The compositor owns the display registers from here on
+     display_compositor_init();
      
      // Initialize menu system
      MenuSystem* menu = menu_system_get_instance();
@@ -80,6 +96,9 @@
      extern MenuItem main_menu;
      menu_system_set_active_menu(menu, &main_menu);
      
+     // Every boot-time pool and arena exists now; show what is left
+     memory_log_map();
+     
      LOG_INFO(MODULE_SYSTEM, "All systems initialized", 0);
  }
  
@@ -96,8 +115,19 @@
      
      // Main loop
      while (1) {
-         // Wait for vertical retrace (synchronize with screen refresh)
-         VBlankIntrWait();
+         // Wait for vertical retrace; queued VRAM/OAM writes land meanwhile
+         vblank_queue_wait();
+         
+         // Page flips, screen-base and palette switches must happen at the start of VBlank
+         qr_protection_display_vblank();
+         qr_protection_atlas_vblank();
+         qr_protection_palette_vblank();
+         
+         // Commit the layout those steps and the previous frame asked for
+         display_compositor_vblank();
+         
+         // Frame scratch from the previous frame must be released by now
+         memory_frame_end();
          
          // Update global frame counter
          g_qr_state.frame_counter++;
@@ -125,20 +155,37 @@
          // Always update QR protection system
          qr_protection_update();
          
-         // Render menu
-         menu_system_render(menu);
-         
-         // If we're in the QR menu, render it on top
-         if (menu->current_menu == &qr_menu) {
-             qr_menu_render();
+         // The page-flipped QR display owns VRAM while active
+         if (qr_protection_display_active()) {
+             qr_protection_display_idle();
+             continue;
          }
          
-         // If we're in the wallet menu, render it with enhancement
-         if (menu->current_menu == &wallet_menu) {
-             // Use enhanced render which includes QR protection
+         // The wallet QR screen is retained and redraws only what changed
+         if (menu->current_menu == &wallet_menu && wallet_qr_screen_active()) {
              enhanced_wallet_menu_render();
+         } else {
+             // Render menu
+             menu_system_render(menu);
+             
+             // If we're in the QR menu, render it on top
+             if (menu->current_menu == &qr_menu) {
+                 qr_menu_render();
+             }
+             
+             // If we're in the wallet menu, render it with enhancement
+             if (menu->current_menu == &wallet_menu) {
+                 // Use enhanced render which includes QR protection
+                 enhanced_wallet_menu_render();
+             }
          }
          
+         // Reclaim flash save space outside the save path (nothing to do on SRAM)
+         wallet_storage_idle();
+         
+         // Compact the wallet's record heap once enough of it is unused
+         wallet_system_idle();
+         
          // Show debug log if enabled
          #ifdef DEBUG_ENABLE_LOG_DISPLAY
          debug_show_log(150, 0, LOG_WARNING);
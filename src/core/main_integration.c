@@ -74,15 +74,9 @@
   * Configures background, sprites, and display registers.
   */
  void initialize_graphics_system(void) {
-     // Set video mode and enable required backgrounds
-     REG_DISPCNT = DCNT_MODE0 | DCNT_BG0 | DCNT_BG1 | DCNT_OBJ | DCNT_OBJ_1D;
-     
-     // Configure backgrounds
-     REG_BG0CNT = BG_CBB(0) | BG_SBB(30) | BG_4BPP | BG_REG_32x32 | BG_PRIO(2);
-     REG_BG1CNT = BG_CBB(1) | BG_SBB(29) | BG_4BPP | BG_REG_32x32 | BG_PRIO(1);
-     
-     // Initialize OAM for sprites
-     oam_init(obj_buffer, 128);
+     // The menu screen declares the mode, backgrounds and sprites; the
+     // compositor applies them at the next VBlank
+     menu_init_graphics();
      
      LOG_INFO(MODULE_SYSTEM, "Graphics system initialized", 0);
  }
@@ -256,8 +250,10 @@
  /**
   * @brief Save all user data
   * 
-  * Saves all user configuration and wallet data to SRAM.
-  * Called when exiting or as part of periodic saves.
+  * Saves all user configuration and wallet data to the save chip.
+  * Wallet saves only write the entries changed since the last save and
+  * return at once if nothing changed, so this is cheap enough to call
+  * after every edit as well as on exit.
   * 
   * @return true if all data was saved successfully
   */
@@ -270,8 +266,11 @@
          success = false;
      }
      
-     // Save QR protection settings
-     // In a real implementation, we would have a save function for protection settings
+     // Save QR protection settings (no write if they are unchanged)
+     if (!qr_protection_save_settings()) {
+         LOG_ERROR(MODULE_SYSTEM, "Failed to save protection settings", 0);
+         success = false;
+     }
      
      // Save general application settings
      // This would be implementation-specific
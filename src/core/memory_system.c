@@ -0,0 +1,381 @@
+/**
+ * @file memory_system.c
+ * @brief Region-aware arena and pool allocators
+ *
+ * The linker script used to start the heap at the beginning of EWRAM,
+ * where .data and .bss also live, so newlib malloc handed out memory
+ * that overlapped globals such as g_wallet_system. The heap regions now
+ * start after the sections (__heap_start, __iwram_heap_start).
+ *
+ * Every allocation here is O(1): regions and arenas move a pointer, pools
+ * pop and push a free list. Nothing is ever searched or coalesced, so
+ * the cost of an encode does not depend on what was allocated before.
+ *
+ * @author Claude
+ * @date October 2026
+ * @version 1.0.0
+ */
+
+ #include <tonc.h>
+ #include <string.h>
+ #include "memory_system.h"
+ #include "qr_debug.h"
+
+ // Section and region bounds from gba_cart.ld
+ extern u8 __iwram_start[], __iwram_end[];
+ extern u8 __iwram_bss_start[], __iwram_bss_end[];
+ extern u8 __data_start[], __data_end[];
+ extern u8 __bss_start__[], __bss_end__[];
+ extern u8 __heap_start[], __heap_end[];
+ extern u8 __iwram_heap_start[], __iwram_heap_end[];
+
+ #define MEM_ALIGN(bytes)        (((bytes) + 3) & ~3u)
+
+ static MemRegion s_regions[MEM_REGION_COUNT];
+
+ MemArena g_mem_frame;
+
+ // newlib's heap, grown by _sbrk
+ static u8 *s_newlib_base;
+ static u32 s_newlib_used;
+
+ /**
+  * Shared scratch: a permanent EWRAM block lent to one owner at a time
+  */
+ typedef struct {
+     u8 *base;                   // Scratch memory
+     const char *owner;          // Current holder (NULL = free)
+     u32 bytes;                  // Bytes the holder asked for
+     MemScratchStats stats;
+ } MemScratch;
+
+ static MemScratch s_scratch;
+
+ /**
+  * @brief Account for bytes taken from or returned to a region
+  */
+ static inline void mem_region_use(MemRegionId region, s32 bytes) {
+     MemRegion *r = &s_regions[region];
+
+     r->in_use += bytes;
+     if (r->in_use > r->high_water) {
+         r->high_water = r->in_use;
+     }
+ }
+
+ /**
+  * @brief Take bytes from a region for an arena or pool
+  *
+  * Carved bytes count towards the region's usage only while they are
+  * allocated, so the high-water mark shows real peak usage.
+  */
+ static void *mem_region_carve(MemRegionId region, u32 bytes) {
+     MemRegion *r = &s_regions[region];
+
+     if (bytes > (u32)(r->end - r->top)) {
+         LOG_ERROR(MODULE_SYSTEM, "Memory region full", bytes);
+         return NULL;
+     }
+
+     void *block = r->top;
+     r->top += bytes;
+     return block;
+ }
+
+ /**
+  * @brief Set up the regions and the frame arena
+  */
+ void memory_init(void) {
+     s_regions[MEM_REGION_EWRAM] = (MemRegion){
+         "EWRAM heap", __heap_start, __heap_end, __heap_start, 0, 0
+     };
+     s_regions[MEM_REGION_IWRAM] = (MemRegion){
+         "IWRAM heap", __iwram_heap_start, __iwram_heap_end, __iwram_heap_start, 0, 0
+     };
+
+     s_newlib_base = mem_region_carve(MEM_REGION_EWRAM, MEM_NEWLIB_HEAP_SIZE);
+     s_newlib_used = 0;
+
+     mem_arena_init(&g_mem_frame, MEM_REGION_EWRAM, MEM_FRAME_ARENA_SIZE, "Frame arena");
+
+     memset(&s_scratch, 0, sizeof(s_scratch));
+     s_scratch.base = mem_region_carve(MEM_REGION_EWRAM, MEM_SCRATCH_SIZE);
+
+     LOG_INFO(MODULE_SYSTEM, "Memory system initialized", __heap_end - __heap_start);
+ }
+
+ /**
+  * @brief Check that the frame arena was released
+  *
+  * Frame scratch must not outlive the frame; a leftover allocation means
+  * a missing mem_arena_release() and would slowly exhaust the arena.
+  */
+ void memory_frame_end(void) {
+     if (g_mem_frame.used == 0) return;
+
+     LOG_ERROR(MODULE_SYSTEM, "Frame arena leak", g_mem_frame.used);
+     mem_arena_release(&g_mem_frame, 0);
+ }
+
+ /**
+  * @brief Allocate a permanent block from a region
+  *
+  * @return Block, or NULL if the region is full
+  */
+ void *mem_region_alloc(MemRegionId region, u32 bytes) {
+     void *block = mem_region_carve(region, MEM_ALIGN(bytes));
+
+     if (block) {
+         mem_region_use(region, MEM_ALIGN(bytes));
+     }
+     return block;
+ }
+
+ /**
+  * @brief State and statistics of a region
+  */
+ const MemRegion *mem_region(MemRegionId region) {
+     return &s_regions[region];
+ }
+
+ /**
+  * @brief Carve an arena from a region
+  */
+ bool mem_arena_init(MemArena *arena, MemRegionId region, u32 size, const char *name) {
+     memset(arena, 0, sizeof(MemArena));
+     size = MEM_ALIGN(size);
+
+     arena->base = mem_region_carve(region, size);
+     if (!arena->base) return false;
+
+     arena->name = name;
+     arena->region = region;
+     arena->size = size;
+     return true;
+ }
+
+ /**
+  * @brief Allocate from an arena
+  *
+  * @return Block, or NULL if the arena is full
+  */
+ void *mem_arena_alloc(MemArena *arena, u32 bytes) {
+     bytes = MEM_ALIGN(bytes);
+
+     if (bytes > arena->size - arena->used) {
+         arena->failures++;
+         LOG_ERROR(MODULE_SYSTEM, arena->name, bytes);
+         return NULL;
+     }
+
+     void *block = arena->base + arena->used;
+     arena->used += bytes;
+     if (arena->used > arena->high_water) {
+         arena->high_water = arena->used;
+     }
+     mem_region_use(arena->region, bytes);
+     return block;
+ }
+
+ /**
+  * @brief Current arena position
+  */
+ u32 mem_arena_mark(const MemArena *arena) {
+     return arena->used;
+ }
+
+ /**
+  * @brief Release everything allocated since a mark
+  */
+ void mem_arena_release(MemArena *arena, u32 mark) {
+     if (mark >= arena->used) return;
+
+     mem_region_use(arena->region, -(s32)(arena->used - mark));
+     arena->used = mark;
+ }
+
+ /**
+  * @brief Carve a pool of fixed-size blocks from a region
+  *
+  * The free list is threaded through the blocks themselves, lowest
+  * address first.
+  */
+ bool mem_pool_init(MemPool *pool, MemRegionId region, u32 block_size,
+                    u16 block_count, const char *name) {
+     memset(pool, 0, sizeof(MemPool));
+     block_size = MEM_ALIGN(block_size < 4 ? 4 : block_size);
+
+     pool->base = mem_region_carve(region, block_size * block_count);
+     if (!pool->base) return false;
+
+     pool->name = name;
+     pool->region = region;
+     pool->block_size = block_size;
+     pool->block_count = block_count;
+
+     for (int i = block_count - 1; i >= 0; i--) {
+         void **block = (void **)(pool->base + i * block_size);
+         *block = pool->free_list;
+         pool->free_list = block;
+     }
+
+     return true;
+ }
+
+ /**
+  * @brief Take a block from a pool
+  *
+  * @return Block, or NULL if all blocks are in use
+  */
+ void *mem_pool_alloc(MemPool *pool) {
+     void **block = pool->free_list;
+
+     if (!block) {
+         pool->failures++;
+         LOG_ERROR(MODULE_SYSTEM, pool->name, pool->block_count);
+         return NULL;
+     }
+
+     pool->free_list = *block;
+     pool->used++;
+     if (pool->used > pool->high_water) {
+         pool->high_water = pool->used;
+     }
+     mem_region_use(pool->region, pool->block_size);
+     return block;
+ }
+
+ /**
+  * @brief Return a block to its pool
+  */
+ void mem_pool_free(MemPool *pool, void *block) {
+     if (!block) return;
+
+     u8 *p = block;
+     if (p < pool->base || p >= pool->base + pool->block_size * pool->block_count) {
+         LOG_ERROR(MODULE_SYSTEM, "Block freed to wrong pool", (u32)block);
+         return;
+     }
+
+     *(void **)block = pool->free_list;
+     pool->free_list = block;
+     pool->used--;
+     mem_region_use(pool->region, -(s32)pool->block_size);
+ }
+
+ /**
+  * @brief Borrow the shared scratch
+  *
+  * The scratch replaces buffers that several systems used to embed for
+  * themselves but never needed at the same time. A refused borrow means
+  * two of them overlap after all; the log names the current holder.
+  *
+  * @return Scratch buffer, or NULL if it is held or too small
+  */
+ void *mem_scratch_acquire(u32 bytes, const char *owner) {
+     if (!s_scratch.base || bytes > MEM_SCRATCH_SIZE) {
+         LOG_ERROR(MODULE_SYSTEM, "Scratch request too large", bytes);
+         return NULL;
+     }
+
+     if (s_scratch.owner) {
+         s_scratch.stats.conflicts++;
+         LOG_ERROR(MODULE_SYSTEM, s_scratch.owner, bytes);
+         return NULL;
+     }
+
+     s_scratch.owner = owner;
+     s_scratch.bytes = bytes;
+     s_scratch.stats.acquires++;
+     if (bytes > s_scratch.stats.peak_bytes) {
+         s_scratch.stats.peak_bytes = bytes;
+     }
+     mem_region_use(MEM_REGION_EWRAM, bytes);
+     return s_scratch.base;
+ }
+
+ /**
+  * @brief Return the shared scratch
+  */
+ void mem_scratch_release(void *scratch) {
+     if (!scratch) return;
+
+     if (scratch != s_scratch.base || !s_scratch.owner) {
+         LOG_ERROR(MODULE_SYSTEM, "Scratch released twice or by a stranger", (u32)scratch);
+         return;
+     }
+
+     mem_region_use(MEM_REGION_EWRAM, -(s32)s_scratch.bytes);
+     s_scratch.owner = NULL;
+     s_scratch.bytes = 0;
+ }
+
+ /**
+  * @brief Current holder of the shared scratch
+  */
+ const char *mem_scratch_owner(void) {
+     return s_scratch.owner;
+ }
+
+ /**
+  * @brief Shared scratch statistics
+  */
+ const MemScratchStats *mem_scratch_stats(void) {
+     return &s_scratch.stats;
+ }
+
+ /**
+  * @brief Grow newlib's heap inside its EWRAM reservation
+  *
+  * Application code allocates through arenas and pools; this only serves
+  * library code that still calls malloc internally.
+  */
+ void *mem_sbrk(int incr) {
+     if (!s_newlib_base || incr < -(int)s_newlib_used ||
+         incr > (int)(MEM_NEWLIB_HEAP_SIZE - s_newlib_used)) {
+         return (void *)-1;
+     }
+
+     void *prev = s_newlib_base + s_newlib_used;
+     s_newlib_used += incr;
+     mem_region_use(MEM_REGION_EWRAM, incr);
+     return prev;
+ }
+
+ /**
+  * @brief Log region, frame arena and newlib heap usage
+  */
+ void memory_log_stats(void) {
+     for (int i = 0; i < MEM_REGION_COUNT; i++) {
+         const MemRegion *r = &s_regions[i];
+         LOG_INFO(MODULE_SYSTEM, r->name, r->high_water);
+     }
+
+     LOG_INFO(MODULE_SYSTEM, g_mem_frame.name, g_mem_frame.high_water);
+     LOG_INFO(MODULE_SYSTEM, "newlib heap bytes", s_newlib_used);
+ }
+
+ /**
+  * @brief Log the memory map
+  *
+  * One line per section and per block carved from the heaps, then the
+  * space left in each heap for address books, caches and later pools.
+  */
+ void memory_log_map(void) {
+     const MemRegion *ewram = &s_regions[MEM_REGION_EWRAM];
+     const MemRegion *iwram = &s_regions[MEM_REGION_IWRAM];
+
+     LOG_INFO(MODULE_SYSTEM, "IWRAM code+data bytes", __iwram_end - __iwram_start);
+     LOG_INFO(MODULE_SYSTEM, "IWRAM bss bytes", __iwram_bss_end - __iwram_bss_start);
+     LOG_INFO(MODULE_SYSTEM, "IWRAM heap bytes", iwram->end - iwram->base);
+     LOG_INFO(MODULE_SYSTEM, "IWRAM heap free", iwram->end - iwram->top);
+
+     LOG_INFO(MODULE_SYSTEM, "EWRAM data bytes", __data_end - __data_start);
+     LOG_INFO(MODULE_SYSTEM, "EWRAM bss bytes", __bss_end__ - __bss_start__);
+     LOG_INFO(MODULE_SYSTEM, "EWRAM heap bytes", ewram->end - ewram->base);
+     LOG_INFO(MODULE_SYSTEM, "newlib heap bytes", MEM_NEWLIB_HEAP_SIZE);
+     LOG_INFO(MODULE_SYSTEM, g_mem_frame.name, g_mem_frame.size);
+     LOG_INFO(MODULE_SYSTEM, "Shared scratch bytes", MEM_SCRATCH_SIZE);
+     LOG_INFO(MODULE_SYSTEM, "EWRAM heap in use", ewram->in_use);
+     LOG_INFO(MODULE_SYSTEM, "EWRAM heap free", ewram->end - ewram->top);
+ }
@@ -0,0 +1,230 @@
+/**
+ * @file memory_system.h
+ * @brief Region-aware arena and pool allocators
+ *
+ * Replaces newlib malloc for the application. Memory comes from two
+ * linker-defined regions: the EWRAM heap after .bss and the IWRAM heap
+ * between .iwram_bss and the stack reserve. Each region hands out
+ * permanent blocks with a bump pointer; arenas and pools are carved from
+ * those blocks at init and allocate in constant time afterwards.
+ *
+ * - Arenas: bump allocation with mark/release scopes, for transient
+ *   scratch (encode buffers). The frame arena must be back to empty at
+ *   the end of every frame.
+ * - Pools: fixed-size blocks on a free list, for objects with their own
+ *   lifetime (QR matrices, records).
+ * - Shared scratch: one framebuffer-sized buffer that a single owner at a
+ *   time borrows for large, short-lived work (rendered QR images, staging).
+ *
+ * @author Claude
+ * @date October 2026
+ * @version 1.0.0
+ */
+
+ #ifndef MEMORY_SYSTEM_H
+ #define MEMORY_SYSTEM_H
+
+ #include <tonc.h>
+
+ /**
+  * Size of the frame arena (EWRAM)
+  */
+ #define MEM_FRAME_ARENA_SIZE    (16 * 1024)
+
+ /**
+  * EWRAM set aside for newlib's own malloc (via _sbrk)
+  */
+ #define MEM_NEWLIB_HEAP_SIZE    (4 * 1024)
+
+ /**
+  * Size of the shared scratch: one Mode 4 page, which also holds a
+  * 128x128 15bpp image
+  */
+ #define MEM_SCRATCH_SIZE        M4_SIZE
+
+ /**
+  * Memory regions
+  */
+ typedef enum {
+     MEM_REGION_EWRAM = 0,       // 256 KB external RAM, after .data/.bss
+     MEM_REGION_IWRAM,           // 32 KB internal RAM, after .iwram_bss
+     MEM_REGION_COUNT
+ } MemRegionId;
+
+ /**
+  * Region state and statistics
+  */
+ typedef struct {
+     const char *name;           // For the log
+     u8 *base;                   // First byte of the region
+     u8 *end;                    // One past the last byte
+     u8 *top;                    // Next free byte for permanent blocks
+     u32 in_use;                 // Bytes in use (permanent, arena and pool allocations)
+     u32 high_water;             // Most bytes ever in use at once
+ } MemRegion;
+
+ /**
+  * Bump allocator with mark/release scopes
+  */
+ typedef struct {
+     const char *name;           // For the log
+     MemRegionId region;         // Region the arena was carved from
+     u8 *base;                   // Arena memory
+     u32 size;                   // Arena size in bytes
+     u32 used;                   // Bytes allocated
+     u32 high_water;             // Most bytes ever allocated at once
+     u32 failures;               // Allocations that did not fit
+ } MemArena;
+
+ /**
+  * Fixed-size block allocator
+  */
+ typedef struct {
+     const char *name;           // For the log
+     MemRegionId region;         // Region the pool was carved from
+     u8 *base;                   // Block memory
+     void *free_list;            // First free block (each free block holds the next)
+     u32 block_size;             // Bytes per block (multiple of 4)
+     u16 block_count;            // Blocks in the pool
+     u16 used;                   // Blocks allocated
+     u16 high_water;             // Most blocks ever allocated at once
+     u16 failures;               // Allocations with no free block
+ } MemPool;
+
+ /**
+  * Shared scratch statistics
+  */
+ typedef struct {
+     u32 acquires;               // Successful borrows
+     u32 conflicts;              // Borrows refused because another owner held it
+     u32 peak_bytes;             // Largest borrow
+ } MemScratchStats;
+
+ /**
+  * Arena for scratch that lives at most until the end of the frame
+  */
+ extern MemArena g_mem_frame;
+
+ /**
+  * Set up the regions and the frame arena; call first at boot
+  */
+ void memory_init(void);
+
+ /**
+  * Check that the frame arena was released; call once per frame
+  * Anything still allocated is logged as a leak and dropped
+  */
+ void memory_frame_end(void);
+
+ /**
+  * Allocate a permanent block from a region
+  * @param region Region to allocate from
+  * @param bytes Size in bytes (rounded up to 4)
+  * @return Block, or NULL if the region is full
+  */
+ void *mem_region_alloc(MemRegionId region, u32 bytes);
+
+ /**
+  * State and statistics of a region
+  */
+ const MemRegion *mem_region(MemRegionId region);
+
+ /**
+  * Carve an arena from a region
+  * @param arena Arena to set up
+  * @param region Region to carve it from
+  * @param size Arena size in bytes
+  * @param name Name for the log
+  * @return False if the region is full
+  */
+ bool mem_arena_init(MemArena *arena, MemRegionId region, u32 size, const char *name);
+
+ /**
+  * Allocate from an arena
+  * @param arena Arena
+  * @param bytes Size in bytes (rounded up to 4)
+  * @return Block, or NULL if the arena is full
+  */
+ void *mem_arena_alloc(MemArena *arena, u32 bytes);
+
+ /**
+  * Current arena position, to release everything allocated after it
+  */
+ u32 mem_arena_mark(const MemArena *arena);
+
+ /**
+  * Release everything allocated since a mark
+  * @param arena Arena
+  * @param mark Position from mem_arena_mark()
+  */
+ void mem_arena_release(MemArena *arena, u32 mark);
+
+ /**
+  * Carve a pool of fixed-size blocks from a region
+  * @param pool Pool to set up
+  * @param region Region to carve it from
+  * @param block_size Bytes per block (rounded up to 4)
+  * @param block_count Number of blocks
+  * @param name Name for the log
+  * @return False if the region is full
+  */
+ bool mem_pool_init(MemPool *pool, MemRegionId region, u32 block_size,
+                    u16 block_count, const char *name);
+
+ /**
+  * Take a block from a pool
+  * @return Block, or NULL if all blocks are in use
+  */
+ void *mem_pool_alloc(MemPool *pool);
+
+ /**
+  * Return a block to its pool
+  * @param pool Pool the block came from
+  * @param block Block from mem_pool_alloc() (NULL is ignored)
+  */
+ void mem_pool_free(MemPool *pool, void *block);
+
+ /**
+  * Borrow the shared scratch
+  * Only one owner holds it at a time; return it with mem_scratch_release()
+  * @param bytes Bytes needed (up to MEM_SCRATCH_SIZE)
+  * @param owner Name of the borrower, for the log
+  * @return Scratch buffer (word aligned), or NULL if it is held or too small
+  */
+ void *mem_scratch_acquire(u32 bytes, const char *owner);
+
+ /**
+  * Return the shared scratch
+  * @param scratch Buffer from mem_scratch_acquire()
+  */
+ void mem_scratch_release(void *scratch);
+
+ /**
+  * Current holder of the shared scratch, or NULL if it is free
+  */
+ const char *mem_scratch_owner(void);
+
+ /**
+  * Shared scratch statistics
+  */
+ const MemScratchStats *mem_scratch_stats(void);
+
+ /**
+  * Grow newlib's heap inside its EWRAM reservation (backs _sbrk)
+  * @param incr Bytes to add
+  * @return Previous end of the heap, or (void *)-1 if it is full
+  */
+ void *mem_sbrk(int incr);
+
+ /**
+  * Log region, frame arena and newlib heap usage
+  */
+ void memory_log_stats(void);
+
+ /**
+  * Log the memory map: linker sections, heap regions, the blocks carved
+  * from them and the space left; call at the end of boot
+  */
+ void memory_log_map(void);
+
+ #endif // MEMORY_SYSTEM_H
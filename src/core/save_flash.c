@@ -0,0 +1,261 @@
+/**
+ * @file save_flash.c
+ * @brief Cartridge flash driver and a RAM-backed flash stand-in
+ *
+ * The command sequences follow the common Macronix/Panasonic/SST/Sanyo
+ * parts: unlock with 0xAA at 0x5555 and 0x55 at 0x2AAA, then the command.
+ * Atmel parts program in 128-byte pages instead of single bytes and are
+ * not supported.
+ *
+ * The bus access loops run from IWRAM as ARM code; polling a status byte
+ * from ROM code would add ROM wait states to every iteration.
+ *
+ * @author Claude
+ * @date October 2026
+ * @version 1.0.0
+ */
+
+ #include <tonc.h>
+ #include <string.h>
+ #include "save_flash.h"
+ #include "gba_sections.h"
+ #include "qr_debug.h"
+
+ #define FLASH_BASE              ((vu8 *)MEM_SRAM)
+ #define FLASH_UNLOCK_1          0x5555
+ #define FLASH_UNLOCK_2          0x2AAA
+
+ #define FLASH_CMD_ID_ENTER      0x90
+ #define FLASH_CMD_ID_EXIT       0xF0
+ #define FLASH_CMD_ERASE         0x80
+ #define FLASH_CMD_ERASE_SECTOR  0x30
+ #define FLASH_CMD_PROGRAM       0xA0
+ #define FLASH_CMD_BANK          0xB0
+
+ // Poll limits; a sector erase takes up to about 20 ms (~350k cycles)
+ #define FLASH_ERASE_POLLS       0x80000
+ #define FLASH_PROGRAM_POLLS     0x1000
+
+ /**
+  * Supported chips
+  */
+ static const struct {
+     u8 manufacturer;
+     u8 device;
+     u8 sectors;
+     const char *name;
+ } FLASH_CHIPS[] = {
+     { 0xBF, 0xD4, 16, "SST 64K" },
+     { 0x32, 0x1B, 16, "Panasonic 64K" },
+     { 0xC2, 0x1C, 16, "Macronix 64K" },
+     { 0xC2, 0x09, 32, "Macronix 128K" },
+     { 0x62, 0x13, 32, "Sanyo 128K" },
+ };
+
+ #define FLASH_CHIP_COUNT (sizeof(FLASH_CHIPS) / sizeof(FLASH_CHIPS[0]))
+
+ IWRAM_CODE static void flash_command(u8 command) {
+     FLASH_BASE[FLASH_UNLOCK_1] = 0xAA;
+     FLASH_BASE[FLASH_UNLOCK_2] = 0x55;
+     FLASH_BASE[FLASH_UNLOCK_1] = command;
+ }
+
+ /**
+  * @brief Read the chip ID
+  */
+ IWRAM_CODE static void flash_read_id(u8 *manufacturer, u8 *device) {
+     flash_command(FLASH_CMD_ID_ENTER);
+     for (vu32 wait = 0; wait < 100; wait++);
+
+     *manufacturer = FLASH_BASE[0];
+     *device = FLASH_BASE[1];
+
+     flash_command(FLASH_CMD_ID_EXIT);
+     FLASH_BASE[0] = FLASH_CMD_ID_EXIT;
+     for (vu32 wait = 0; wait < 100; wait++);
+ }
+
+ /**
+  * @brief Map the bank holding an offset (128 KB parts)
+  *
+  * @return Offset inside the mapped bank
+  */
+ static u32 flash_select_bank(FlashDevice *dev, u32 offset) {
+     u8 bank = offset / FLASH_BANK_SIZE;
+
+     if (!dev->ram && dev->sector_count > FLASH_BANK_SIZE / FLASH_SECTOR_SIZE &&
+         bank != dev->bank) {
+         flash_command(FLASH_CMD_BANK);
+         FLASH_BASE[0] = bank;
+         dev->bank = bank;
+     }
+
+     return offset % FLASH_BANK_SIZE;
+ }
+
+ IWRAM_CODE static void flash_cart_read(u32 offset, u8 *dst, u32 len) {
+     const vu8 *src = FLASH_BASE + offset;
+
+     while (len >= 4) {
+         dst[0] = src[0];
+         dst[1] = src[1];
+         dst[2] = src[2];
+         dst[3] = src[3];
+         dst += 4;
+         src += 4;
+         len -= 4;
+     }
+     while (len--) {
+         *dst++ = *src++;
+     }
+ }
+
+ /**
+  * @brief Program bytes, polling each one until it reads back
+  *
+  * @return Number of bytes programmed and verified
+  */
+ IWRAM_CODE static u32 flash_cart_program(u32 offset, const u8 *src, u32 len) {
+     for (u32 i = 0; i < len; i++) {
+         vu8 *dst = FLASH_BASE + offset + i;
+
+         // Erased bytes need no programming
+         if (src[i] == 0xFF) continue;
+
+         flash_command(FLASH_CMD_PROGRAM);
+         *dst = src[i];
+
+         u32 polls = FLASH_PROGRAM_POLLS;
+         while (*dst != src[i] && --polls);
+         if (!polls) return i;
+     }
+
+     return len;
+ }
+
+ IWRAM_CODE static bool flash_cart_erase(u32 offset) {
+     vu8 *sector = FLASH_BASE + offset;
+
+     flash_command(FLASH_CMD_ERASE);
+     FLASH_BASE[FLASH_UNLOCK_1] = 0xAA;
+     FLASH_BASE[FLASH_UNLOCK_2] = 0x55;
+     *sector = FLASH_CMD_ERASE_SECTOR;
+
+     u32 polls = FLASH_ERASE_POLLS;
+     while (*sector != 0xFF && --polls);
+     return polls != 0;
+ }
+
+ /**
+  * @brief Identify the cartridge flash chip
+  */
+ bool flash_cart_open(FlashDevice *dev) {
+     u8 manufacturer, device;
+
+     memset(dev, 0, sizeof(FlashDevice));
+     flash_read_id(&manufacturer, &device);
+
+     for (u32 i = 0; i < FLASH_CHIP_COUNT; i++) {
+         if (FLASH_CHIPS[i].manufacturer == manufacturer && FLASH_CHIPS[i].device == device) {
+             dev->name = FLASH_CHIPS[i].name;
+             dev->manufacturer = manufacturer;
+             dev->device = device;
+             dev->sector_count = FLASH_CHIPS[i].sectors;
+
+             // Bank 0 is not guaranteed after reset
+             if (dev->sector_count > FLASH_BANK_SIZE / FLASH_SECTOR_SIZE) {
+                 dev->bank = 0xFF;
+                 flash_select_bank(dev, 0);
+             }
+
+             LOG_INFO(MODULE_SYSTEM, "Flash chip found (sectors)", dev->sector_count);
+             return true;
+         }
+     }
+
+     LOG_INFO(MODULE_SYSTEM, "No flash chip (ID)", (manufacturer << 8) | device);
+     return false;
+ }
+
+ /**
+  * @brief Set up a RAM-backed stand-in
+  */
+ void flash_ram_open(FlashDevice *dev, u8 *ram, u16 sector_count, bool erase) {
+     memset(dev, 0, sizeof(FlashDevice));
+     dev->name = "RAM flash";
+     dev->ram = ram;
+     dev->sector_count = sector_count;
+
+     if (erase) {
+         memset(ram, 0xFF, sector_count * FLASH_SECTOR_SIZE);
+     }
+ }
+
+ /**
+  * @brief Read bytes
+  */
+ void flash_read(FlashDevice *dev, u32 offset, void *dst, u32 len) {
+     if (dev->ram) {
+         memcpy(dst, dev->ram + offset, len);
+         return;
+     }
+
+     flash_cart_read(flash_select_bank(dev, offset), dst, len);
+ }
+
+ /**
+  * @brief Program bytes
+  */
+ bool flash_program(FlashDevice *dev, u32 offset, const void *src, u32 len) {
+     const u8 *s = src;
+
+     if (dev->ram) {
+         u32 n = len;
+         if (dev->power_lost) return false;
+         if (dev->fail_after) {
+             if (dev->fail_after <= len) {
+                 n = dev->fail_after;
+                 dev->power_lost = true;
+             }
+             dev->fail_after -= n;
+         }
+
+         // Programming can only clear bits
+         for (u32 i = 0; i < n; i++) {
+             dev->ram[offset + i] &= s[i];
+         }
+         dev->bytes_programmed += n;
+         return n == len;
+     }
+
+     u32 done = flash_cart_program(flash_select_bank(dev, offset), s, len);
+     dev->bytes_programmed += done;
+     if (done != len) {
+         LOG_ERROR(MODULE_SYSTEM, "Flash program timed out", offset + done);
+         return false;
+     }
+
+     return true;
+ }
+
+ /**
+  * @brief Erase a 4 KB sector
+  */
+ bool flash_erase_sector(FlashDevice *dev, u16 sector) {
+     u32 offset = sector * FLASH_SECTOR_SIZE;
+
+     if (sector >= dev->sector_count || dev->power_lost) return false;
+     dev->erases++;
+
+     if (dev->ram) {
+         memset(dev->ram + offset, 0xFF, FLASH_SECTOR_SIZE);
+         return true;
+     }
+
+     if (!flash_cart_erase(flash_select_bank(dev, offset))) {
+         LOG_ERROR(MODULE_SYSTEM, "Flash erase timed out", sector);
+         return false;
+     }
+
+     return true;
+ }
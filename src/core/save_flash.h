@@ -0,0 +1,94 @@
+/**
+ * @file save_flash.h
+ * @brief Cartridge flash driver and a RAM-backed flash stand-in
+ *
+ * Flash save chips (64 KB, or 128 KB in two banks) sit on the same 8-bit
+ * bus as SRAM but behave differently: a byte can only be programmed from
+ * erased (0xFF) towards 0, and erasing works on whole 4 KB sectors. Every
+ * program and erase goes through an unlock command sequence and is
+ * finished by polling the chip.
+ *
+ * The RAM stand-in enforces the same rules (programming ANDs into the
+ * existing bytes, erase fills a sector with 0xFF) and can simulate power
+ * loss after a given number of programmed bytes, so the log store can be
+ * exercised without a flash cart.
+ *
+ * @author Claude
+ * @date October 2026
+ * @version 1.0.0
+ */
+
+ #ifndef SAVE_FLASH_H
+ #define SAVE_FLASH_H
+
+ #include <tonc.h>
+
+ /**
+  * Geometry
+  */
+ #define FLASH_SECTOR_SIZE       0x1000
+ #define FLASH_BANK_SIZE         0x10000
+ #define FLASH_MAX_SECTORS       32          // 128 KB part
+
+ /**
+  * Flash device, either the cartridge chip or a RAM stand-in
+  */
+ typedef struct {
+     const char *name;                       // For the log
+     u8 manufacturer;                        // Chip ID (0 for the stand-in)
+     u8 device;
+     u8 bank;                                // Bank currently mapped (128 KB parts)
+     u16 sector_count;                       // 4 KB sectors
+     u8 *ram;                                // Stand-in storage, NULL for the cartridge
+     u32 fail_after;                         // Stand-in: bytes left before power loss (0 = never)
+     bool power_lost;                        // Stand-in: all later programs and erases fail
+     u32 erases;                             // Sector erases since open
+     u32 bytes_programmed;                   // Bytes programmed since open
+ } FlashDevice;
+
+ /**
+  * Identify the cartridge flash chip
+  * Sends flash commands to the save bus; on an SRAM cart they would
+  * overwrite SRAM bytes, so check for SRAM first
+  * @param dev Device to set up
+  * @return False if no supported chip answered
+  */
+ bool flash_cart_open(FlashDevice *dev);
+
+ /**
+  * Set up a RAM-backed stand-in
+  * @param dev Device to set up
+  * @param ram Storage of sector_count * FLASH_SECTOR_SIZE bytes
+  * @param sector_count Number of sectors
+  * @param erase True to start from an erased chip
+  */
+ void flash_ram_open(FlashDevice *dev, u8 *ram, u16 sector_count, bool erase);
+
+ /**
+  * Read bytes
+  * @param dev Device
+  * @param offset Byte offset in the device
+  * @param dst Destination buffer
+  * @param len Number of bytes (must not cross a bank)
+  */
+ void flash_read(FlashDevice *dev, u32 offset, void *dst, u32 len);
+
+ /**
+  * Program bytes; the target bytes must be erased
+  * @param dev Device
+  * @param offset Byte offset in the device
+  * @param src Bytes to program
+  * @param len Number of bytes (must not cross a bank)
+  * @return False if a byte did not verify or power loss was simulated
+  */
+ bool flash_program(FlashDevice *dev, u32 offset, const void *src, u32 len);
+
+ /**
+  * Erase a 4 KB sector to 0xFF
+  * @param dev Device
+  * @param sector Sector index
+  * @return False if the erase timed out
+  */
+ bool flash_erase_sector(FlashDevice *dev, u16 sector);
+
+ #endif // SAVE_FLASH_H
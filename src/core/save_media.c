@@ -0,0 +1,595 @@
+/**
+ * @file save_media.c
+ * @brief Save chip detection and the SRAM, flash and EEPROM backends
+ *
+ * EEPROM is reached through the top of the ROM area (0x0DFFFF00 works for
+ * carts up to 32 MB) one bit per halfword, bit 0 carrying the data. Only
+ * DMA3 can drive that bus with the timing the chip expects, so every
+ * request is built as a halfword stream and sent in one transfer with
+ * interrupts off; an HBlank DMA may still pause it, which the chip
+ * tolerates.
+ *
+ * A read request is "11", the block address and a stop bit; the chip
+ * then answers with 4 dummy bits and the 64 data bits. A write is "10",
+ * the address, the 64 bits and a stop bit, after which bit 0 reads 0
+ * until the chip has finished (about 6.6 ms). 512-byte chips take a
+ * 6-bit block address, 8 KB chips a 14-bit one. A request with the wrong
+ * address length is misread by the chip (a 14-bit write reaches a
+ * 512-byte chip as a 6-bit address followed by data), so only the
+ * addressing of the configured size is ever used.
+ *
+ * @author Claude
+ * @date October 2026
+ * @version 1.0.0
+ */
+
+ #include <tonc.h>
+ #include <string.h>
+ #include "save_media.h"
+ #include "memory_system.h"
+ #include "gba_sections.h"
+ #include "qr_debug.h"
+
+ #define EEPROM_PORT             ((vu16 *)0x0DFFFF00)
+ #define EEPROM_ADDR_BITS_512    6
+ #define EEPROM_ADDR_BITS_8K     14
+ #define EEPROM_ADDR_BITS        (SAVE_MEDIA_EEPROM_SIZE == 0x200 ? EEPROM_ADDR_BITS_512 : EEPROM_ADDR_BITS_8K)
+ #define EEPROM_BLOCKS           (SAVE_MEDIA_EEPROM_SIZE / SAVE_MEDIA_EEPROM_BLOCK)
+ #define EEPROM_READ_BITS        68          // 4 dummy bits, then the data
+ #define EEPROM_REQUEST_MAX      (2 + EEPROM_ADDR_BITS_8K + 64 + 1)
+
+ // Write completion polls; a write takes up to about 10 ms (~170k cycles)
+ #define EEPROM_WRITE_POLLS      0x10000
+
+ // Bytes timed by the benchmark (the whole space if smaller)
+ #define SAVE_MEDIA_BENCH_BYTES  512
+
+ /**
+  * Detected chip
+  */
+ static struct {
+     SaveMediaType type;
+     u32 size;
+     const SaveMediaOps *ops;
+ } s_media;
+
+ static void save_media_select(SaveMediaType type, u32 size, const SaveMediaOps *ops);
+
+ /* ---------------------------------------------------------------------------
+  * SRAM
+  * ------------------------------------------------------------------------- */
+
+ IWRAM_CODE static bool sram_area_read(u32 offset, void *dst, u32 len) {
+     const vu8 *src = (const vu8 *)(MEM_SRAM + offset);
+     u8 *d = dst;
+
+     while (len >= 4) {
+         d[0] = src[0];
+         d[1] = src[1];
+         d[2] = src[2];
+         d[3] = src[3];
+         d += 4;
+         src += 4;
+         len -= 4;
+     }
+     while (len--) {
+         *d++ = *src++;
+     }
+     return true;
+ }
+
+ IWRAM_CODE static bool sram_area_write(u32 offset, const void *src, u32 len) {
+     vu8 *dst = (vu8 *)(MEM_SRAM + offset);
+     const u8 *s = src;
+
+     while (len >= 4) {
+         dst[0] = s[0];
+         dst[1] = s[1];
+         dst[2] = s[2];
+         dst[3] = s[3];
+         dst += 4;
+         s += 4;
+         len -= 4;
+     }
+     while (len--) {
+         *dst++ = *s++;
+     }
+     return true;
+ }
+
+ static bool sram_area_commit(void) {
+     return true;
+ }
+
+ static const SaveMediaOps SRAM_OPS = {
+     "SRAM 32K", sram_area_read, sram_area_write, sram_area_commit
+ };
+
+ /**
+  * @brief Check that the save bus keeps plainly written bytes
+  *
+  * Flash ignores writes outside a command sequence and an EEPROM cart has
+  * nothing there, so two different values must both read back. The probe
+  * byte is the last one of the chip and is restored.
+  */
+ static bool sram_probe(void) {
+     const u32 at = SAVE_MEDIA_SRAM_SIZE - 1;
+     u8 old, probe, check[2];
+
+     sram_area_read(at, &old, 1);
+     probe = ~old;
+     sram_area_write(at, &probe, 1);
+     sram_area_read(at, &check[0], 1);
+     probe = old ^ 0x5A;
+     sram_area_write(at, &probe, 1);
+     sram_area_read(at, &check[1], 1);
+     sram_area_write(at, &old, 1);
+
+     return check[0] == (u8)~old && check[1] == (u8)(old ^ 0x5A);
+ }
+
+ /* ---------------------------------------------------------------------------
+  * Flash: the last sector, cached while it is being changed
+  * ------------------------------------------------------------------------- */
+
+ static FlashDevice s_flash;
+ static u8 *s_flash_cache;               // Sector copy in EWRAM
+ static bool s_flash_cached;             // Cache holds the sector
+ static bool s_flash_dirty;              // Cache differs from the chip
+ static u16 s_flash_sector;              // Sector behind the space
+
+ static bool flash_area_read(u32 offset, void *dst, u32 len) {
+     if (s_flash_cached) {
+         memcpy(dst, s_flash_cache + offset, len);
+     } else {
+         flash_read(&s_flash, s_flash_sector * FLASH_SECTOR_SIZE + offset, dst, len);
+     }
+     return true;
+ }
+
+ static bool flash_area_write(u32 offset, const void *src, u32 len) {
+     if (!s_flash_cache) return false;
+
+     if (!s_flash_cached) {
+         flash_read(&s_flash, s_flash_sector * FLASH_SECTOR_SIZE, s_flash_cache, FLASH_SECTOR_SIZE);
+         s_flash_cached = true;
+     }
+
+     if (memcmp(s_flash_cache + offset, src, len) != 0) {
+         memcpy(s_flash_cache + offset, src, len);
+         s_flash_dirty = true;
+     }
+     return true;
+ }
+
+ /**
+  * @brief Erase the sector and program the cache back
+  *
+  * Losing power in between leaves the sector erased; its records then
+  * fail their CRCs and their owners fall back to defaults.
+  */
+ static bool flash_area_commit(void) {
+     if (!s_flash_dirty) return true;
+
+     u32 base = s_flash_sector * FLASH_SECTOR_SIZE;
+     if (!flash_erase_sector(&s_flash, s_flash_sector) ||
+         !flash_program(&s_flash, base, s_flash_cache, FLASH_SECTOR_SIZE)) {
+         return false;
+     }
+
+     s_flash_dirty = false;
+     return true;
+ }
+
+ static SaveMediaOps s_flash_ops = {
+     "Flash", flash_area_read, flash_area_write, flash_area_commit
+ };
+
+ /* ---------------------------------------------------------------------------
+  * EEPROM
+  * ------------------------------------------------------------------------- */
+
+ static u8 s_eeprom_addr_bits;
+ static bool s_eeprom_verified;          // A written block has read back
+ static u16 s_eeprom_block = 0xFFFF;    // Block held in s_eeprom_cache
+ static u8 s_eeprom_cache[SAVE_MEDIA_EEPROM_BLOCK];
+
+ /**
+  * @brief Send or receive a halfword stream by DMA3 with interrupts off
+  */
+ static void eeprom_transfer(const volatile void *src, volatile void *dst, u32 halfwords) {
+     u16 ime = REG_IME;
+     REG_IME = 0;
+
+     REG_DMA3CNT = 0;
+     REG_DMA3SAD = (u32)src;
+     REG_DMA3DAD = (u32)dst;
+     REG_DMA3CNT = DMA_ENABLE | DMA_NOW | DMA_16 | halfwords;
+     while (REG_DMA3CNT & DMA_ENABLE);
+
+     REG_IME = ime;
+ }
+
+ /**
+  * @brief Append a value to a request, most significant bit first
+  */
+ static int eeprom_put_bits(u16 *stream, int n, u32 value, int bits) {
+     for (int b = bits - 1; b >= 0; b--) {
+         stream[n++] = (value >> b) & 1;
+     }
+     return n;
+ }
+
+ static void eeprom_read_block(u16 block, u8 *out) {
+     u16 stream[EEPROM_READ_BITS];
+     int n = 0;
+
+     n = eeprom_put_bits(stream, n, 0x3, 2);
+     n = eeprom_put_bits(stream, n, block, s_eeprom_addr_bits);
+     stream[n++] = 0;
+     eeprom_transfer(stream, EEPROM_PORT, n);
+     eeprom_transfer(EEPROM_PORT, stream, EEPROM_READ_BITS);
+
+     const u16 *bit = stream + 4;
+     for (int i = 0; i < SAVE_MEDIA_EEPROM_BLOCK; i++) {
+         u8 value = 0;
+         for (int b = 0; b < 8; b++) {
+             value = (value << 1) | (*bit++ & 1);
+         }
+         out[i] = value;
+     }
+ }
+
+ /**
+  * @brief Write a block and read it back
+  *
+  * An empty bus also reads bit 0 set, so only the read back shows that
+  * the chip kept the bytes.
+  *
+  * @return False if the chip did not finish in time or kept other bytes
+  */
+ static bool eeprom_write_block(u16 block, const u8 *in) {
+     u16 stream[EEPROM_REQUEST_MAX];
+     int n = 0;
+
+     n = eeprom_put_bits(stream, n, 0x2, 2);
+     n = eeprom_put_bits(stream, n, block, s_eeprom_addr_bits);
+     for (int i = 0; i < SAVE_MEDIA_EEPROM_BLOCK; i++) {
+         n = eeprom_put_bits(stream, n, in[i], 8);
+     }
+     stream[n++] = 0;
+     eeprom_transfer(stream, EEPROM_PORT, n);
+
+     u32 polls = EEPROM_WRITE_POLLS;
+     while (!(*EEPROM_PORT & 1) && --polls);
+     if (!polls) return false;
+
+     u8 check[SAVE_MEDIA_EEPROM_BLOCK];
+     eeprom_read_block(block, check);
+     return memcmp(check, in, SAVE_MEDIA_EEPROM_BLOCK) == 0;
+ }
+
+ static bool eeprom_area_read(u32 offset, void *dst, u32 len) {
+     u8 *d = dst;
+
+     while (len) {
+         u16 block = offset / SAVE_MEDIA_EEPROM_BLOCK;
+         u32 at = offset % SAVE_MEDIA_EEPROM_BLOCK;
+         u32 n = SAVE_MEDIA_EEPROM_BLOCK - at;
+         if (n > len) n = len;
+
+         if (block != s_eeprom_block) {
+             eeprom_read_block(block, s_eeprom_cache);
+             s_eeprom_block = block;
+         }
+
+         memcpy(d, s_eeprom_cache + at, n);
+         d += n;
+         offset += n;
+         len -= n;
+     }
+     return true;
+ }
+
+ /**
+  * @brief Write through, block by block
+  *
+  * Each block is read before it is written: a read costs a few hundred
+  * cycles, a write milliseconds and a share of the chip's endurance, so
+  * blocks that already hold the bytes are skipped.
+  *
+  * Detection cannot tell an EEPROM from an empty bus, so the first block
+  * written is the real check: if it does not read back, there is no chip
+  * of the configured size and the space is dropped before anything else
+  * is sent to it.
+  */
+ static bool eeprom_area_write(u32 offset, const void *src, u32 len) {
+     const u8 *s = src;
+
+     while (len) {
+         u16 block = offset / SAVE_MEDIA_EEPROM_BLOCK;
+         u32 at = offset % SAVE_MEDIA_EEPROM_BLOCK;
+         u32 n = SAVE_MEDIA_EEPROM_BLOCK - at;
+         if (n > len) n = len;
+
+         if (block != s_eeprom_block) {
+             eeprom_read_block(block, s_eeprom_cache);
+             s_eeprom_block = block;
+         }
+
+         if (memcmp(s_eeprom_cache + at, s, n) != 0) {
+             memcpy(s_eeprom_cache + at, s, n);
+             if (!eeprom_write_block(block, s_eeprom_cache)) {
+                 s_eeprom_block = 0xFFFF;
+                 if (!s_eeprom_verified) {
+                     LOG_ERROR(MODULE_SYSTEM, "No EEPROM kept the first write", block);
+                     save_media_select(SAVE_MEDIA_NONE, 0, NULL);
+                 } else {
+                     LOG_ERROR(MODULE_SYSTEM, "EEPROM write failed", block);
+                 }
+                 return false;
+             }
+             s_eeprom_verified = true;
+         }
+
+         s += n;
+         offset += n;
+         len -= n;
+     }
+     return true;
+ }
+
+ static bool eeprom_area_commit(void) {
+     return true;
+ }
+
+ static const SaveMediaOps EEPROM_512_OPS = {
+     "EEPROM 512B", eeprom_area_read, eeprom_area_write, eeprom_area_commit
+ };
+
+ static const SaveMediaOps EEPROM_8K_OPS = {
+     "EEPROM 8K", eeprom_area_read, eeprom_area_write, eeprom_area_commit
+ };
+
+ /**
+  * @brief Check that the configured EEPROM answers reads consistently
+  *
+  * Read only: the first and last blocks are each read twice, with the
+  * other in between, and must come back the same. Detection never
+  * writes, since the last block holds the settings and a write cut
+  * short by power loss would destroy them. A bus with no chip behind it
+  * can pass too; the first write settles that (see eeprom_area_write).
+  */
+ static bool eeprom_probe(void) {
+     u8 first[2][SAVE_MEDIA_EEPROM_BLOCK], last[2][SAVE_MEDIA_EEPROM_BLOCK];
+
+     s_eeprom_addr_bits = EEPROM_ADDR_BITS;
+     s_eeprom_verified = false;
+     s_eeprom_block = 0xFFFF;
+
+     for (int pass = 0; pass < 2; pass++) {
+         eeprom_read_block(0, first[pass]);
+         eeprom_read_block(EEPROM_BLOCKS - 1, last[pass]);
+     }
+
+     return memcmp(first[0], first[1], SAVE_MEDIA_EEPROM_BLOCK) == 0 &&
+            memcmp(last[0], last[1], SAVE_MEDIA_EEPROM_BLOCK) == 0;
+ }
+
+ /* ---------------------------------------------------------------------------
+  * Interface
+  * ------------------------------------------------------------------------- */
+
+ static void save_media_select(SaveMediaType type, u32 size, const SaveMediaOps *ops) {
+     s_media.type = type;
+     s_media.size = size;
+     s_media.ops = ops;
+ }
+
+ /**
+  * @brief Detect the save chip
+  */
+ bool save_media_init(void) {
+     save_media_select(SAVE_MEDIA_NONE, 0, NULL);
+
+     // Flash commands and EEPROM requests must never reach an SRAM chip
+     if (sram_probe()) {
+         save_media_select(SAVE_MEDIA_SRAM, SAVE_MEDIA_SRAM_SIZE, &SRAM_OPS);
+     } else if (flash_cart_open(&s_flash)) {
+         s_flash_sector = s_flash.sector_count - SAVE_MEDIA_FLASH_SECTORS;
+         s_flash_cache = mem_region_alloc(MEM_REGION_EWRAM, FLASH_SECTOR_SIZE);
+         if (!s_flash_cache) {
+             LOG_ERROR(MODULE_SYSTEM, "No room for the flash sector cache", FLASH_SECTOR_SIZE);
+         }
+         s_flash_ops.name = s_flash.name;
+         save_media_select(SAVE_MEDIA_FLASH, SAVE_MEDIA_FLASH_SECTORS * FLASH_SECTOR_SIZE,
+                           &s_flash_ops);
+     } else if (SAVE_MEDIA_EEPROM_SIZE && eeprom_probe()) {
+         if (SAVE_MEDIA_EEPROM_SIZE == 0x200) {
+             save_media_select(SAVE_MEDIA_EEPROM_512, 0x200, &EEPROM_512_OPS);
+         } else {
+             save_media_select(SAVE_MEDIA_EEPROM_8K, 0x2000, &EEPROM_8K_OPS);
+         }
+     }
+
+     if (s_media.type == SAVE_MEDIA_NONE) {
+         LOG_WARNING(MODULE_SYSTEM, "No save chip found", 0);
+         return false;
+     }
+
+     LOG_INFO(MODULE_SYSTEM, "Save chip type", s_media.type);
+     LOG_INFO(MODULE_SYSTEM, "Save space bytes", s_media.size);
+     return true;
+ }
+
+ SaveMediaType save_media_type(void) {
+     return s_media.type;
+ }
+
+ const char *save_media_name(void) {
+     return s_media.ops ? s_media.ops->name : "None";
+ }
+
+ u32 save_media_size(void) {
+     return s_media.size;
+ }
+
+ u32 save_media_settings_offset(void) {
+     return s_media.size >= SAVE_MEDIA_SETTINGS_BYTES ? s_media.size - SAVE_MEDIA_SETTINGS_BYTES : 0;
+ }
+
+ /**
+  * @brief Check a range against the space
+  */
+ static bool save_media_range(u32 offset, u32 len) {
+     if (!s_media.ops || offset > s_media.size || len > s_media.size - offset) {
+         LOG_ERROR(MODULE_SYSTEM, "Save access out of range", offset);
+         return false;
+     }
+     return true;
+ }
+
+ bool save_media_read(u32 offset, void *dst, u32 len) {
+     return save_media_range(offset, len) && s_media.ops->read(offset, dst, len);
+ }
+
+ bool save_media_write(u32 offset, const void *src, u32 len) {
+     return save_media_range(offset, len) && s_media.ops->write(offset, src, len);
+ }
+
+ bool save_media_commit(void) {
+     if (!s_media.ops) return false;
+
+     if (!s_media.ops->commit()) {
+         LOG_ERROR(MODULE_SYSTEM, "Save commit failed", s_media.type);
+         return false;
+     }
+     return true;
+ }
+
+ FlashDevice *save_media_flash(void) {
+     return s_media.type == SAVE_MEDIA_FLASH ? &s_flash : NULL;
+ }
+
+ static u32 bytes_per_sec(u32 bytes, u32 cycles) {
+     return cycles ? (u32)((u64)bytes * 16777216 / cycles) : 0;
+ }
+
+ /* ---------------------------------------------------------------------------
+  * Benchmark stand-in
+  * ------------------------------------------------------------------------- */
+
+ static u8 *s_bench_ram;
+
+ static bool bench_area_read(u32 offset, void *dst, u32 len) {
+     memcpy(dst, s_bench_ram + offset, len);
+     return true;
+ }
+
+ static bool bench_area_write(u32 offset, const void *src, u32 len) {
+     memcpy(s_bench_ram + offset, src, len);
+     return true;
+ }
+
+ static const SaveMediaOps BENCH_OPS = {
+     "RAM", bench_area_read, bench_area_write, sram_area_commit
+ };
+
+ /**
+  * @brief Time the save path on a RAM stand-in for the chip
+  *
+  * The live save is never touched: a pass cut short by a reset would
+  * take the settings and a wallet header with it. A flash cart keeps its
+  * sector cache and commit, with the chip swapped for a RAM flash device;
+  * the other chips are replaced by plain RAM. The write pass stores the
+  * complement of what was read, so every byte changes.
+  */
+ bool save_media_benchmark(SaveMediaBenchmark *result) {
+     if (!result) return false;
+     memset(result, 0, sizeof(SaveMediaBenchmark));
+     result->type = s_media.type;
+
+     if (s_media.type == SAVE_MEDIA_NONE) {
+         LOG_ERROR(MODULE_OPTIMIZE, "No save chip to benchmark", 0);
+         return false;
+     }
+     if (s_media.type == SAVE_MEDIA_FLASH && (!s_flash_cache || s_flash_dirty)) {
+         LOG_ERROR(MODULE_OPTIMIZE, "Flash sector not committed", s_flash_sector);
+         return false;
+     }
+
+     u32 size = s_media.size;
+     const SaveMediaOps *ops = s_media.ops;
+     u32 bytes = size < SAVE_MEDIA_BENCH_BYTES ? size : SAVE_MEDIA_BENCH_BYTES;
+
+     u8 *ram = mem_scratch_acquire(FLASH_SECTOR_SIZE, "save media benchmark");
+     if (!ram) {
+         LOG_ERROR(MODULE_OPTIMIZE, "Shared scratch busy", 0);
+         return false;
+     }
+
+     u32 mark = mem_arena_mark(&g_mem_frame);
+     u8 *before = mem_arena_alloc(&g_mem_frame, bytes);
+     u8 *pattern = mem_arena_alloc(&g_mem_frame, bytes);
+     if (!before || !pattern) {
+         mem_arena_release(&g_mem_frame, mark);
+         mem_scratch_release(ram);
+         LOG_ERROR(MODULE_OPTIMIZE, "No room for save benchmark buffers", bytes);
+         return false;
+     }
+
+     FlashDevice flash = s_flash;
+     u16 flash_sector = s_flash_sector;
+
+     if (s_media.type == SAVE_MEDIA_FLASH) {
+         flash_ram_open(&s_flash, ram, 1, true);
+         s_flash_sector = 0;
+         s_flash_cached = false;
+     } else {
+         memset(ram, 0, bytes);
+         s_bench_ram = ram;
+         save_media_select(s_media.type, bytes, &BENCH_OPS);
+     }
+     u32 offset = s_media.size - bytes;
+
+     profile_start();
+     bool ok = save_media_read(offset, before, bytes);
+     result->read_cycles = profile_stop();
+
+     for (u32 i = 0; i < bytes; i++) {
+         pattern[i] = ~before[i];
+     }
+
+     profile_start();
+     ok = ok && save_media_write(offset, pattern, bytes) && save_media_commit();
+     result->write_cycles = profile_stop();
+
+     ok = ok && save_media_read(offset, pattern, bytes);
+     for (u32 i = 0; ok && i < bytes; i++) {
+         ok = pattern[i] == (u8)~before[i];
+     }
+
+     // Back to the chip; the flash cache holds the stand-in's sector now
+     s_flash = flash;
+     s_flash_sector = flash_sector;
+     s_flash_cached = false;
+     s_flash_dirty = false;
+     save_media_select(result->type, size, ops);
+
+     mem_arena_release(&g_mem_frame, mark);
+     mem_scratch_release(ram);
+
+     result->bytes = bytes;
+     result->read_bytes_per_sec = bytes_per_sec(bytes, result->read_cycles);
+     result->write_bytes_per_sec = bytes_per_sec(bytes, result->write_cycles);
+
+     LOG_INFO(MODULE_OPTIMIZE, "Save chip type", result->type);
+     LOG_INFO(MODULE_OPTIMIZE, "Save read bytes/s", result->read_bytes_per_sec);
+     LOG_INFO(MODULE_OPTIMIZE, "Save write bytes/s", result->write_bytes_per_sec);
+
+     if (!ok) {
+         LOG_ERROR(MODULE_OPTIMIZE, "Save path benchmark failed", result->type);
+         return false;
+     }
+     return true;
+ }
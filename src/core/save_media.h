@@ -0,0 +1,170 @@
+/**
+ * @file save_media.h
+ * @brief Save chip detection and a uniform read/write/commit interface
+ *
+ * Cartridges carry one of three kinds of save chip, each with its own bus
+ * protocol: battery-backed SRAM (plain byte access), flash (command
+ * sequences, erase before write) or serial EEPROM (bit-serial transfers
+ * by DMA3). The chip is detected once at boot and every caller then goes
+ * through the same byte-addressed space, so one ROM works on any SRAM or
+ * flash cart; EEPROM carts need the chip size at build time (see
+ * SAVE_MEDIA_EEPROM_SIZE).
+ *
+ * Writes may be buffered until save_media_commit(); callers commit once
+ * per save. What the space maps to:
+ *   SRAM         the whole 32 KB chip, written through
+ *   Flash        the last 4 KB sector, cached in EWRAM and erased and
+ *                reprogrammed on commit; the sectors before it are left
+ *                to a log-structured store (see wallet_log.h)
+ *   EEPROM       the whole chip (512 bytes or 8 KB), written through in
+ *                8-byte blocks; blocks that do not change are not written
+ *
+ * The last SAVE_MEDIA_SETTINGS_BYTES of the space hold small settings
+ * records; everything below them is free for the wallet.
+ *
+ * @author Claude
+ * @date October 2026
+ * @version 1.0.0
+ */
+
+ #ifndef SAVE_MEDIA_H
+ #define SAVE_MEDIA_H
+
+ #include <tonc.h>
+ #include "save_flash.h"
+
+ /**
+  * Save chip types
+  */
+ typedef enum {
+     SAVE_MEDIA_NONE = 0,        // Nothing answered; saves fail
+     SAVE_MEDIA_SRAM,
+     SAVE_MEDIA_FLASH,
+     SAVE_MEDIA_EEPROM_512,
+     SAVE_MEDIA_EEPROM_8K,
+     SAVE_MEDIA_TYPE_COUNT
+ } SaveMediaType;
+
+ /**
+  * Sizes of the space each chip provides
+  */
+ #define SAVE_MEDIA_SRAM_SIZE        0x8000
+ #define SAVE_MEDIA_FLASH_SECTORS    1           // Sectors at the end of flash behind the space
+ #define SAVE_MEDIA_EEPROM_BLOCK     8
+
+ /**
+  * EEPROM size the ROM is built for: 0x2000, 0x200, or 0 for none
+  * An EEPROM's size can only be probed by writing to it, and a request of
+  * the wrong length corrupts the chip, so no size is assumed: EEPROM is
+  * left unused unless the build names one (-DSAVE_MEDIA_EEPROM_SIZE), as
+  * the save type in a cart's ROM header would. Every block written is
+  * read back, and a chip that does not keep the first one is dropped.
+  */
+ #ifndef SAVE_MEDIA_EEPROM_SIZE
+ #define SAVE_MEDIA_EEPROM_SIZE      0
+ #endif
+
+ #if SAVE_MEDIA_EEPROM_SIZE != 0 && SAVE_MEDIA_EEPROM_SIZE != 0x200 && SAVE_MEDIA_EEPROM_SIZE != 0x2000
+ #error "SAVE_MEDIA_EEPROM_SIZE must be 0, 0x200 or 0x2000"
+ #endif
+
+ /**
+  * Settings area at the end of the space
+  */
+ #define SAVE_MEDIA_SETTINGS_BYTES   64
+ #define SAVE_SETTINGS_PROTECTION    0           // QR protection settings (16 bytes)
+
+ /**
+  * Backend operations; offsets are relative to the start of the space
+  */
+ typedef struct {
+     const char *name;
+     bool (*read)(u32 offset, void *dst, u32 len);
+     bool (*write)(u32 offset, const void *src, u32 len);
+     bool (*commit)(void);
+ } SaveMediaOps;
+
+ /**
+  * Throughput of the save path for the detected chip, on a RAM stand-in
+  */
+ typedef struct {
+     SaveMediaType type;         // Chip the stand-in replaces
+     u32 bytes;                  // Bytes read and written per pass
+     u32 read_cycles;            // Reading them
+     u32 write_cycles;           // Writing them and committing
+     u32 read_bytes_per_sec;
+     u32 write_bytes_per_sec;
+ } SaveMediaBenchmark;
+
+ /**
+  * Detect the save chip
+  * Probes SRAM first (a byte that keeps a written value), then asks for a
+  * flash chip ID, then reads the EEPROM of SAVE_MEDIA_EEPROM_SIZE, if
+  * any. The EEPROM is only read, never written. Call once at boot, after
+  * memory_init().
+  * @return False if no save chip was found
+  */
+ bool save_media_init(void);
+
+ /**
+  * Detected chip type
+  */
+ SaveMediaType save_media_type(void);
+
+ /**
+  * Name of the detected chip, for menus and the log
+  */
+ const char *save_media_name(void);
+
+ /**
+  * Bytes addressable through save_media_read() and save_media_write()
+  */
+ u32 save_media_size(void);
+
+ /**
+  * Offset of the settings area (size minus SAVE_MEDIA_SETTINGS_BYTES)
+  */
+ u32 save_media_settings_offset(void);
+
+ /**
+  * Read bytes
+  * @param offset Offset in the space
+  * @param dst Destination buffer
+  * @param len Number of bytes
+  * @return False if the range is outside the space or no chip was found
+  */
+ bool save_media_read(u32 offset, void *dst, u32 len);
+
+ /**
+  * Write bytes; they may only reach the chip on the next commit
+  * @param offset Offset in the space
+  * @param src Bytes to write
+  * @param len Number of bytes
+  * @return False if the range is outside the space or the chip failed
+  */
+ bool save_media_write(u32 offset, const void *src, u32 len);
+
+ /**
+  * Make all writes so far persistent
+  * @return False if the chip failed
+  */
+ bool save_media_commit(void);
+
+ /**
+  * Flash chip, for stores that manage sectors themselves
+  * Sectors from sector_count - SAVE_MEDIA_FLASH_SECTORS on back the space
+  * @return The chip, or NULL if the cart has no flash
+  */
+ FlashDevice *save_media_flash(void);
+
+ /**
+  * Time reading and writing (with commit) the top of the space
+  * Runs on a RAM stand-in, so the chip itself is not timed and the save
+  * is never touched; a flash cart keeps its sector cache and commit.
+  * Borrows the shared scratch
+  * @param result Output timings
+  * @return Success status
+  */
+ bool save_media_benchmark(SaveMediaBenchmark *result);
+
+ #endif // SAVE_MEDIA_H
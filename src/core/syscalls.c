@@ -5,21 +5,16 @@
 
 #include <sys/stat.h>
 #include <errno.h>
+#include "memory_system.h"
 
-// Heap management
-extern char __heap_start;
-extern char __heap_end;
-static char *heap_ptr = &__heap_start;
-
+// Heap management: newlib gets a fixed reservation from memory_system.c
 void *_sbrk(int incr) {
-    char *prev_heap = heap_ptr;
+    void *prev_heap = mem_sbrk(incr);
 
-    if (heap_ptr + incr > &__heap_end) {
+    if (prev_heap == (void *)-1) {
         errno = ENOMEM;
-        return (void *)-1;
     }
 
-    heap_ptr += incr;
     return prev_heap;
 }
 
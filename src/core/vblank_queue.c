@@ -0,0 +1,222 @@
+/**
+ * @file vblank_queue.c
+ * @brief VBlank commit queue for VRAM, OAM and palette writes
+ *
+ * A single-producer ring buffer: the main loop appends jobs at the head,
+ * the VBlank interrupt consumes them from the tail with DMA3.
+ *
+ * Overflow policy:
+ * - Each VBlank moves at most VBLANK_QUEUE_BUDGET bytes. A job that does
+ *   not fit is split; its remainder stays at the tail for the next VBlank.
+ * - DMA3 registers are write-only and the main loop uses DMA3 as well, so
+ *   the interrupt only drains while the main loop waits in
+ *   vblank_queue_wait(). A VBlank that hits a busy (overrunning) main loop
+ *   defers the whole queue by one frame.
+ * - When the ring is full, the job is written immediately instead of being
+ *   dropped. It may tear, but the data is never lost.
+ *
+ * @author Claude
+ * @date October 2026
+ * @version 1.0.0
+ */
+
+ #include <tonc.h>
+ #include <string.h>
+ #include "vblank_queue.h"
+ #include "qr_debug.h"
+
+ #define VBLANK_QUEUE_MASK       (VBLANK_QUEUE_SIZE - 1)
+
+ /**
+  * Queued copy or fill
+  */
+ typedef struct {
+     u32 dst;                    // Destination address
+     u32 src;                    // Source address (0 for fills)
+     u32 bytes;                  // Bytes left to move
+     u32 value;                  // Fill word, DMA source for fills
+ } VBlankJob;
+
+ /**
+  * Queue state
+  */
+ typedef struct {
+     VBlankJob jobs[VBLANK_QUEUE_SIZE];
+     volatile u32 head;          // Next free slot (written by the main loop)
+     volatile u32 tail;          // Next job to drain (written by the interrupt)
+     volatile bool waiting;      // Main loop is in vblank_queue_wait()
+     fnptr hook;                 // Called first in every VBlank
+     VBlankQueueStats stats;
+ } VBlankQueue;
+
+ static VBlankQueue s_queue;
+
+ /**
+  * @brief Run part of a job with DMA3
+  *
+  * Uses 32-bit transfers when addresses and size allow, 16-bit otherwise.
+  */
+ static void vblank_job_run(VBlankJob *job, u32 bytes) {
+     bool wide = ((job->dst | job->src | bytes) & 3) == 0;
+     u32 count = wide ? bytes / 4 : bytes / 2;
+     u32 mode = wide ? DMA_32 : DMA_16;
+
+     if (job->src) {
+         REG_DMA3SAD = job->src;
+         job->src += bytes;
+     } else {
+         REG_DMA3SAD = (u32)&job->value;
+         mode |= DMA_SRC_FIXED;
+     }
+     REG_DMA3DAD = job->dst;
+     REG_DMA3CNT = DMA_ENABLE | mode | count;
+
+     job->dst += bytes;
+     job->bytes -= bytes;
+ }
+
+ /**
+  * @brief Drain the queue within the per-VBlank budget
+  */
+ static void vblank_queue_drain(void) {
+     u32 budget = VBLANK_QUEUE_BUDGET;
+     u32 moved = 0;
+     u32 done = 0;
+     u32 tail = s_queue.tail;
+
+     while (tail != s_queue.head && budget > 0) {
+         VBlankJob *job = &s_queue.jobs[tail & VBLANK_QUEUE_MASK];
+         u32 bytes = job->bytes;
+
+         if (bytes > budget) {
+             // Split: keep the transfer unit so the remainder stays aligned
+             bytes = budget & ~3;
+             if (bytes == 0) break;
+         }
+
+         vblank_job_run(job, bytes);
+         budget -= bytes;
+         moved += bytes;
+
+         if (job->bytes == 0) {
+             tail++;
+             done++;
+         }
+     }
+
+     s_queue.tail = tail;
+
+     u32 deferred = 0;
+     for (u32 i = tail; i != s_queue.head; i++) {
+         deferred += s_queue.jobs[i & VBLANK_QUEUE_MASK].bytes;
+     }
+
+     s_queue.stats.bytes = moved;
+     s_queue.stats.jobs = done;
+     s_queue.stats.deferred_bytes = deferred;
+     s_queue.stats.total_bytes += moved;
+     if (moved > s_queue.stats.peak_bytes) {
+         s_queue.stats.peak_bytes = moved;
+     }
+ }
+
+ /**
+  * @brief VBlank interrupt: run the hook, then drain if the main loop waits
+  */
+ static void vblank_queue_isr(void) {
+     s_queue.stats.frames++;
+
+     if (s_queue.hook) {
+         s_queue.hook();
+     }
+
+     if (!s_queue.waiting) {
+         if (s_queue.tail != s_queue.head) {
+             s_queue.stats.missed_frames++;
+         }
+         return;
+     }
+
+     vblank_queue_drain();
+ }
+
+ /**
+  * @brief Install the VBlank interrupt that drains the queue
+  */
+ void vblank_queue_init(void) {
+     memset(&s_queue, 0, sizeof(s_queue));
+     irq_add(II_VBLANK, vblank_queue_isr);
+
+     LOG_INFO(MODULE_SYSTEM, "VBlank queue initialized", VBLANK_QUEUE_SIZE);
+ }
+
+ /**
+  * @brief Wait for VBlank, letting the interrupt drain the queue
+  */
+ void vblank_queue_wait(void) {
+     s_queue.waiting = true;
+     VBlankIntrWait();
+     s_queue.waiting = false;
+ }
+
+ /**
+  * @brief Set a function the VBlank interrupt calls before draining
+  */
+ void vblank_queue_set_hook(fnptr hook) {
+     s_queue.hook = hook;
+ }
+
+ /**
+  * @brief Append a job, or run it now if the ring is full
+  */
+ static bool vblank_queue_push(u32 dst, u32 src, u32 value, u32 bytes) {
+     if (((dst | src | bytes) & 1) != 0) {
+         LOG_ERROR(MODULE_SYSTEM, "Misaligned VBlank job", bytes);
+         return false;
+     }
+     if (bytes == 0) return true;
+
+     u32 head = s_queue.head;
+     VBlankJob job = { dst, src, bytes, value };
+
+     if (head - s_queue.tail >= VBLANK_QUEUE_SIZE) {
+         s_queue.stats.direct_jobs++;
+         vblank_job_run(&job, bytes);
+         return true;
+     }
+
+     s_queue.jobs[head & VBLANK_QUEUE_MASK] = job;
+     s_queue.head = head + 1;
+     return true;
+ }
+
+ /**
+  * @brief Queue a copy for the next VBlank
+  *
+  * @param dst Destination (VRAM, OAM or palette)
+  * @param src Source, read when the job is drained
+  * @param bytes Size in bytes (multiple of 2)
+  * @return False if the job is misaligned
+  */
+ bool vblank_queue_copy(void *dst, const void *src, u32 bytes) {
+     return vblank_queue_push((u32)dst, (u32)src, 0, bytes);
+ }
+
+ /**
+  * @brief Queue a fill for the next VBlank
+  *
+  * @param dst Destination (VRAM, OAM or palette)
+  * @param value Fill word
+  * @param bytes Size in bytes (multiple of 2)
+  * @return False if the job is misaligned
+  */
+ bool vblank_queue_fill(void *dst, u32 value, u32 bytes) {
+     return vblank_queue_push((u32)dst, 0, value, bytes);
+ }
+
+ /**
+  * @brief Statistics of the last VBlank and totals
+  */
+ const VBlankQueueStats *vblank_queue_stats(void) {
+     return &s_queue.stats;
+ }
@@ -0,0 +1,86 @@
+/**
+ * @file vblank_queue.h
+ * @brief VBlank commit queue for VRAM, OAM and palette writes
+ *
+ * Rendering code enqueues copy and fill jobs while it runs; the VBlank
+ * interrupt drains them with DMA3, so the writes never land mid-frame and
+ * don't compete with the main loop for the bus during the visible period.
+ *
+ * @author Claude
+ * @date October 2026
+ * @version 1.0.0
+ */
+
+ #ifndef VBLANK_QUEUE_H
+ #define VBLANK_QUEUE_H
+
+ #include <tonc.h>
+
+ /**
+  * Jobs the ring buffer holds (power of two)
+  */
+ #define VBLANK_QUEUE_SIZE       64
+
+ /**
+  * Bytes drained per VBlank; the rest is deferred to the next VBlank
+  * DMA3 moves a word in about 4 cycles, so this stays well inside the
+  * ~83,000-cycle VBlank and leaves time for the main loop's VBlank steps
+  */
+ #define VBLANK_QUEUE_BUDGET     16384
+
+ /**
+  * Per-frame queue statistics
+  */
+ typedef struct {
+     u32 frames;                 // VBlanks seen
+     u32 bytes;                  // Bytes moved in the last VBlank
+     u32 jobs;                   // Jobs finished in the last VBlank
+     u32 deferred_bytes;         // Bytes left queued after the last VBlank
+     u32 peak_bytes;             // Most bytes moved in one VBlank
+     u32 total_bytes;            // Bytes moved since start
+     u32 missed_frames;          // VBlanks that hit a busy main loop (nothing drained)
+     u32 direct_jobs;            // Jobs written immediately because the ring was full
+ } VBlankQueueStats;
+
+ /**
+  * Install the VBlank interrupt that drains the queue
+  */
+ void vblank_queue_init(void);
+
+ /**
+  * Wait for VBlank; the queue is only drained while the main loop waits here
+  */
+ void vblank_queue_wait(void);
+
+ /**
+  * Set a function the VBlank interrupt calls before draining
+  * Replaces irq_add(II_VBLANK, ...), which would remove the queue's handler
+  * @param hook Function to call, or NULL
+  */
+ void vblank_queue_set_hook(fnptr hook);
+
+ /**
+  * Queue a copy for the next VBlank
+  * The source is read when the job is drained and must stay valid until then
+  * @param dst Destination (VRAM, OAM or palette)
+  * @param src Source
+  * @param bytes Size in bytes (multiple of 2; addresses aligned to match)
+  * @return False if the job is misaligned
+  */
+ bool vblank_queue_copy(void *dst, const void *src, u32 bytes);
+
+ /**
+  * Queue a fill for the next VBlank
+  * @param dst Destination (VRAM, OAM or palette)
+  * @param value Fill word (repeated; halfword fills use the low 16 bits twice)
+  * @param bytes Size in bytes (multiple of 2; address aligned to match)
+  * @return False if the job is misaligned
+  */
+ bool vblank_queue_fill(void *dst, u32 value, u32 bytes);
+
+ /**
+  * Statistics of the last VBlank and totals
+  */
+ const VBlankQueueStats *vblank_queue_stats(void);
+
+ #endif // VBLANK_QUEUE_H
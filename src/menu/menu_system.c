@@ -15,6 +15,8 @@
 
  #include "menu_system.h"
  #include "menu_sprite.h"
+ #include "display_compositor.h"
+ #include "vblank_queue.h"
  
  // =====================================================================
  // VARIABLES GLOBALES
@@ -48,6 +50,30 @@
  static void menu_update_cursor_position(MenuSystem *menu);
  static void menu_animate_cursor(MenuSystem *menu);
  
+ // Map the menu background layer shows
+ #define MENU_BG_MAP_BLOCK   29
+ 
+ // Menu screen: text on BG0, menu background on BG1, cursor sprite
+ static const DisplayScreen menu_screen = {
+     .name = "Menu screen shown",
+     .mode = DCNT_MODE0,
+     .bg = {
+         [TEXT_LAYER_BG] = {
+             DISPLAY_OWNER_TEXT,
+             BG_CBB(TEXT_CHAR_BLOCK) | BG_SBB(TEXT_SCREEN_BLOCK) | BG_4BPP | BG_REG_32x32 | BG_PRIO(2),
+             DISPLAY_CBB_BLOCKS(TEXT_CHAR_BLOCK) | BIT(TEXT_SCREEN_BLOCK)
+         },
+         [1] = {
+             DISPLAY_OWNER_MENU,
+             BG_CBB(MENU_BG_CHAR_BLOCK) | BG_SBB(MENU_BG_MAP_BLOCK) | BG_4BPP | BG_REG_32x32 | BG_PRIO(1),
+             DISPLAY_CBB_BLOCKS(MENU_BG_CHAR_BLOCK) | BIT(MENU_BG_SCREEN_BLOCK) | BIT(MENU_BG_MAP_BLOCK)
+         }
+     },
+     .obj_owner = DISPLAY_OWNER_MENU,
+     .obj_first = 0,
+     .obj_count = (CURSOR_WIDTH * CURSOR_HEIGHT) / 64
+ };
+ 
  // Global text system instance
  static TextLayerSystem text_system = {
      .x = 0,
@@ -324,25 +350,55 @@
      menu_init_graphics();
  }
  
+ /**
+  * @brief Upload the cursor sprite tiles and palette
+  */
+ static void menu_upload_cursor(void) {
+     memcpy(&tile_mem[4][0], cursor_sprite_data, sizeof(cursor_sprite_data));
+     memcpy(pal_obj_mem, cursor_sprite_pal, sizeof(cursor_sprite_pal));
+ }
+ 
  /**
   * @brief Initialize the menu graphics
   */
  void menu_init_graphics() {
-     // Configure video mode
-     REG_DISPCNT = DCNT_MODE0 | DCNT_BG0 | DCNT_BG1 | DCNT_OBJ | DCNT_OBJ_1D;
-     
      // Initialize sprite system for cursor
      oam_init(obj_buffer, 128);
      
-     // Load cursor sprite data
-     memcpy(&tile_mem[4][0], cursor_sprite_data, sizeof(cursor_sprite_data));
+     // Layers are switched on by the compositor at the next VBlank
+     display_show(&menu_screen);
      
-     // Load cursor palette
-     memcpy(pal_obj_mem, cursor_sprite_pal, sizeof(cursor_sprite_pal));
+     // Load cursor sprite data and palette
+     menu_upload_cursor();
+ }
+ 
+ /**
+  * @brief Restore text and menu graphics after another screen
+  *
+  * Only what the other screen actually overwrote is set up again: a
+  * bitmap mode that spared CBB 0 keeps the font and text map, and
+  * tiled QR layers leave both untouched. Nothing is drawn on the menu
+  * background, so a lost one gets an empty map on a blank tile 0 again;
+  * otherwise framebuffer bytes would show through BG1 as tiles.
+  */
+ void menu_restore_graphics(void) {
+     u32 lost = display_show(&menu_screen);
      
-     // Initialize backgrounds for menu
-     REG_BG0CNT = BG_CBB(0) | BG_SBB(30) | BG_4BPP | BG_REG_32x32 | BG_PRIO(2);
-     REG_BG1CNT = BG_CBB(1) | BG_SBB(29) | BG_4BPP | BG_REG_32x32 | BG_PRIO(1);
+     if (lost) {
+         // The old screen is still shown until VBlank
+         display_blank_now();
+     }
+     
+     if (lost & BIT(DISPLAY_OWNER_TEXT)) {
+         text_system.init(&text_system);
+         text_system.needs_full_update = true;
+     }
+     
+     if (lost & BIT(DISPLAY_OWNER_MENU)) {
+         memset32(&tile_mem[MENU_BG_CHAR_BLOCK][0], 0, sizeof(TILE) / 4);
+         memset32(se_mem[MENU_BG_MAP_BLOCK], 0, sizeof(SCREENBLOCK) / 4);
+         menu_upload_cursor();
+     }
  }
  
  /**
@@ -683,8 +739,8 @@
                      ATTR1_SIZE_16 | ATTR1_X((int)menu->cursor_x), 
                      ATTR2_PALBANK(0) | 0);
          
-         // Update OAM
-         oam_copy(oam_mem, obj_buffer, 1);
+         // Update OAM in the next VBlank
+         vblank_queue_copy(oam_mem, obj_buffer, sizeof(OBJ_ATTR));
      } else {
          // Hide cursor
          obj_set_attr(&obj_buffer[0], 
@@ -692,7 +748,7 @@
                      0, 
                      0);
          
-         // Update OAM
-         oam_copy(oam_mem, obj_buffer, 1);
+         // Update OAM in the next VBlank
+         vblank_queue_copy(oam_mem, obj_buffer, sizeof(OBJ_ATTR));
      }
  }
\ No newline at end of file
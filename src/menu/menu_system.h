@@ -182,6 +182,7 @@
  MenuSystem* menu_system_get_instance();
  void menu_system_init(MenuSystem *menu);
  void menu_init_graphics();
+ void menu_restore_graphics(void);
  void menu_system_set_active_menu(MenuSystem *menu, MenuItem *item);
  void menu_system_return_to_previous(MenuSystem *menu);
  void menu_system_update(MenuSystem *menu);
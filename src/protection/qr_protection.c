@@ -72,7 +72,10 @@
   * Initialize the QR protection system
   */
  void qr_protection_init(void) {
-     // Clear system state
+     // Return matrices from an earlier init to the QR pool, then clear system state
+     for (int i = 0; i < QR_MAX_VARIATIONS; i++) {
+         qr_free(&g_qr_protection.variations[i]);
+     }
      memset(&g_qr_protection, 0, sizeof(QrProtectionSystem));
      
      // Initialize QR variations and buffers
@@ -116,6 +119,10 @@
          
          g_qr_protection.variation_count = 1;
          g_qr_protection.current_variation = 0;
+         qr_protection_display_invalidate();
+         qr_protection_atlas_invalidate();
+         qr_protection_palette_invalidate();
+         qr_protection_delta_build();
          return true;
      }
      
@@ -155,6 +162,13 @@
      g_qr_protection.variation_count = num_variations;
      g_qr_protection.current_variation = 0;
      
+     // Pages, atlas maps and the packed image built from the old
+     // variations are stale now
+     qr_protection_display_invalidate();
+     qr_protection_atlas_invalidate();
+     qr_protection_palette_invalidate();
+     qr_protection_delta_build();
+     
      // Calculate frames between switches based on refresh rate
      if (params->refresh_rate > 0) {
          g_qr_protection.display_frames = 60 / params->refresh_rate;
@@ -357,10 +371,20 @@
          return false; // Fall back to normal rendering
      }
      
-     // Get current variation
-     int current = g_qr_protection.current_variation;
-     QrState *qr = &g_qr_protection.variations[current];
+     // The page-flipped display already shows the current variation
+     if (qr_protection_display_active()) {
+         return true;
+     }
+     
+     // Prefer the packed palette image (up to four variations), then the
+     // VRAM atlas: variation switches then happen in VBlank
+     if (qr_protection_palette_show(x, y, scale)) {
+         return true;
+     }
+     if (qr_protection_atlas_show(x, y, scale)) {
+         return true;
+     }
      
-     // Render this variation
-     return render_qr_to_screen(qr, x, y, scale);
+     // Bitmap fallback: repaint only the modules that changed
+     return qr_protection_delta_render(x, y, scale);
  }
\ No newline at end of file
@@ -93,6 +93,24 @@
   * @return Pointer to current parameters
   */
  const QrProtectionParams* qr_protection_get_params(void);
+
+ /**
+  * Persistent settings
+  * The level and parameters are kept in the save chip's settings area
+  * (see save_media.h) as one CRC-checked record
+  */
+
+ /**
+  * Restore the saved level and parameters; keeps the defaults if none are saved
+  * @return True if saved settings were applied
+  */
+ bool qr_protection_load_settings(void);
+
+ /**
+  * Save the current level and parameters; does nothing if they are unchanged
+  * @return Success status
+  */
+ bool qr_protection_save_settings(void);
  
  /**
   * Update protection system
@@ -109,6 +127,150 @@
   */
  bool qr_protection_render(int x, int y, int scale);
  
+ /**
+  * Page-flipped display
+  * Keeps the shown variation on the front page of Mode 4 and pre-renders
+  * the next one into the back page, so a switch is a DCNT_PAGE toggle
+  */
+
+ /**
+  * Start the page-flipped display (switches to Mode 4)
+  * @param x X position of the symbol (rounded down to even)
+  * @param y Y position of the symbol
+  * @param scale Module scale in pixels
+  * @return Success status
+  */
+ bool qr_protection_display_begin(int x, int y, int scale);
+
+ /**
+  * Stop the page-flipped display and restore menu graphics
+  */
+ void qr_protection_display_end(void);
+
+ /**
+  * Whether the page-flipped display owns the screen
+  * @return True while active
+  */
+ bool qr_protection_display_active(void);
+
+ /**
+  * Discard pre-rendered pages after variations changed
+  */
+ void qr_protection_display_invalidate(void);
+
+ /**
+  * Flip pages if needed; call right after VBlankIntrWait()
+  */
+ void qr_protection_display_vblank(void);
+
+ /**
+  * Pre-render the next variation into the back page; call in idle time
+  */
+ void qr_protection_display_idle(void);
+
+ /**
+  * Palette-encoded display
+  * Up to four variations packed into one 4bpp image; bit k of a pixel's
+  * palette index is the module color in variation k, so a switch is a
+  * 16-entry palette load in VBlank
+  */
+ #define QR_PALETTE_MAX_VARIATIONS 4
+ #define QR_PALETTE_BANK           14
+
+ /**
+  * Show the current variation from the packed image on BG2, building it if needed
+  * @param x X position on screen
+  * @param y Y position on screen
+  * @param scale Module scale
+  * @return False if the variations can't be packed; render otherwise
+  */
+ bool qr_protection_palette_show(int x, int y, int scale);
+
+ /**
+  * Hide the packed image layer
+  */
+ void qr_protection_palette_hide(void);
+
+ /**
+  * Discard the packed image after variations changed
+  */
+ void qr_protection_palette_invalidate(void);
+
+ /**
+  * Load the current variation's palette; call right after VBlankIntrWait()
+  */
+ void qr_protection_palette_vblank(void);
+
+ /**
+  * VRAM variation atlas
+  * Every variation map lives in its own screen block over one shared tile
+  * set, so a switch is a single REG_BG2CNT screen-base write in VBlank
+  */
+ typedef struct {
+     int tile_count;                     // Shared tiles needed (-1 = dictionary full)
+     int tile_blocks;                    // Screen blocks taken by those tiles
+     int free_blocks;                    // Screen blocks left for maps
+     int variations_fit;                 // Variation maps that can be placed
+     u8 map_blocks[QR_MAX_VARIATIONS];   // Screen block of each variation map
+ } QrAtlasPlan;
+
+ /**
+  * Plan VRAM usage for the current variations (uploads their tiles)
+  * @param scale Module scale
+  * @param plan Receives the tile count and screen block assignment
+  * @return True if every variation fits
+  */
+ bool qr_protection_atlas_plan(int scale, QrAtlasPlan *plan);
+
+ /**
+  * Show the current variation from the atlas on BG2, building it if needed
+  * @param x X position on screen
+  * @param y Y position on screen
+  * @param scale Module scale
+  * @return False if the variations don't fit; render normally instead
+  */
+ bool qr_protection_atlas_show(int x, int y, int scale);
+
+ /**
+  * Hide the atlas layer
+  */
+ void qr_protection_atlas_hide(void);
+
+ /**
+  * Discard the atlas after variations changed
+  */
+ void qr_protection_atlas_invalidate(void);
+
+ /**
+  * Switch BG2 to the current variation's map; call right after VBlankIntrWait()
+  */
+ void qr_protection_atlas_vblank(void);
+
+ /**
+  * Delta playback (bitmap mode)
+  * Only the modules that differ between consecutive variations are
+  * repainted on a switch
+  */
+
+ /**
+  * Record the changed modules of every transition; call after generating variations
+  */
+ void qr_protection_delta_build(void);
+
+ /**
+  * Forget the framebuffer contents; the next render is a full redraw
+  */
+ void qr_protection_delta_reset(void);
+
+ /**
+  * Render the current variation, repainting only changed modules when possible
+  * @param x X position on screen
+  * @param y Y position on screen
+  * @param scale Module scale
+  * @return Success status
+  */
+ bool qr_protection_delta_render(int x, int y, int scale);
+
  /**
   * Apply module inversion to QR code
   * Randomly inverts non-essential modules for visual variation
@@ -0,0 +1,218 @@
+/**
+ * @file qr_protection_atlas.c
+ * @brief VRAM-resident atlas of protection variations on the tile layer
+ *
+ * All protection variations are uploaded once as tile maps, each in its own
+ * screen block, sharing a single de-duplicated tile set in the QR char
+ * block. Switching variation is then one BG2 screen-base change in
+ * VBlank instead of a redraw.
+ *
+ * A budget planner decides which screen blocks hold the maps. The tiles
+ * start at CBB 2 (SBB 16); the maps may use any screen block the display
+ * compositor has not reserved for another owner (text, menu, affine QR
+ * layer), other than the single-symbol tile map (SBB 26) and the tiles
+ * themselves.
+ * If not every variation fits, the caller falls back to regular rendering.
+ *
+ * @author Claude
+ * @date October 2026
+ * @version 1.0.0
+ */
+
+ #include <tonc.h>
+ #include <string.h>
+ #include "qr_protection.h"
+ #include "menu_system.h"
+ #include "display_compositor.h"
+
+ /**
+  * Atlas state
+  */
+ typedef struct {
+     bool built;                 // Whether a build was attempted for the current variations
+     bool fits;                  // Whether that build placed every variation
+     bool active;                // Whether the atlas owns BG2
+     int scale;                  // Module scale the maps were built for
+     u32 tile_generation;        // Tile set generation the maps refer to
+     int shown_variation;        // Variation whose map BG2 points at (-1 = none)
+     u32 map_mask;               // Screen blocks holding the maps (0 until built)
+     QrAtlasPlan plan;           // Screen block assignment
+ } QrVariationAtlas;
+
+ static QrVariationAtlas s_atlas = {
+     .shown_variation = -1
+ };
+
+ /**
+  * @brief Plan VRAM usage for the current variations at a scale
+  *
+  * Registers the tiles of every variation (uploading them), then assigns
+  * one free screen block per variation map. Leaves the QR tile set
+  * holding exactly the tiles of these variations.
+  *
+  * @param scale Module scale
+  * @param plan Filled with the tile count and screen block assignment
+  * @return True if every variation has a screen block
+  */
+ bool qr_protection_atlas_plan(int scale, QrAtlasPlan *plan) {
+     memset(plan, 0, sizeof(*plan));
+
+     int count = g_qr_protection.variation_count;
+     if (count <= 0 || count > QR_MAX_VARIATIONS) {
+         return false;
+     }
+
+     qr_tile_reset(scale);
+
+     for (int i = 0; i < count; i++) {
+         const QrState *qr = &g_qr_protection.variations[i];
+         if (!qr->data || (qr->size * scale + 7) / 8 > 32) {
+             return false;
+         }
+         if (qr_tile_emit_map(qr, scale, NULL) < 0) {
+             plan->tile_count = -1;
+             return false;
+         }
+     }
+
+     // Tile 0 is the transparent tile
+     plan->tile_count = qr_tile_count();
+     plan->tile_blocks = ((plan->tile_count + 1) * sizeof(TILE) + sizeof(SCREENBLOCK) - 1) /
+                         sizeof(SCREENBLOCK);
+
+     u32 used = BIT(QR_TILE_SCREEN_BLOCK) |
+                (((1u << plan->tile_blocks) - 1) << (QR_TILE_CHAR_BLOCK * 8));
+     u32 free = display_free_blocks(DISPLAY_OWNER_QR_TILES, ~used);
+
+     for (int sbb = 0; sbb < 32; sbb++) {
+         if (!(free & BIT(sbb))) continue;
+
+         plan->free_blocks++;
+         if (plan->variations_fit < QR_MAX_VARIATIONS) {
+             plan->map_blocks[plan->variations_fit++] = sbb;
+         }
+     }
+
+     LOG_INFO(MODULE_PROTECT, "Atlas tiles planned", plan->tile_count);
+     LOG_INFO(MODULE_PROTECT, "Atlas variations that fit", plan->variations_fit);
+
+     return plan->variations_fit >= count;
+ }
+
+ /**
+  * @brief Upload every variation map into its planned screen block
+  */
+ static bool qr_atlas_build(int scale) {
+     if (!qr_protection_atlas_plan(scale, &s_atlas.plan)) {
+         LOG_ERROR(MODULE_PROTECT, "Variations don't fit VRAM atlas", g_qr_protection.variation_count);
+         return false;
+     }
+
+     for (int i = 0; i < g_qr_protection.variation_count; i++) {
+         SCR_ENTRY *map = se_mem[s_atlas.plan.map_blocks[i]];
+         memset32(map, 0, sizeof(SCREENBLOCK) / 4);
+
+         if (qr_tile_emit_map(&g_qr_protection.variations[i], scale, map) < 0) {
+             return false;
+         }
+         s_atlas.map_mask |= BIT(s_atlas.plan.map_blocks[i]);
+     }
+
+     // The maps belong to the tile set they index
+     display_claim(DISPLAY_OWNER_QR_TILES, s_atlas.map_mask);
+     return true;
+ }
+
+ /**
+  * @brief Show the current variation from the atlas on BG2
+  *
+  * Builds the atlas when the variations, scale or shared tile set changed.
+  * Once built, only the scroll position and display control are written;
+  * variation switches happen in qr_protection_atlas_vblank().
+  *
+  * @param x X position on screen
+  * @param y Y position on screen
+  * @param scale Module scale
+  * @return False if the atlas can't hold the variations (render normally)
+  */
+ bool qr_protection_atlas_show(int x, int y, int scale) {
+     int count = g_qr_protection.variation_count;
+     if (count <= 0) return false;
+
+     int width = g_qr_protection.variations[0].size * scale;
+     if (scale < 1 || x < 0 || y < 0 ||
+         x + width > SCREEN_WIDTH || y + width > SCREEN_HEIGHT) {
+         return false;
+     }
+
+     qr_tile_claim_vram(s_atlas.map_mask);
+
+     if (!s_atlas.built || s_atlas.scale != scale ||
+         s_atlas.tile_generation != qr_tile_generation()) {
+
+         s_atlas.built = true;
+         s_atlas.map_mask = 0;
+         s_atlas.scale = scale;
+         s_atlas.fits = qr_atlas_build(scale);
+         s_atlas.tile_generation = qr_tile_generation();
+         s_atlas.shown_variation = -1;
+
+         if (s_atlas.fits) {
+             LOG_INFO(MODULE_PROTECT, "VRAM atlas built", count);
+         }
+     }
+
+     if (!s_atlas.fits) {
+         s_atlas.active = false;
+         return false;
+     }
+
+     if (s_atlas.shown_variation < 0) {
+         s_atlas.shown_variation = g_qr_protection.current_variation;
+     }
+
+     display_set_bg(2, BG_CBB(QR_TILE_CHAR_BLOCK) |
+                       BG_SBB(s_atlas.plan.map_blocks[s_atlas.shown_variation]) |
+                       BG_4BPP | BG_REG_32x32 | BG_PRIO(0));
+     REG_BG2HOFS = (u16)(-x);
+     REG_BG2VOFS = (u16)(-y);
+     display_set_mode(DCNT_MODE0);
+     display_enable(DCNT_BG2);
+
+     s_atlas.active = true;
+     return true;
+ }
+
+ /**
+  * @brief Hide the atlas layer and stop switching screen blocks
+  */
+ void qr_protection_atlas_hide(void) {
+     if (!s_atlas.active) return;
+
+     s_atlas.active = false;
+     render_qr_tile_hide();
+ }
+
+ /**
+  * @brief Drop the atlas after variations were regenerated
+  */
+ void qr_protection_atlas_invalidate(void) {
+     s_atlas.built = false;
+     s_atlas.active = false;
+     s_atlas.shown_variation = -1;
+ }
+
+ /**
+  * @brief VBlank step: point BG2 at the current variation's map
+  *
+  * Must run at the start of VBlank so the switch never tears.
+  */
+ void qr_protection_atlas_vblank(void) {
+     if (!s_atlas.active) return;
+
+     int current = g_qr_protection.current_variation;
+     if (current == s_atlas.shown_variation || current >= g_qr_protection.variation_count) return;
+
+     display_set_bg(2, (display_bg(2) & ~BG_SBB_MASK) | BG_SBB(s_atlas.plan.map_blocks[current]));
+     s_atlas.shown_variation = current;
+ }
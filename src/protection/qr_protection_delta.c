@@ -0,0 +1,178 @@
+/**
+ * @file qr_protection_delta.c
+ * @brief Delta playback of protection variations in bitmap mode
+ *
+ * Consecutive variations differ only in a subset of modules (mask pattern,
+ * sparse inversions). When variations are generated, the modules that
+ * change on each transition i -> i+1 are recorded once. Playback then
+ * repaints just those modules, so a switch costs time proportional to the
+ * number of differing modules instead of the symbol area.
+ *
+ * This is the fallback for Mode 3, where neither the page-flipped display
+ * nor the tile-based atlas is in use. Callers must report with
+ * qr_protection_delta_reset() whenever the framebuffer was overwritten.
+ *
+ * @author Claude
+ * @date October 2026
+ * @version 1.0.0
+ */
+
+ #include <tonc.h>
+ #include <string.h>
+ #include "qr_protection.h"
+
+ // Module value for dark modules (as in qr_rendering.c)
+ #define QR_MODULE_BLACK 1
+
+ // Changed modules stored across all transitions; packed as (y << 8) | x
+ #define QR_DELTA_POOL_SIZE      6144
+
+ /**
+  * Changed modules of one transition
+  */
+ typedef struct {
+     u16 start;                  // First entry in the pool
+     u16 count;                  // Number of changed modules
+     bool valid;                 // False if the pool ran out (full redraw)
+ } QrDeltaTransition;
+
+ /**
+  * Delta playback state
+  */
+ typedef struct {
+     QrDeltaTransition transitions[QR_MAX_VARIATIONS]; // Transition i -> i+1
+     int shown_variation;        // Variation in the framebuffer (-1 = unknown)
+     int x, y, scale;            // Where it was drawn
+ } QrDeltaPlayer;
+
+ static u16 s_delta_pool[QR_DELTA_POOL_SIZE];
+ static QrDeltaPlayer s_delta = {
+     .shown_variation = -1
+ };
+
+ /**
+  * @brief Record the changed modules of every variation transition
+  *
+  * Call after the variations were regenerated. Transitions that don't fit
+  * the pool fall back to a full redraw.
+  */
+ void qr_protection_delta_build(void) {
+     int count = g_qr_protection.variation_count;
+     int used = 0;
+
+     memset(s_delta.transitions, 0, sizeof(s_delta.transitions));
+     s_delta.shown_variation = -1;
+
+     if (count <= 1) return;
+
+     for (int i = 0; i < count; i++) {
+         const QrState *from = &g_qr_protection.variations[i];
+         const QrState *to = &g_qr_protection.variations[(i + 1) % count];
+         QrDeltaTransition *delta = &s_delta.transitions[i];
+
+         if (!from->data || !to->data || from->size != to->size) continue;
+
+         int size = to->size;
+         int start = used;
+         bool overflow = false;
+
+         for (int my = 0; my < size && !overflow; my++) {
+             const u8 *a = &from->data[my * size];
+             const u8 *b = &to->data[my * size];
+             for (int mx = 0; mx < size; mx++) {
+                 if (a[mx] == b[mx]) continue;
+
+                 if (used >= QR_DELTA_POOL_SIZE) {
+                     overflow = true;
+                     break;
+                 }
+                 s_delta_pool[used++] = (u16)((my << 8) | mx);
+             }
+         }
+
+         if (overflow) {
+             // Give the space back so later transitions can still use it
+             used = start;
+             LOG_ERROR(MODULE_PROTECT, "Delta pool full for transition", i);
+             continue;
+         }
+
+         delta->start = start;
+         delta->count = used - start;
+         delta->valid = true;
+     }
+
+     LOG_INFO(MODULE_PROTECT, "Variation deltas recorded", used);
+ }
+
+ /**
+  * @brief Forget what the framebuffer shows; the next render is a full redraw
+  */
+ void qr_protection_delta_reset(void) {
+     s_delta.shown_variation = -1;
+ }
+
+ /**
+  * @brief Repaint the modules that change on a transition
+  */
+ static void qr_delta_apply(const QrDeltaTransition *delta, const QrState *qr) {
+     int scale = s_delta.scale;
+     const u16 *entry = &s_delta_pool[delta->start];
+
+     for (int i = 0; i < delta->count; i++) {
+         int mx = entry[i] & 0xFF;
+         int my = entry[i] >> 8;
+         u16 color = (qr->data[my * qr->size + mx] == QR_MODULE_BLACK) ? CLR_BLACK : CLR_WHITE;
+
+         u16 *dst = &m3_mem[s_delta.y + my * scale][s_delta.x + mx * scale];
+         for (int py = 0; py < scale; py++) {
+             for (int px = 0; px < scale; px++) {
+                 dst[px] = color;
+             }
+             dst += SCREEN_WIDTH;
+         }
+     }
+ }
+
+ /**
+  * @brief Render the current variation, repainting only changed modules
+  *
+  * Does nothing if the framebuffer already shows the current variation at
+  * this position, applies the recorded delta if it shows the previous one,
+  * and falls back to a full render otherwise.
+  *
+  * @param x X position on screen
+  * @param y Y position on screen
+  * @param scale Module scale
+  * @return Success status
+  */
+ bool qr_protection_delta_render(int x, int y, int scale) {
+     int count = g_qr_protection.variation_count;
+     int current = g_qr_protection.current_variation;
+     QrState *qr = &g_qr_protection.variations[current];
+
+     bool same_place = (s_delta.shown_variation >= 0 &&
+                        s_delta.x == x && s_delta.y == y && s_delta.scale == scale);
+
+     if (same_place && s_delta.shown_variation == current) {
+         return true;
+     }
+
+     if (same_place && (s_delta.shown_variation + 1) % count == current &&
+         s_delta.transitions[s_delta.shown_variation].valid) {
+         qr_delta_apply(&s_delta.transitions[s_delta.shown_variation], qr);
+         s_delta.shown_variation = current;
+         return true;
+     }
+
+     if (!render_qr_to_screen(qr, x, y, scale)) {
+         s_delta.shown_variation = -1;
+         return false;
+     }
+
+     s_delta.shown_variation = current;
+     s_delta.x = x;
+     s_delta.y = y;
+     s_delta.scale = scale;
+     return true;
+ }
@@ -0,0 +1,249 @@
+/**
+ * @file qr_protection_display.c
+ * @brief Page-flipped Mode 4 display for protected QR variations
+ *
+ * Protection variations only change 5-10 times per second, yet redrawing the
+ * current variation every frame costs a full symbol render and tears when the
+ * switch lands mid-frame. This display keeps the visible variation on the
+ * front page of Mode 4 and pre-renders the upcoming one into the back page
+ * during idle time. A switch is then a single DCNT_PAGE toggle in VBlank.
+ *
+ * Frame flow (driven from the main loop):
+ * 1. qr_protection_display_vblank() right after VBlankIntrWait(): flips
+ *    pages when the back page holds the variation that is now current.
+ * 2. qr_protection_update() advances the current variation.
+ * 3. qr_protection_display_idle() at the end of the frame: renders the
+ *    variation needed next into the back page if it is not there yet.
+ *
+ * Mode 4 pages overlap the text and sprite tiles; they are claimed from
+ * the display compositor, so the menu and QR layers reload them when
+ * shown again.
+ *
+ * @author Claude
+ * @date October 2026
+ * @version 1.0.0
+ */
+
+ #include <tonc.h>
+ #include <string.h>
+ #include "qr_protection.h"
+ #include "menu_system.h"
+ #include "display_compositor.h"
+
+ // Mode 4 palette indices, shared with the tile renderer's palette bank
+ #define QR_PAGE_CLR_BACKDROP    0
+ #define QR_PAGE_CLR_WHITE       (QR_TILE_PALETTE_BANK * 16 + 1)
+ #define QR_PAGE_CLR_BLACK       (QR_TILE_PALETTE_BANK * 16 + 2)
+
+ // Quiet zone drawn around the symbol, in modules
+ #define QR_PAGE_QUIET_ZONE      4
+
+ /**
+  * Page-flip display state
+  */
+ typedef struct {
+     bool active;                // Whether the display owns the screen
+     int x, y;                   // Symbol position (x is kept even)
+     int scale;                  // Module scale in pixels
+     int front_variation;        // Variation on the displayed page (-1 = none)
+     int back_variation;         // Variation on the hidden page (-1 = none)
+ } QrPageFlipDisplay;
+
+ // Both Mode 4 pages on BG2; page 1 reaches into the lower OBJ tiles
+ static const DisplayScreen s_page_screen = {
+     .name = "Page-flip QR screen shown",
+     .mode = DCNT_MODE4,
+     .bg = { [2] = { DISPLAY_OWNER_BITMAP, 0, 0 } }
+ };
+
+ static QrPageFlipDisplay s_display = {
+     .active = false,
+     .front_variation = -1,
+     .back_variation = -1
+ };
+
+ /**
+  * @brief Get the page currently hidden from the display
+  */
+ static u16 *qr_display_back_page(void) {
+     return (display_dispcnt() & DCNT_PAGE) ? (u16*)MEM_VRAM : (u16*)(MEM_VRAM + 0xA000);
+ }
+
+ /**
+  * @brief Fill a rectangle of a Mode 4 page with one palette index
+  *
+  * x and width must be even: Mode 4 VRAM only takes halfword writes.
+  * Rows start on any halfword, so the DMA moves halfwords too; a 32-bit
+  * transfer would round the address down to a word.
+  */
+ static void qr_display_fill_rect(u16 *page, int x, int y, int width, int height, u8 index) {
+     u32 fill = index * 0x01010101;
+     for (int row = y; row < y + height; row++) {
+         dma_fill(&page[(row * M4_WIDTH + x) / 2], fill, width / 2, 3, DMA_FILL16);
+     }
+ }
+
+ /**
+  * @brief Render a QR variation into a Mode 4 page
+  *
+  * Each module row is built once in a line buffer and copied to the
+  * `scale` pixel rows it covers. The quiet zone is clipped to the screen.
+  */
+ static void qr_display_render_page(u16 *page, const QrState *qr) {
+     int scale = s_display.scale;
+     int width = qr->size * scale;
+     int padded = (width + 1) & ~1;
+     int quiet = QR_PAGE_QUIET_ZONE * scale;
+
+     // Quiet zone (even-aligned, clipped to screen)
+     int qx = (s_display.x - quiet) & ~1;
+     int qy = s_display.y - quiet;
+     int qw = padded + 2 * quiet;
+     int qh = width + 2 * quiet;
+     if (qx < 0) { qw += qx; qx = 0; }
+     if (qy < 0) { qh += qy; qy = 0; }
+     if (qx + qw > SCREEN_WIDTH) qw = (SCREEN_WIDTH - qx) & ~1;
+     if (qy + qh > SCREEN_HEIGHT) qh = SCREEN_HEIGHT - qy;
+     qr_display_fill_rect(page, qx, qy, qw, qh, QR_PAGE_CLR_WHITE);
+
+     u8 line[SCREEN_WIDTH] ALIGN4;
+     line[padded - 1] = QR_PAGE_CLR_WHITE;
+
+     for (int my = 0; my < qr->size; my++) {
+         const u8 *modules = &qr->data[my * qr->size];
+         for (int mx = 0; mx < qr->size; mx++) {
+             memset(&line[mx * scale], modules[mx] == 1 ? QR_PAGE_CLR_BLACK : QR_PAGE_CLR_WHITE, scale);
+         }
+
+         u16 *dst = &page[((s_display.y + my * scale) * M4_WIDTH + s_display.x) / 2];
+         for (int py = 0; py < scale; py++) {
+             dma_cpy(dst, line, padded / 2, 3, DMA_CPY16);
+             dst += M4_WIDTH / 2;
+         }
+     }
+ }
+
+ /**
+  * @brief Start the page-flipped display for the current variations
+  *
+  * Switches to Mode 4, clears both pages and renders the current variation
+  * on the front page. The back page is filled during idle time.
+  *
+  * @param x X position of the symbol (rounded down to even)
+  * @param y Y position of the symbol
+  * @param scale Module scale in pixels
+  * @return Success status
+  */
+ bool qr_protection_display_begin(int x, int y, int scale) {
+     if (g_qr_protection.variation_count <= 0) {
+         LOG_ERROR(MODULE_PROTECT, "No variations for page-flip display", 0);
+         return false;
+     }
+
+     QrState *qr = &g_qr_protection.variations[g_qr_protection.current_variation];
+     int width = qr->size * scale;
+     x &= ~1;
+
+     if (!qr->data || scale < 1 || x < 0 || y < 0 ||
+         x + width > SCREEN_WIDTH || y + width > SCREEN_HEIGHT) {
+         LOG_ERROR(MODULE_PROTECT, "QR won't fit page-flip display", qr->size);
+         return false;
+     }
+
+     s_display.x = x;
+     s_display.y = y;
+     s_display.scale = scale;
+
+     pal_bg_mem[QR_PAGE_CLR_WHITE] = CLR_WHITE;
+     pal_bg_mem[QR_PAGE_CLR_BLACK] = CLR_BLACK;
+
+     // Blank while both pages are prepared; page 0 shows from the next VBlank
+     display_blank_now();
+     display_show(&s_page_screen);
+     display_claim_vram(DISPLAY_OWNER_BITMAP, 0, 0xA000 + M4_WIDTH * SCREEN_HEIGHT);
+     dma3_fill((void*)MEM_VRAM, QR_PAGE_CLR_BACKDROP, M4_WIDTH * SCREEN_HEIGHT);
+     dma3_fill((void*)(MEM_VRAM + 0xA000), QR_PAGE_CLR_BACKDROP, M4_WIDTH * SCREEN_HEIGHT);
+
+     qr_display_render_page((u16*)MEM_VRAM, qr);
+
+     s_display.front_variation = g_qr_protection.current_variation;
+     s_display.back_variation = -1;
+     s_display.active = true;
+
+     LOG_INFO(MODULE_PROTECT, "Page-flip display started", scale);
+     return true;
+ }
+
+ /**
+  * @brief Stop the page-flipped display and restore the menu graphics
+  */
+ void qr_protection_display_end(void) {
+     if (!s_display.active) return;
+
+     s_display.active = false;
+     s_display.front_variation = -1;
+     s_display.back_variation = -1;
+
+     menu_restore_graphics();
+
+     LOG_INFO(MODULE_PROTECT, "Page-flip display stopped", 0);
+ }
+
+ /**
+  * @brief Whether the page-flipped display currently owns the screen
+  */
+ bool qr_protection_display_active(void) {
+     return s_display.active;
+ }
+
+ /**
+  * @brief Drop the pre-rendered pages after variations were regenerated
+  */
+ void qr_protection_display_invalidate(void) {
+     s_display.front_variation = -1;
+     s_display.back_variation = -1;
+ }
+
+ /**
+  * @brief VBlank step: flip to the back page if it holds the current variation
+  *
+  * Must run at the start of VBlank so the page switch never tears.
+  */
+ void qr_protection_display_vblank(void) {
+     if (!s_display.active) return;
+
+     int current = g_qr_protection.current_variation;
+
+     if (current != s_display.front_variation && current == s_display.back_variation) {
+         display_flip_page();
+         s_display.back_variation = s_display.front_variation;
+         s_display.front_variation = current;
+     }
+ }
+
+ /**
+  * @brief Idle step: pre-render the variation needed next into the back page
+  *
+  * If the current variation is not on screen yet it is rendered first,
+  * otherwise the one after it. Does nothing when the back page is ready.
+  */
+ void qr_protection_display_idle(void) {
+     if (!s_display.active || g_qr_protection.variation_count <= 0) return;
+
+     int current = g_qr_protection.current_variation;
+     int wanted = current;
+
+     if (current == s_display.front_variation) {
+         if (g_qr_protection.variation_count == 1) return;
+         wanted = (current + 1) % g_qr_protection.variation_count;
+     }
+
+     if (wanted == s_display.back_variation) return;
+
+     QrState *qr = &g_qr_protection.variations[wanted];
+     int width = qr->size * s_display.scale;
+     if (!qr->data || s_display.x + width > SCREEN_WIDTH || s_display.y + width > SCREEN_HEIGHT) return;
+
+     qr_display_render_page(qr_display_back_page(), qr);
+     s_display.back_variation = wanted;
+ }
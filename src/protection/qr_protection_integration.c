@@ -102,7 +102,7 @@
      }
      
      // Get the address from the selected wallet entry
-     WalletEntry* entry = &wallet->entries[wallet->selected_index];
+     WalletEntry* entry = wallet_get_selected_entry();
      if (!entry->address[0]) {
          LOG_ERROR(MODULE_PROTECT, "Empty address in wallet entry", wallet->selected_index);
          return false;
@@ -225,6 +225,9 @@
      // Initialize the protection menu
      qr_protection_menu_init();
      
+     // Bring back the level chosen last time
+     qr_protection_load_settings();
+     
      // Store original function pointers for patching
      extern bool (*wallet_render_qr_function)(int x, int y, int scale);
      
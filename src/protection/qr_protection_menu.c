@@ -245,6 +245,7 @@
      // Select preset
      if (key_hit(KEY_A)) {
          qr_protection_set_level((QrProtectionLevel)g_selected_option);
+         qr_protection_save_settings();
          g_protection_menu_state = QR_PROT_MENU_MAIN;
          g_selected_option = 0;
          
@@ -331,6 +332,7 @@
      // Apply custom settings
      if (key_hit(KEY_START)) {
          qr_protection_set_params(&g_temp_params);
+         qr_protection_save_settings();
          g_protection_menu_state = QR_PROT_MENU_MAIN;
          g_selected_option = 1; // Position cursor on "Custom Settings"
          
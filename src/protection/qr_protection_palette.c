@@ -0,0 +1,233 @@
+/**
+ * @file qr_protection_palette.c
+ * @brief Palette-encoded display of up to four protection variations
+ *
+ * Variations of the same data share most modules, so up to four of them fit
+ * into a single 4bpp image: bit k of a pixel's palette index holds the color
+ * of that module in variation k (1 = dark). Showing variation k only means
+ * loading the 16-entry palette that maps every index to bit k, a 32-byte
+ * copy in VBlank with no VRAM pixel traffic.
+ *
+ * Index 0 (light in every variation) is transparent in 4bpp tiles and shows
+ * the backdrop, which the hardware quiet zone keeps white around the
+ * symbol (see render_qr_quiet_zone).
+ *
+ * The image uses the QR char block and the single-symbol map (SBB 26), so
+ * building it invalidates the tile renderer and the variation atlas.
+ *
+ * @author Claude
+ * @date October 2026
+ * @version 1.0.0
+ */
+
+ #include <tonc.h>
+ #include <string.h>
+ #include "qr_protection.h"
+ #include "menu_system.h"
+ #include "display_compositor.h"
+ #include "vblank_queue.h"
+
+ /**
+  * Palette display state
+  */
+ typedef struct {
+     bool built;                 // Whether a build was attempted for the current variations
+     bool fits;                  // Whether that build packed every variation
+     bool active;                // Whether the display owns BG2
+     int scale;                  // Module scale the image was built for
+     u32 tile_generation;        // Tile set generation right after the build
+     int shown_variation;        // Variation whose palette is loaded (-1 = none)
+ } QrPaletteDisplay;
+
+ static QrPaletteDisplay s_palette = {
+     .shown_variation = -1
+ };
+
+ // Palette for each packed variation
+ static COLOR s_variation_pals[QR_PALETTE_MAX_VARIATIONS][16] ALIGN4;
+
+ /**
+  * @brief Get the packed palette index for a module
+  *
+  * Modules outside the symbol are light in every variation.
+  */
+ static u32 qr_palette_index(int mx, int my, int count) {
+     int size = g_qr_protection.variations[0].size;
+     if (mx >= size || my >= size) {
+         return 0;
+     }
+
+     u32 index = 0;
+     for (int k = 0; k < count; k++) {
+         if (g_qr_protection.variations[k].data[my * size + mx] == 1) {
+             index |= 1u << k;
+         }
+     }
+     return index;
+ }
+
+ /**
+  * @brief Upload the packed image and build the per-variation palettes
+  */
+ static bool qr_palette_build(int scale) {
+     int count = g_qr_protection.variation_count;
+     int size = g_qr_protection.variations[0].size;
+
+     if (count <= 0 || count > QR_PALETTE_MAX_VARIATIONS) {
+         return false;
+     }
+
+     for (int k = 0; k < count; k++) {
+         if (!g_qr_protection.variations[k].data || g_qr_protection.variations[k].size != size) {
+             LOG_ERROR(MODULE_PROTECT, "Variation sizes differ", k);
+             return false;
+         }
+     }
+
+     int map_size = (size * scale + 7) / 8;
+     if ((map_size * map_size + 1) * (int)sizeof(TILE) > (int)sizeof(CHARBLOCK)) {
+         LOG_ERROR(MODULE_PROTECT, "Palette QR exceeds char block", map_size);
+         return false;
+     }
+
+     SCR_ENTRY *map = se_mem[QR_TILE_SCREEN_BLOCK];
+     SCR_ENTRY pal = SE_PALBANK(QR_PALETTE_BANK);
+
+     memset32(&tile_mem[QR_TILE_CHAR_BLOCK][0], 0, sizeof(TILE) / 4);
+     memset32(map, 0, sizeof(SCREENBLOCK) / 4);
+
+     // One tile per map entry: packed tiles rarely repeat
+     for (int ty = 0; ty < map_size; ty++) {
+         for (int tx = 0; tx < map_size; tx++) {
+             TILE tile;
+
+             for (int py = 0; py < 8; py++) {
+                 int my = (ty * 8 + py) / scale;
+                 u32 row = 0;
+                 for (int px = 0; px < 8; px++) {
+                     row |= qr_palette_index((tx * 8 + px) / scale, my, count) << (px * 4);
+                 }
+                 tile.data[py] = row;
+             }
+
+             int id = 1 + ty * map_size + tx;
+             memcpy32(&tile_mem[QR_TILE_CHAR_BLOCK][id], &tile, sizeof(TILE) / 4);
+             map[ty * 32 + tx] = pal | id;
+         }
+     }
+
+     for (int k = 0; k < count; k++) {
+         for (int index = 0; index < 16; index++) {
+             s_variation_pals[k][index] = (index & (1 << k)) ? CLR_BLACK : CLR_WHITE;
+         }
+     }
+
+     return true;
+ }
+
+ /**
+  * @brief Queue the palette of a packed variation for the next VBlank
+  */
+ static void qr_palette_load(int variation) {
+     vblank_queue_copy(&pal_bg_bank[QR_PALETTE_BANK], s_variation_pals[variation], sizeof(PALBANK));
+     s_palette.shown_variation = variation;
+ }
+
+ /**
+  * @brief Show the current variation from the palette-encoded image on BG2
+  *
+  * Builds the image when the variations, scale or shared tile set changed.
+  * Variation switches happen in qr_protection_palette_vblank().
+  *
+  * @param x X position on screen
+  * @param y Y position on screen
+  * @param scale Module scale
+  * @return False if the variations can't be packed (render otherwise)
+  */
+ bool qr_protection_palette_show(int x, int y, int scale) {
+     int count = g_qr_protection.variation_count;
+     if (count <= 0 || count > QR_PALETTE_MAX_VARIATIONS) return false;
+
+     int width = g_qr_protection.variations[0].size * scale;
+     if (scale < 1 || x < 0 || y < 0 ||
+         x + width > SCREEN_WIDTH || y + width > SCREEN_HEIGHT) {
+         return false;
+     }
+
+     qr_tile_claim_vram(0);
+
+     if (!s_palette.built || s_palette.scale != scale ||
+         s_palette.tile_generation != qr_tile_generation()) {
+
+         s_palette.built = true;
+         s_palette.scale = scale;
+         s_palette.fits = qr_palette_build(scale);
+         s_palette.shown_variation = -1;
+
+         // The QR char block and map were overwritten
+         render_qr_tile_invalidate();
+         s_palette.tile_generation = qr_tile_generation();
+
+         if (s_palette.fits) {
+             LOG_INFO(MODULE_PROTECT, "Palette QR built", count);
+         }
+     }
+
+     if (!s_palette.fits) {
+         s_palette.active = false;
+         return false;
+     }
+
+     if (s_palette.shown_variation < 0) {
+         qr_palette_load(g_qr_protection.current_variation);
+     }
+
+     // Light modules show the backdrop; keep a caller's quiet zone window
+     if (!(display_dispcnt() & DCNT_WIN0)) {
+         render_qr_quiet_zone(x, y, width, 0);
+     }
+
+     display_set_bg(2, BG_CBB(QR_TILE_CHAR_BLOCK) | BG_SBB(QR_TILE_SCREEN_BLOCK) |
+                       BG_4BPP | BG_REG_32x32 | BG_PRIO(0));
+     REG_BG2HOFS = (u16)(-x);
+     REG_BG2VOFS = (u16)(-y);
+     display_set_mode(DCNT_MODE0);
+     display_enable(DCNT_BG2);
+
+     s_palette.active = true;
+     return true;
+ }
+
+ /**
+  * @brief Hide the palette-encoded layer
+  */
+ void qr_protection_palette_hide(void) {
+     if (!s_palette.active) return;
+
+     s_palette.active = false;
+     render_qr_tile_hide();
+ }
+
+ /**
+  * @brief Drop the packed image after variations were regenerated
+  */
+ void qr_protection_palette_invalidate(void) {
+     s_palette.built = false;
+     s_palette.active = false;
+     s_palette.shown_variation = -1;
+ }
+
+ /**
+  * @brief Frame step: switch to the current variation's palette
+  *
+  * The copy goes through the VBlank commit queue, so the switch never
+  * tears wherever in the frame this runs.
+  */
+ void qr_protection_palette_vblank(void) {
+     if (!s_palette.active) return;
+
+     int current = g_qr_protection.current_variation;
+     if (current == s_palette.shown_variation || current >= g_qr_protection.variation_count) return;
+
+     qr_palette_load(current);
+ }
@@ -0,0 +1,127 @@
+/**
+ * @file qr_protection_settings.c
+ * @brief Protection level and parameters kept on the save chip
+ *
+ * Record layout (16 bytes at SAVE_SETTINGS_PROTECTION in the settings area):
+ *   magic u32, version u8, level u8, refresh rate u8, mask variations u8,
+ *   flags u8, ECC level u8, invert percentage u8, reserved u8,
+ *   CRC-32 of the first 12 bytes
+ *
+ * A record that is missing or fails its CRC (a flash settings sector cut
+ * short by power loss, say) leaves the defaults in place.
+ *
+ * @author Claude
+ * @date October 2026
+ * @version 1.0.0
+ */
+
+ #include <tonc.h>
+ #include <string.h>
+ #include "qr_protection.h"
+ #include "save_media.h"
+ #include "crc32.h"
+
+ #define QR_SETTINGS_MAGIC       0x50514247  // "GBQP"
+ #define QR_SETTINGS_VERSION     1
+ #define QR_SETTINGS_CRC_BYTES   12
+ #define QR_SETTINGS_BYTES       (QR_SETTINGS_CRC_BYTES + 4)
+
+ /**
+  * Parameter flags
+  */
+ #define QR_SETTINGS_RANDOMIZE   0x01
+ #define QR_SETTINGS_REDUCE_ECC  0x02
+ #define QR_SETTINGS_ALTERNATE   0x04
+ #define QR_SETTINGS_INVERT      0x08
+
+ // Record as last read or written, so unchanged settings cost no write
+ static u8 s_stored[QR_SETTINGS_BYTES];
+
+ static inline void put_u32(u8 *p, u32 value) {
+     p[0] = value;
+     p[1] = value >> 8;
+     p[2] = value >> 16;
+     p[3] = value >> 24;
+ }
+
+ static inline u32 get_u32(const u8 *p) {
+     return p[0] | (p[1] << 8) | (p[2] << 16) | ((u32)p[3] << 24);
+ }
+
+ static void qr_settings_encode(u8 *out) {
+     const QrProtectionParams *params = &g_qr_protection.params;
+
+     memset(out, 0, QR_SETTINGS_BYTES);
+     put_u32(out, QR_SETTINGS_MAGIC);
+     out[4] = QR_SETTINGS_VERSION;
+     out[5] = g_qr_protection.level;
+     out[6] = params->refresh_rate;
+     out[7] = params->mask_variations;
+     out[8] = (params->randomize_function ? QR_SETTINGS_RANDOMIZE : 0) |
+              (params->reduce_ecc ? QR_SETTINGS_REDUCE_ECC : 0) |
+              (params->alternate_encoding ? QR_SETTINGS_ALTERNATE : 0) |
+              (params->invert_modules ? QR_SETTINGS_INVERT : 0);
+     out[9] = params->custom_ecc_level;
+     out[10] = params->invert_percentage;
+
+     put_u32(out + QR_SETTINGS_CRC_BYTES, crc32(out, QR_SETTINGS_CRC_BYTES));
+ }
+
+ /**
+  * @brief Restore the saved level and parameters
+  */
+ bool qr_protection_load_settings(void) {
+     u8 raw[QR_SETTINGS_BYTES];
+
+     if (save_media_size() < SAVE_MEDIA_SETTINGS_BYTES ||
+         !save_media_read(save_media_settings_offset() + SAVE_SETTINGS_PROTECTION, raw, sizeof(raw))) {
+         return false;
+     }
+
+     if (get_u32(raw) != QR_SETTINGS_MAGIC || raw[4] != QR_SETTINGS_VERSION ||
+         crc32(raw, QR_SETTINGS_CRC_BYTES) != get_u32(raw + QR_SETTINGS_CRC_BYTES) ||
+         raw[5] >= QR_PROT_LEVEL_COUNT) {
+         LOG_INFO(MODULE_PROTECT, "No saved protection settings", 0);
+         return false;
+     }
+
+     if (raw[5] == QR_PROT_LEVEL_CUSTOM) {
+         QrProtectionParams params;
+         params.refresh_rate = raw[6];
+         params.mask_variations = raw[7];
+         params.randomize_function = (raw[8] & QR_SETTINGS_RANDOMIZE) != 0;
+         params.reduce_ecc = (raw[8] & QR_SETTINGS_REDUCE_ECC) != 0;
+         params.alternate_encoding = (raw[8] & QR_SETTINGS_ALTERNATE) != 0;
+         params.invert_modules = (raw[8] & QR_SETTINGS_INVERT) != 0;
+         params.custom_ecc_level = raw[9];
+         params.invert_percentage = raw[10];
+         qr_protection_set_params(&params);
+     } else {
+         qr_protection_set_level((QrProtectionLevel)raw[5]);
+     }
+
+     memcpy(s_stored, raw, sizeof(s_stored));
+     LOG_INFO(MODULE_PROTECT, "Protection settings loaded", raw[5]);
+     return true;
+ }
+
+ /**
+  * @brief Save the current level and parameters
+  */
+ bool qr_protection_save_settings(void) {
+     u8 raw[QR_SETTINGS_BYTES];
+
+     if (save_media_size() < SAVE_MEDIA_SETTINGS_BYTES) return false;
+
+     qr_settings_encode(raw);
+     if (memcmp(raw, s_stored, sizeof(raw)) == 0) return true;
+
+     if (!save_media_write(save_media_settings_offset() + SAVE_SETTINGS_PROTECTION, raw, sizeof(raw)) ||
+         !save_media_commit()) {
+         LOG_ERROR(MODULE_PROTECT, "Failed to save protection settings", 0);
+         return false;
+     }
+
+     memcpy(s_stored, raw, sizeof(s_stored));
+     return true;
+ }
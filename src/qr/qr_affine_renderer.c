@@ -0,0 +1,194 @@
+/**
+ * @file qr_affine_renderer.c
+ * @brief Hardware-scaled QR rendering on the affine BG2 layer
+ *
+ * Integer module scales waste screen space: a version 5 symbol (37 modules)
+ * is 148 px at scale 4 but only 111 px at scale 3. This renderer uploads the
+ * symbol once at one pixel per module into 8bpp affine tiles and lets the
+ * BG2 affine matrix scale it to any size. After setup the display costs no
+ * CPU time per frame.
+ *
+ * Mode 1 is used so BG0 (text) and BG1 (menu) stay available as regular
+ * backgrounds next to the affine BG2.
+ *
+ * @author Claude
+ * @date October 2026
+ * @version 1.0.0
+ */
+
+ #include <tonc.h>
+ #include <string.h>
+ #include "qr_system.h"
+ #include "qr_debug.h"
+ #include "display_compositor.h"
+
+ // Affine map is 16x16 tiles (128x128 px, BG_AFF_16x16)
+ #define QR_AFFINE_MAP_TILES     16
+
+ // Tiles fit the two claimed screen blocks of CBB 3 (SBB 24-25): 64 8bpp
+ // tiles, tile 0 transparent, so the texture is at most 7x7 tiles (56 px)
+ #define QR_AFFINE_TILE_SLOTS    (2 * 2048 / (int)sizeof(TILE8))
+
+ // 8bpp palette indices, shared with the tile renderer's palette bank
+ #define QR_AFFINE_CLR_WHITE     (QR_TILE_PALETTE_BANK * 16 + 1)
+ #define QR_AFFINE_CLR_BLACK     (QR_TILE_PALETTE_BANK * 16 + 2)
+
+ /**
+  * Renderer state
+  */
+ typedef struct {
+     const u8 *last_data;        // Module data currently uploaded
+     int last_size;              // Symbol size currently uploaded
+     int last_quiet_zone;        // Quiet zone currently uploaded
+     u32 last_checksum;          // Checksum of uploaded module data
+ } QrAffineRenderer;
+
+ static QrAffineRenderer s_affine = {0};
+
+ /**
+  * @brief Upload the symbol as 1 px per module into affine tiles
+  *
+  * Texture pixel (tx, ty) holds module (tx - quiet, ty - quiet); the
+  * quiet zone and the rest of the used tiles are white. Tile 0 stays
+  * transparent and fills the unused part of the map.
+  */
+ static void qr_affine_upload(const QrState *qr, int quiet_zone) {
+     int total = qr->size + 2 * quiet_zone;
+     int tiles = (total + 7) / 8;
+     u8 *map = (u8*)se_mem[QR_AFFINE_SCREEN_BLOCK];
+     u32 tile[16];
+     u8 *pixels = (u8*)tile;
+
+     // Transparent tile 0 and empty map
+     memset32(&tile8_mem[QR_AFFINE_CHAR_BLOCK][0], 0, sizeof(TILE8) / 4);
+     memset32(map, 0, QR_AFFINE_MAP_TILES * QR_AFFINE_MAP_TILES / 4);
+
+     for (int ty = 0; ty < tiles; ty++) {
+         for (int tx = 0; tx < tiles; tx++) {
+             for (int py = 0; py < 8; py++) {
+                 int my = ty * 8 + py - quiet_zone;
+                 for (int px = 0; px < 8; px++) {
+                     int mx = tx * 8 + px - quiet_zone;
+                     bool black = (mx >= 0 && my >= 0 && mx < qr->size && my < qr->size &&
+                                   qr->data[my * qr->size + mx] == 1);
+                     pixels[py * 8 + px] = black ? QR_AFFINE_CLR_BLACK : QR_AFFINE_CLR_WHITE;
+                 }
+             }
+
+             int id = 1 + ty * tiles + tx;
+             memcpy32(&tile8_mem[QR_AFFINE_CHAR_BLOCK][id], tile, sizeof(TILE8) / 4);
+
+             // VRAM has no byte writes: update the map entry through its halfword
+             u16 *entry = (u16*)&map[(ty * QR_AFFINE_MAP_TILES + tx) & ~1];
+             if (tx & 1) {
+                 *entry = (*entry & 0x00FF) | (id << 8);
+             } else {
+                 *entry = (*entry & 0xFF00) | id;
+             }
+         }
+     }
+ }
+
+ /**
+  * @brief Renders a QR code scaled by the BG2 affine matrix
+  *
+  * The symbol plus quiet zone is drawn as a square of `size` pixels at
+  * (x, y). Module size does not have to be an integer; nearest-neighbour
+  * sampling gives modules that differ by at most one pixel.
+  *
+  * @param qr_state QR code state
+  * @param x Top-left x position on screen (including quiet zone)
+  * @param y Top-left y position on screen (including quiet zone)
+  * @param size Side length on screen in pixels (including quiet zone)
+  * @param quiet_zone Quiet zone width in modules
+  * @return Success status
+  */
+ bool render_qr_affine(QrState *qr_state, int x, int y, int size, int quiet_zone) {
+     if (!qr_state || !qr_state->data) {
+         LOG_ERROR(MODULE_RENDER, "Invalid QR state for affine rendering", 0);
+         return false;
+     }
+
+     int total = qr_state->size + 2 * quiet_zone;
+     int tiles = (total + 7) / 8;
+
+     if (quiet_zone < 0 || tiles * tiles + 1 > QR_AFFINE_TILE_SLOTS) {
+         LOG_ERROR(MODULE_RENDER, "QR too large for affine map", total);
+         return false;
+     }
+
+     if (size < total || x < 0 || y < 0 ||
+         x + size > SCREEN_WIDTH || y + size > SCREEN_HEIGHT) {
+         LOG_ERROR(MODULE_RENDER, "Affine QR won't fit on screen", size);
+         return false;
+     }
+
+     // Another screen may have overwritten the affine tiles or map
+     if (!display_claim(DISPLAY_OWNER_QR_AFFINE,
+                        BIT(QR_AFFINE_CHAR_BLOCK * 8) | BIT(QR_AFFINE_CHAR_BLOCK * 8 + 1) |
+                        BIT(QR_AFFINE_SCREEN_BLOCK))) {
+         s_affine.last_data = NULL;
+     }
+
+     u32 checksum = qr_matrix_checksum(qr_state);
+
+     if (s_affine.last_data != qr_state->data ||
+         s_affine.last_size != qr_state->size ||
+         s_affine.last_quiet_zone != quiet_zone ||
+         s_affine.last_checksum != checksum) {
+
+         qr_affine_upload(qr_state, quiet_zone);
+
+         s_affine.last_data = qr_state->data;
+         s_affine.last_size = qr_state->size;
+         s_affine.last_quiet_zone = quiet_zone;
+         s_affine.last_checksum = checksum;
+
+         LOG_INFO(MODULE_RENDER, "Affine QR uploaded", total);
+     }
+
+     pal_bg_mem[QR_AFFINE_CLR_WHITE] = CLR_WHITE;
+     pal_bg_mem[QR_AFFINE_CLR_BLACK] = CLR_BLACK;
+
+     // Texture step per screen pixel in .8 fixed point; floor keeps the
+     // last screen pixel inside the texture
+     int step = (total << 8) / size;
+
+     display_set_bg(2, BG_CBB(QR_AFFINE_CHAR_BLOCK) | BG_SBB(QR_AFFINE_SCREEN_BLOCK) |
+                       BG_AFF_16x16 | BG_PRIO(0));
+     REG_BG2PA = step;
+     REG_BG2PB = 0;
+     REG_BG2PC = 0;
+     REG_BG2PD = step;
+     REG_BG2X = -x * step;
+     REG_BG2Y = -y * step;
+
+     display_set_mode(DCNT_MODE1);
+     display_enable(DCNT_BG2);
+
+     return true;
+ }
+
+ /**
+  * @brief Renders a QR code at the largest size that fits the screen
+  *
+  * Centers the symbol horizontally and uses the full screen height
+  * minus `margin` pixels at top and bottom.
+  *
+  * @param qr_state QR code state
+  * @param margin Vertical margin in pixels above and below the code
+  * @param quiet_zone Quiet zone width in modules
+  * @return Success status
+  */
+ bool render_qr_affine_fit(QrState *qr_state, int margin, int quiet_zone) {
+     int size = SCREEN_HEIGHT - 2 * margin;
+     return render_qr_affine(qr_state, (SCREEN_WIDTH - size) / 2, margin, size, quiet_zone);
+ }
+
+ /**
+  * @brief Hide the affine QR layer and return to Mode 0
+  */
+ void render_qr_affine_hide(void) {
+     display_set_mode(DCNT_MODE0);
+     display_disable(DCNT_BG2);
+ }
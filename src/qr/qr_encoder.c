@@ -15,12 +15,14 @@
  #include <stdlib.h>
  #include "qr_system.h"
  #include "qr_debug.h"
+ #include "gba_sections.h"
+ #include "memory_system.h"
  
  // Forward declarations for internal functions
  static bool encode_data(QrState *qr_state, const char *text);
  static bool add_error_correction(QrState *qr_state);
  static bool create_matrix(QrState *qr_state);
- static bool apply_mask_pattern(QrState *qr_state, int mask_pattern);
+ IWRAM_CODE static bool apply_mask_pattern(QrState *qr_state, int mask_pattern);
  static int evaluate_mask_pattern(QrState *qr_state, u8 *matrix, int size);
  static void add_finder_patterns(u8 *matrix, int size);
  static void add_alignment_patterns(u8 *matrix, int size);
@@ -178,9 +180,9 @@
          return false;
      }
      
-     // Allocate data buffer for the QR matrix
+     // Take a matrix buffer from the pool
      int size = qr_state->size;
-     qr_state->data = (u8 *)malloc(size * size);
+     qr_state->data = qr_matrix_alloc();
      if (!qr_state->data) {
          LOG_ERROR(MODULE_RENDER, "Failed to allocate QR data buffer", size * size);
          return false;
@@ -220,15 +222,17 @@
          int best_score = -1;
          int best_pattern = 0;
          
+         // Unmasked copy of the matrix, in frame scratch for the whole search
+         u32 mark = mem_arena_mark(&g_mem_frame);
+         u8 *temp_matrix = mem_arena_alloc(&g_mem_frame, size * size);
+         if (!temp_matrix) {
+             LOG_ERROR(MODULE_RENDER, "Failed to allocate temporary matrix", 0);
+             qr_free(qr_state);
+             return false;
+         }
+         memcpy(temp_matrix, qr_state->data, size * size);
+         
          for (int i = 0; i < 8; i++) {
-             // Create a temporary copy of the matrix
-             u8 *temp_matrix = (u8 *)malloc(size * size);
-             if (!temp_matrix) {
-                 LOG_ERROR(MODULE_RENDER, "Failed to allocate temporary matrix", 0);
-                 continue;
-             }
-             
-             memcpy(temp_matrix, qr_state->data, size * size);
              
              // Apply mask pattern
              if (apply_mask_pattern(qr_state, i)) {
@@ -244,9 +248,9 @@
              
              // Restore original matrix
              memcpy(qr_state->data, temp_matrix, size * size);
-             free(temp_matrix);
          }
          
+         mem_arena_release(&g_mem_frame, mark);
          mask_pattern = best_pattern;
      } else {
          // Use specified mask pattern
@@ -286,8 +290,9 @@
      
      int text_length = strlen(text);
      
-     // Create a data buffer for the encoded data
-     u8 *encoded_data = (u8 *)malloc(text_length + 16);  // Extra space for mode, count, etc.
+     // Create a data buffer for the encoded data in frame scratch
+     u32 mark = mem_arena_mark(&g_mem_frame);
+     u8 *encoded_data = mem_arena_alloc(&g_mem_frame, text_length + 16);  // Extra space for mode, count, etc.
      if (!encoded_data) {
          LOG_ERROR(MODULE_RENDER, "Failed to allocate encoded data buffer", 0);
          return false;
@@ -302,7 +307,7 @@
      qr_state->data_length = text_length;
      memcpy(qr_state->data, encoded_data, text_length);
      
-     free(encoded_data);
+     mem_arena_release(&g_mem_frame, mark);
      
      LOG_INFO(MODULE_RENDER, "Data encoded", text_length);
      return true;
@@ -573,8 +578,10 @@
   * @param qr_state QR code state
   * @param mask_pattern Mask pattern (0-7)
   * @return true if successful, false otherwise
+  * 
+  * Runs from IWRAM as ARM code: it visits every module, once per mask tried.
   */
- static bool apply_mask_pattern(QrState *qr_state, int mask_pattern) {
+ IWRAM_CODE static bool apply_mask_pattern(QrState *qr_state, int mask_pattern) {
      if (mask_pattern < 0 || mask_pattern > 7) {
          LOG_ERROR(MODULE_RENDER, "Invalid mask pattern", mask_pattern);
          return false;
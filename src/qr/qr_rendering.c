@@ -3,7 +3,8 @@
  * @brief QR code rendering implementation for GBA
  * 
  * This file provides the rendering functions for QR codes on the GBA screen.
- * It includes both direct pixel plotting and optimized tile-based rendering.
+ * It includes a Mode 3 span renderer and buffer rendering; the tile-based
+ * renderer lives in qr_tile_renderer.c.
  * 
  * @author Claude
  * @date March 2025
@@ -13,22 +14,151 @@
  #include <tonc.h>
  #include "qr_system.h"
  #include "qr_debug.h"
+ #include "display_compositor.h"
  
  // Constants for QR rendering
  #define QR_MODULE_WHITE 0
  #define QR_MODULE_BLACK 1
  #define QR_PIXEL_SIZE   2  // Each QR module is 2x2 pixels by default
  
+ // Widest row render_qr_output can build (pixels)
+ #define QR_OUTPUT_MAX_WIDTH 256
+ 
+ // Line buffer for render_qr_output: one 15bpp row or one 4bpp tile band
+ static u32 s_output_line[QR_OUTPUT_MAX_WIDTH] ALIGN4;
+ 
+ // Runs shorter than this many words are stored directly; for a couple of
+ // words the DMA setup costs more than the transfer saves
+ #define QR_SPAN_DMA_MIN_WORDS 8
+ 
+ /**
+  * @brief Fill a horizontal span of Mode 3 pixels
+  * 
+  * Aligns to a word boundary with one halfword store, fills the body
+  * with 32-bit stores (DMA3 fixed-source fill for long runs) and
+  * finishes with a trailing halfword if needed.
+  * 
+  * @param dst First pixel of the span
+  * @param count Number of pixels
+  * @param color Fill color
+  */
+ static inline void qr_span_fill(u16 *dst, int count, u16 color) {
+     if (count <= 0) return;
+     
+     if ((u32)dst & 2) {
+         *dst++ = color;
+         count--;
+     }
+     
+     int words = count >> 1;
+     if (words > 0) {
+         u32 fill = color | ((u32)color << 16);
+         if (words >= QR_SPAN_DMA_MIN_WORDS) {
+             dma3_fill(dst, fill, words * 4);
+         } else {
+             u32 *dst32 = (u32*)dst;
+             for (int i = 0; i < words; i++) {
+                 dst32[i] = fill;
+             }
+         }
+         dst += words * 2;
+     }
+     
+     if (count & 1) {
+         *dst = color;
+     }
+ }
+ 
+ /**
+  * @brief Copy a span of Mode 3 pixels from one row to another
+  * 
+  * Source and destination share the same word alignment because a
+  * Mode 3 row is 480 bytes, so the body is copied with 32-bit DMA.
+  * 
+  * @param dst Destination pixel
+  * @param src Source pixel
+  * @param count Number of pixels
+  */
+ static inline void qr_span_copy_row(u16 *dst, const u16 *src, int count) {
+     if ((u32)dst & 2) {
+         *dst++ = *src++;
+         count--;
+     }
+     
+     int words = count >> 1;
+     if (words > 0) {
+         dma3_cpy(dst, src, words * 4);
+         dst += words * 2;
+         src += words * 2;
+     }
+     
+     if (count & 1) {
+         *dst = *src;
+     }
+ }
+ 
+ /**
+  * @brief Check that a QR code fits on screen at the given position
+  */
+ static bool qr_fits_on_screen(const QrState *qr_state, int x, int y, int scale) {
+     int screen_size = qr_state->size * scale;
+     
+     return scale >= 1 && x >= 0 && y >= 0 &&
+            x + screen_size <= SCREEN_WIDTH &&
+            y + screen_size <= SCREEN_HEIGHT;
+ }
+ 
+ /**
+  * @brief Record that a Mode 3 rectangle was overwritten
+  * 
+  * The framebuffer overlaps the tile, map and OBJ blocks of the tiled
+  * screens, which re-upload their data when they are shown next.
+  */
+ static void qr_claim_m3_rect(int x, int y, int width, int height) {
+     if (width <= 0 || height <= 0) return;
+     
+     display_claim_vram(DISPLAY_OWNER_BITMAP, (y * M3_WIDTH + x) * 2,
+                        ((height - 1) * M3_WIDTH + width) * 2);
+ }
+ 
+ /**
+  * @brief Reference per-pixel renderer
+  * 
+  * Plots scale^2 pixels per module. Kept only as the baseline for
+  * render_qr_benchmark().
+  */
+ static void qr_plot_modules(const QrState *qr_state, int x, int y, int scale) {
+     int qr_size = qr_state->size;
+     
+     for (int qr_y = 0; qr_y < qr_size; qr_y++) {
+         for (int qr_x = 0; qr_x < qr_size; qr_x++) {
+             int module_value = qr_state->data[qr_y * qr_size + qr_x];
+             u16 color = (module_value == QR_MODULE_BLACK) ? CLR_BLACK : CLR_WHITE;
+             
+             for (int py = 0; py < scale; py++) {
+                 for (int px = 0; px < scale; px++) {
+                     m3_plot(x + qr_x * scale + px, y + qr_y * scale + py, color);
+                 }
+             }
+         }
+     }
+ }
+ 
  /**
   * @brief Renders a QR code to the GBA screen
   * 
+  * Mode 3 span renderer: each module row is converted to runs of equal
+  * color, each run is emitted as one 32-bit fill, and the resulting pixel
+  * row is copied to the remaining scale-1 rows of the module row. It runs
+  * from IWRAM as ARM code.
+  * 
   * @param qr_state QR code state with pattern data
   * @param x Top-left x position for rendering
   * @param y Top-left y position for rendering
   * @param scale Scaling factor (1 = 1 pixel per module)
   * @return Success status
   */
- bool render_qr_to_screen(QrState *qr_state, int x, int y, int scale) {
+ IWRAM_CODE bool render_qr_to_screen(QrState *qr_state, int x, int y, int scale) {
      if (!qr_state || !qr_state->data) {
          LOG_ERROR(MODULE_RENDER, "Invalid QR state for rendering", 0);
          return false;
@@ -38,43 +168,266 @@
      int qr_size = qr_state->size;
      int screen_size = qr_size * scale;
      
-     if (x < 0 || y < 0 || 
-         x + screen_size > SCREEN_WIDTH || 
-         y + screen_size > SCREEN_HEIGHT) {
+     if (!qr_fits_on_screen(qr_state, x, y, scale)) {
          LOG_ERROR(MODULE_RENDER, "QR code won't fit on screen", qr_size);
          return false;
      }
      
-     // For direct mode 3 bitmap rendering
+     qr_claim_m3_rect(x, y, screen_size, screen_size);
+     
+     u16 *row = &m3_mem[y][x];
+     
      for (int qr_y = 0; qr_y < qr_size; qr_y++) {
-         for (int qr_x = 0; qr_x < qr_size; qr_x++) {
-             // Get module value (0 = white, 1 = black)
-             int module_value = qr_state->data[qr_y * qr_size + qr_x];
+         const u8 *modules = &qr_state->data[qr_y * qr_size];
+         u16 *dst = row;
+         int qr_x = 0;
+         
+         // First pixel row: one fill per run of equal modules
+         while (qr_x < qr_size) {
+             bool black = (modules[qr_x] == QR_MODULE_BLACK);
+             int run = 1;
              
-             // Set color based on module value
-             u16 color = (module_value == QR_MODULE_BLACK) ? CLR_BLACK : CLR_WHITE;
+             while (qr_x + run < qr_size && (modules[qr_x + run] == QR_MODULE_BLACK) == black) {
+                 run++;
+             }
              
-             // Draw scaled module
-             for (int py = 0; py < scale; py++) {
-                 for (int px = 0; px < scale; px++) {
-                     int screen_x = x + qr_x * scale + px;
-                     int screen_y = y + qr_y * scale + py;
+             qr_span_fill(dst, run * scale, black ? CLR_BLACK : CLR_WHITE);
+             dst += run * scale;
+             qr_x += run;
+         }
+         
+         // Remaining pixel rows of this module row are copies of the first
+         for (int py = 1; py < scale; py++) {
+             qr_span_copy_row(row + py * M3_WIDTH, row, screen_size);
+         }
+         
+         row += scale * M3_WIDTH;
+     }
+     
+     LOG_INFO(MODULE_RENDER, "QR rendered to screen", qr_size);
+     return true;
+ }
+ 
+ /**
+  * @brief Compare per-pixel and span rendering cost
+  * 
+  * Renders the same QR code with the reference plotter and the span
+  * renderer, timing both with the cascaded profiling timers.
+  * 
+  * @param qr_state QR code state with pattern data
+  * @param x Top-left x position for rendering
+  * @param y Top-left y position for rendering
+  * @param scale Scaling factor
+  * @param plot_cycles Output: cycles used by the per-pixel renderer
+  * @param span_cycles Output: cycles used by the span renderer
+  * @return Success status
+  */
+ bool render_qr_benchmark(QrState *qr_state, int x, int y, int scale,
+                          u32 *plot_cycles, u32 *span_cycles) {
+     if (!qr_state || !qr_state->data || !plot_cycles || !span_cycles ||
+         !qr_fits_on_screen(qr_state, x, y, scale)) {
+         LOG_ERROR(MODULE_OPTIMIZE, "Invalid parameters for QR benchmark", 0);
+         return false;
+     }
+     
+     profile_start();
+     qr_plot_modules(qr_state, x, y, scale);
+     *plot_cycles = profile_stop();
+     
+     profile_start();
+     render_qr_to_screen(qr_state, x, y, scale);
+     *span_cycles = profile_stop();
+     
+     LOG_INFO(MODULE_OPTIMIZE, "QR plot render cycles", *plot_cycles);
+     LOG_INFO(MODULE_OPTIMIZE, "QR span render cycles", *span_cycles);
+     return true;
+ }
+ 
+ /**
+  * @brief Packed stride for a format
+  * 
+  * 1bpp rows are padded to 16 bits so every row can be copied with
+  * halfword transfers (VRAM has no byte writes).
+  * 
+  * @param qr_size Symbol size in modules
+  * @param format Destination format
+  * @param scale Pixels per module
+  * @return Bytes per pixel row (per tile row for 4bpp)
+  */
+ int qr_output_stride(int qr_size, QrPixelFormat format, int scale) {
+     int width = qr_size * scale;
+     
+     switch (format) {
+         case QR_FORMAT_1BPP:      return ((width + 15) / 16) * 2;
+         case QR_FORMAT_4BPP_TILE: return ((width + 7) / 8) * (int)sizeof(TILE);
+         case QR_FORMAT_15BPP:     return width * 2;
+     }
+     return 0;
+ }
+ 
+ /**
+  * @brief Buffer size needed for a packed render_qr_output
+  * 
+  * @param qr_size Symbol size in modules
+  * @param format Destination format
+  * @param scale Pixels per module
+  * @return Size in bytes
+  */
+ u32 qr_output_size(int qr_size, QrPixelFormat format, int scale) {
+     int width = qr_size * scale;
+     int rows = (format == QR_FORMAT_4BPP_TILE) ? (width + 7) / 8 : width;
+     return (u32)qr_output_stride(qr_size, format, scale) * rows;
+ }
+ 
+ /**
+  * @brief Compute a cheap checksum over a symbol's module data
+  * 
+  * The retained renderers compare it with the symbol they uploaded last
+  * to skip an upload when nothing changed.
+  * 
+  * @param qr_state QR code state with pattern data
+  * @return Checksum of the size * size modules
+  */
+ u32 qr_matrix_checksum(const QrState *qr_state) {
+     const u8 *data = qr_state->data;
+     int count = qr_state->size * qr_state->size;
+     u32 sum = 0;
+     
+     for (int i = 0; i < count; i++) {
+         sum = (sum << 1 | sum >> 31) ^ data[i];
+     }
+     return sum;
+ }
+ 
+ /**
+  * @brief Copy one finished row to the destination
+  * 
+  * Sizes and strides are only guaranteed even, so DMA moves halfwords.
+  */
+ static inline void qr_output_copy(void *dst, const void *src, int bytes, bool use_dma) {
+     if (use_dma) {
+         dma_cpy(dst, src, bytes / 2, 3, DMA_CPY16);
+     } else {
+         memcpy16(dst, src, bytes / 2);
+     }
+ }
+ 
+ /**
+  * @brief Renders a QR code into a buffer in a selectable format
+  * 
+  * Each output row (or 8-row tile band for 4bpp) is built once in a line
+  * buffer and copied to every destination row it covers. A per-column
+  * module table keeps divisions out of the pixel loops.
+  * 
+  * @param qr_state QR code state
+  * @param out Destination format, stride, scale and copy method
+  * @return Success status
+  */
+ bool render_qr_output(const QrState *qr_state, const QrOutputParams *out) {
+     if (!qr_state || !qr_state->data || !out || !out->dest) {
+         LOG_ERROR(MODULE_RENDER, "Invalid parameters for QR output", 0);
+         return false;
+     }
+     
+     int qr_size = qr_state->size;
+     int scale = out->scale;
+     int width = qr_size * scale;
+     int packed = qr_output_stride(qr_size, out->format, scale);
+     int stride = out->stride ? out->stride : packed;
+     
+     if (scale < 1 || width > QR_OUTPUT_MAX_WIDTH || stride < packed || (stride & 1)) {
+         LOG_ERROR(MODULE_RENDER, "Unsupported QR output layout", width);
+         return false;
+     }
+     
+     u8 *dest = (u8*)out->dest;
+     u8 column_module[QR_OUTPUT_MAX_WIDTH];
+     
+     for (int px = 0, mx = 0, left = scale; px < width; px++) {
+         column_module[px] = mx;
+         if (--left == 0) {
+             mx++;
+             left = scale;
+         }
+     }
+     
+     switch (out->format) {
+         case QR_FORMAT_15BPP: {
+             u16 *line = (u16*)s_output_line;
+             for (int my = 0; my < qr_size; my++) {
+                 const u8 *modules = &qr_state->data[my * qr_size];
+                 for (int px = 0; px < width; px++) {
+                     line[px] = (modules[column_module[px]] == QR_MODULE_BLACK) ? out->dark : out->light;
+                 }
+                 for (int r = 0; r < scale; r++, dest += stride) {
+                     qr_output_copy(dest, line, packed, out->use_dma);
+                 }
+             }
+             break;
+         }
+         
+         case QR_FORMAT_1BPP: {
+             u16 *line = (u16*)s_output_line;
+             for (int my = 0; my < qr_size; my++) {
+                 const u8 *modules = &qr_state->data[my * qr_size];
+                 memset16(line, 0, packed / 2);
+                 for (int px = 0; px < width; px++) {
+                     if (modules[column_module[px]] == QR_MODULE_BLACK) {
+                         line[px >> 4] |= 1 << (px & 15);
+                     }
+                 }
+                 for (int r = 0; r < scale; r++, dest += stride) {
+                     qr_output_copy(dest, line, packed, out->use_dma);
+                 }
+             }
+             break;
+         }
+         
+         case QR_FORMAT_4BPP_TILE: {
+             u32 *band = s_output_line;
+             u32 light_row = (out->light & 0xF) * 0x11111111;
+             int tiles = packed / sizeof(TILE);
+             int my = 0, left = scale;
+             
+             for (int ty = 0; ty * 8 < width; ty++, dest += stride) {
+                 for (int py = 0; py < 8; py++) {
+                     bool inside = (ty * 8 + py < width);
+                     const u8 *modules = inside ? &qr_state->data[my * qr_size] : NULL;
+                     
+                     for (int t = 0; t < tiles; t++) {
+                         u32 row = light_row;
+                         for (int px = 0; inside && px < 8; px++) {
+                             int x = t * 8 + px;
+                             if (x < width && modules[column_module[x]] == QR_MODULE_BLACK) {
+                                 row = (row & ~(0xFu << (px * 4))) | ((u32)(out->dark & 0xF) << (px * 4));
+                             }
+                         }
+                         band[t * 8 + py] = row;
+                     }
                      
-                     // Place pixel - for Mode 3
-                     m3_plot(screen_x, screen_y, color);
+                     if (inside && --left == 0) {
+                         my++;
+                         left = scale;
+                     }
                  }
+                 qr_output_copy(dest, band, packed, out->use_dma);
              }
+             break;
          }
+         
+         default:
+             LOG_ERROR(MODULE_RENDER, "Unknown QR output format", out->format);
+             return false;
      }
      
-     LOG_INFO(MODULE_RENDER, "QR rendered to screen", qr_size);
      return true;
  }
  
  /**
-  * @brief Optimized QR rendering for GBA
+  * @brief Renders a QR code as 15bpp colors, one pixel per module
   * 
-  * Uses buffer-based rendering for better performance
+  * Rows are packed: the stride is qr_size pixels, not the width of the
+  * caller's buffer. Use render_qr_output for other layouts and formats.
   * 
   * @param qr_state QR code state
   * @param buffer Target buffer (can be NULL if rendering directly)
@@ -97,11 +450,18 @@
              return false;
          }
          
-         for (int y = 0; y < qr_size; y++) {
-             for (int x = 0; x < qr_size; x++) {
-                 int module_value = qr_state->data[y * qr_size + x];
-                 buffer[y * qr_size + x] = (module_value == QR_MODULE_BLACK) ? CLR_BLACK : CLR_WHITE;
-             }
+         QrOutputParams out = {
+             .format = QR_FORMAT_15BPP,
+             .dest = buffer,
+             .stride = 0,
+             .scale = 1,
+             .dark = CLR_BLACK,
+             .light = CLR_WHITE,
+             .use_dma = false
+         };
+         
+         if (!render_qr_output(qr_state, &out)) {
+             return false;
          }
          
          LOG_INFO(MODULE_RENDER, "QR rendered to buffer", qr_size);
@@ -115,36 +475,34 @@
  /**
   * @brief Creates a border around the QR code for better scanning
   * 
+  * Mode 3 only: the bitmap layer is opaque, so the border has to be
+  * drawn. Each border row is one or two span fills.
+  * 
   * @param x Top-left x position of QR code
   * @param y Top-left y position of QR code
   * @param size Size of QR code in pixels
   * @param border_size Size of border in pixels
   */
  void render_qr_border(int x, int y, int size, int border_size) {
-     // Draw white border around QR code
-     for (int i = 0; i < border_size; i++) {
-         // Top and bottom borders
-         for (int px = x - border_size; px < x + size + border_size; px++) {
-             // Top border
-             if (px >= 0 && px < SCREEN_WIDTH && y - i - 1 >= 0) {
-                 m3_plot(px, y - i - 1, CLR_WHITE);
-             }
-             // Bottom border
-             if (px >= 0 && px < SCREEN_WIDTH && y + size + i < SCREEN_HEIGHT) {
-                 m3_plot(px, y + size + i, CLR_WHITE);
-             }
-         }
-         
-         // Left and right borders
-         for (int py = y - border_size; py < y + size + border_size; py++) {
-             // Left border
-             if (x - i - 1 >= 0 && py >= 0 && py < SCREEN_HEIGHT) {
-                 m3_plot(x - i - 1, py, CLR_WHITE);
-             }
-             // Right border
-             if (x + size + i < SCREEN_WIDTH && py >= 0 && py < SCREEN_HEIGHT) {
-                 m3_plot(x + size + i, py, CLR_WHITE);
-             }
+     int left = x - border_size;
+     int right = x + size + border_size;
+     int top = y - border_size;
+     int bottom = y + size + border_size;
+     
+     if (left < 0) left = 0;
+     if (top < 0) top = 0;
+     if (right > SCREEN_WIDTH) right = SCREEN_WIDTH;
+     if (bottom > SCREEN_HEIGHT) bottom = SCREEN_HEIGHT;
+     
+     qr_claim_m3_rect(left, top, right - left, bottom - top);
+     
+     for (int py = top; py < bottom; py++) {
+         u16 *row = m3_mem[py];
+         if (py < y || py >= y + size) {
+             qr_span_fill(&row[left], right - left, CLR_WHITE);
+         } else {
+             qr_span_fill(&row[left], x - left, CLR_WHITE);
+             qr_span_fill(&row[x + size], right - (x + size), CLR_WHITE);
          }
      }
      
@@ -152,30 +510,54 @@
  }
  
  /**
-  * @brief Renders a QR code with improved tile-based rendering
+  * @brief Shows the quiet zone around a QR code using the display hardware
   * 
-  * @param qr_state QR code state
-  * @param x X position on screen
-  * @param y Y position on screen 
-  * @param scale Scale factor
-  * @return Success status
+  * Window 0 covers the symbol and its border. Inside it only the QR
+  * layers (BG2 and sprites) are shown, so text can never intrude, and
+  * the backdrop (palette entry 0) is white. Outside it all layers are
+  * shown and the brightness effect darkens the backdrop back to black.
+  * This costs a few register writes and no pixels. In Mode 3 the bitmap
+  * layer is opaque, so the border is also drawn with render_qr_border.
+  * 
+  * @param x Top-left x position of QR code
+  * @param y Top-left y position of QR code
+  * @param size Size of QR code in pixels
+  * @param border_size Size of border in pixels
   */
- bool render_qr_tile_based(QrState *qr_state, int x, int y, int scale) {
-     if (!qr_state || !qr_state->data) {
-         LOG_ERROR(MODULE_RENDER, "Invalid QR state for tile rendering", 0);
-         return false;
-     }
+ void render_qr_quiet_zone(int x, int y, int size, int border_size) {
+     int left = x - border_size;
+     int right = x + size + border_size;
+     int top = y - border_size;
+     int bottom = y + size + border_size;
+     
+     if (left < 0) left = 0;
+     if (top < 0) top = 0;
+     if (right > SCREEN_WIDTH) right = SCREEN_WIDTH;
+     if (bottom > SCREEN_HEIGHT) bottom = SCREEN_HEIGHT;
      
-     // This is a placeholder for an optimized tile-based rendering that would use
-     // the GBA's hardware tile capabilities instead of slow pixel-by-pixel rendering
+     REG_WIN0H = (left << 8) | right;
+     REG_WIN0V = (top << 8) | bottom;
+     REG_WININ = WIN_BUILD(WIN_BG2 | WIN_OBJ, 0);
+     REG_WINOUT = WIN_BUILD(WIN_ALL | WIN_BLD, 0);
      
-     // In a real implementation, we would:
-     // 1. Convert QR modules to tiles
-     // 2. Upload tiles to VRAM
-     // 3. Set up a screen background to display those tiles
+     pal_bg_mem[0] = CLR_WHITE;
+     REG_BLDCNT = BLD_BACKDROP | BLD_BLACK;
+     REG_BLDY = BLDY_BUILD(16);
      
-     // For now, we'll just use the direct rendering method
-     return render_qr_to_screen(qr_state, x, y, scale);
+     display_enable(DCNT_WIN0);
+     
+     if ((display_dispcnt() & DCNT_MODE_MASK) == DCNT_MODE3) {
+         render_qr_border(x, y, size, border_size);
+     }
+ }
+ 
+ /**
+  * @brief Removes the hardware quiet zone and restores the black backdrop
+  */
+ void render_qr_quiet_zone_hide(void) {
+     display_disable(DCNT_WIN0);
+     REG_BLDCNT = BLD_OFF;
+     pal_bg_mem[0] = CLR_BLACK;
  }
  
  /**
@@ -252,14 +634,20 @@
   * @brief Initialize rendering system
   */
  void qr_rendering_init(void) {
-     // Set up video mode
-     REG_DISPCNT = DCNT_MODE3 | DCNT_BG2;
+     static const DisplayScreen bitmap_screen = {
+         .name = "Mode 3 QR screen shown",
+         .mode = DCNT_MODE3,
+         .bg = { [2] = { DISPLAY_OWNER_BITMAP, 0, 0 } }
+     };
+     
+     // Set up video mode; hide the old screen while the bitmap is cleared
+     display_show(&bitmap_screen);
+     display_blank_now();
      
      // Clear screen to white
+     qr_claim_m3_rect(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
      for (int y = 0; y < SCREEN_HEIGHT; y++) {
-         for (int x = 0; x < SCREEN_WIDTH; x++) {
-             m3_plot(x, y, CLR_WHITE);
-         }
+         qr_span_fill(m3_mem[y], SCREEN_WIDTH, CLR_WHITE);
      }
      
      LOG_INFO(MODULE_RENDER, "QR rendering initialized", 0);
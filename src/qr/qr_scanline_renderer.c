@@ -0,0 +1,241 @@
+/**
+ * @file qr_scanline_renderer.c
+ * @brief Experimental scanline-streamed QR display (HBlank DMA)
+ *
+ * The symbol never exists in VRAM as pixels. Mode 4's BG2 is set up with
+ * affine parameters PA = 1/scale and PD = 0, so every screen line samples
+ * the same single bitmap row, stretched horizontally. During each HBlank,
+ * DMA0 copies the next line of a packed line stream (one byte per module,
+ * every module row repeated `scale` times) into that row.
+ *
+ * VRAM cost is one row of page 0 (under 64 bytes); RAM cost is the line
+ * stream. The VBlank interrupt (as the commit queue's hook) re-arms DMA0
+ * for each frame, so a late main loop can never let the DMA run past the
+ * stream.
+ *
+ * Row 0 of page 0 overlaps the start of CBB 0; menu_restore_graphics()
+ * after render_qr_scanline_end() reloads just the font.
+ *
+ * @author Claude
+ * @date October 2026
+ * @version 1.0.0
+ */
+
+ #include <tonc.h>
+ #include <string.h>
+ #include "qr_system.h"
+ #include "qr_debug.h"
+ #include "display_compositor.h"
+ #include "vblank_queue.h"
+
+ // Widest streamed row: version 5 (37 modules) plus a 4-module quiet zone
+ #define QR_SCANLINE_MAX_ROW     48
+
+ // One entry per screen line, plus the row DMA fetches in the last HBlank
+ #define QR_SCANLINE_LINES       (SCREEN_HEIGHT + 1)
+
+ // Mode 4 palette indices, shared with the tile renderer's palette bank
+ #define QR_SCANLINE_CLR_WHITE   (QR_TILE_PALETTE_BANK * 16 + 1)
+ #define QR_SCANLINE_CLR_BLACK   (QR_TILE_PALETTE_BANK * 16 + 2)
+
+ /**
+  * Scanline display state
+  */
+ typedef struct {
+     bool active;                // Whether DMA0 streams the symbol
+     int row_bytes;              // Bytes per stream line (even)
+ } QrScanlineDisplay;
+
+ static const DisplayScreen s_scanline_screen = {
+     .name = "Scanline QR screen shown",
+     .mode = DCNT_MODE4,
+     .bg = { [2] = { DISPLAY_OWNER_BITMAP, 0, 0 } }
+ };
+
+ static QrScanlineDisplay s_scanline = {0};
+ static u8 s_line_stream[QR_SCANLINE_LINES * QR_SCANLINE_MAX_ROW] ALIGN4;
+
+ /**
+  * @brief Build the line stream for a symbol
+  *
+  * Each module row is expanded once into its first line and copied to
+  * the following scale-1 lines. Lines outside the symbol and quiet zone
+  * are transparent.
+  *
+  * @return Bytes per stream line
+  */
+ static int qr_scanline_build(const QrState *qr, int y, int scale, int quiet_zone) {
+     int modules = qr->size + 2 * quiet_zone;
+     int row_bytes = (modules + 1) & ~1;
+     int top = y - quiet_zone * scale;
+
+     memset32(s_line_stream, 0, sizeof(s_line_stream) / 4);
+
+     for (int r = 0; r < modules; r++) {
+         int line = top + r * scale;
+         u8 *dst = &s_line_stream[line * row_bytes];
+         int my = r - quiet_zone;
+
+         for (int m = 0; m < modules; m++) {
+             int mx = m - quiet_zone;
+             bool dark = (mx >= 0 && my >= 0 && mx < qr->size && my < qr->size &&
+                          qr->data[my * qr->size + mx] == 1);
+             dst[m] = dark ? QR_SCANLINE_CLR_BLACK : QR_SCANLINE_CLR_WHITE;
+         }
+
+         for (int k = 1; k < scale; k++) {
+             memcpy(dst + k * row_bytes, dst, row_bytes);
+         }
+     }
+
+     return row_bytes;
+ }
+
+ /**
+  * @brief Load line 0 and arm DMA0 to stream the rest of the frame
+  *
+  * Runs from the VBlank interrupt while the display is active.
+  */
+ static void qr_scanline_vblank_isr(void) {
+     u16 *row = (u16*)MEM_VRAM;
+     int halfwords = s_scanline.row_bytes / 2;
+
+     REG_DMA0CNT = 0;
+     memcpy16(row, s_line_stream, halfwords);
+
+     // The HBlank after line n fetches the row shown on line n+1
+     REG_DMA0SAD = (u32)&s_line_stream[s_scanline.row_bytes];
+     REG_DMA0DAD = (u32)row;
+     REG_DMA0CNT = DMA_HDMA | DMA_16 | DMA_ENABLE | halfwords;
+ }
+
+ /**
+  * @brief Start streaming a QR code through HBlank DMA
+  *
+  * Switches to Mode 4 with an affine-stretched single-row bitmap and
+  * installs the VBlank interrupt that re-arms the stream every frame.
+  *
+  * @param qr_state QR code state
+  * @param x X position of the symbol
+  * @param y Y position of the symbol
+  * @param scale Module scale in pixels
+  * @param quiet_zone Quiet zone width in modules
+  * @return Success status
+  */
+ bool render_qr_scanline_begin(QrState *qr_state, int x, int y, int scale, int quiet_zone) {
+     if (!qr_state || !qr_state->data) {
+         LOG_ERROR(MODULE_RENDER, "Invalid QR state for scanline display", 0);
+         return false;
+     }
+
+     int modules = qr_state->size + 2 * quiet_zone;
+     int border = quiet_zone * scale;
+
+     if (scale < 1 || quiet_zone < 0 || modules > QR_SCANLINE_MAX_ROW ||
+         x - border < 0 || y - border < 0 ||
+         x - border + modules * scale > SCREEN_WIDTH ||
+         y - border + modules * scale > SCREEN_HEIGHT) {
+         LOG_ERROR(MODULE_RENDER, "QR won't fit scanline display", qr_state->size);
+         return false;
+     }
+
+     display_blank_now();
+
+     s_scanline.row_bytes = qr_scanline_build(qr_state, y, scale, quiet_zone);
+
+     // Texture row 0 is the streamed line; the rest of it stays transparent
+     display_claim_vram(DISPLAY_OWNER_BITMAP, 0, M4_WIDTH);
+     memset32((void*)MEM_VRAM, 0, M4_WIDTH / 4);
+
+     pal_bg_mem[QR_SCANLINE_CLR_WHITE] = CLR_WHITE;
+     pal_bg_mem[QR_SCANLINE_CLR_BLACK] = CLR_BLACK;
+
+     // Every screen line samples texture row 0, stretched by scale
+     int step = (1 << 8) / scale;
+     REG_BG2PA = step;
+     REG_BG2PB = 0;
+     REG_BG2PC = 0;
+     REG_BG2PD = 0;
+     REG_BG2X = -(x - border) * step;
+     REG_BG2Y = 0;
+
+     s_scanline.active = true;
+     vblank_queue_set_hook(qr_scanline_vblank_isr);
+
+     display_show(&s_scanline_screen);
+
+     LOG_INFO(MODULE_RENDER, "Scanline QR display started", s_scanline.row_bytes);
+     return true;
+ }
+
+ /**
+  * @brief Stop the HBlank stream and remove its VBlank interrupt
+  */
+ void render_qr_scanline_end(void) {
+     if (!s_scanline.active) return;
+
+     vblank_queue_set_hook(NULL);
+     REG_DMA0CNT = 0;
+     s_scanline.active = false;
+
+     LOG_INFO(MODULE_RENDER, "Scanline QR display stopped", 0);
+ }
+
+ /**
+  * @brief Compare scanline streaming with a Mode 3 render
+  *
+  * Times the one-off stream build, one VBlank re-arm and a full Mode 3
+  * span render, and reports the VRAM and RAM each approach keeps. DMA0
+  * is stopped again afterwards. Overwrites VRAM, so callers restore
+  * their graphics when done.
+  *
+  * @param qr_state QR code state
+  * @param x X position of the symbol
+  * @param y Y position of the symbol
+  * @param scale Module scale in pixels
+  * @param result Output: measured cost
+  * @return Success status
+  */
+ bool render_qr_scanline_benchmark(QrState *qr_state, int x, int y, int scale,
+                                   QrScanlineBenchmark *result) {
+     if (!qr_state || !qr_state->data || !result) {
+         LOG_ERROR(MODULE_OPTIMIZE, "Invalid parameters for scanline benchmark", 0);
+         return false;
+     }
+
+     int width = qr_state->size * scale;
+
+     if (s_scanline.active || scale < 1 || qr_state->size > QR_SCANLINE_MAX_ROW ||
+         y < 0 || y + width > SCREEN_HEIGHT) {
+         LOG_ERROR(MODULE_OPTIMIZE, "Scanline benchmark unavailable", qr_state->size);
+         return false;
+     }
+
+     profile_start();
+     s_scanline.row_bytes = qr_scanline_build(qr_state, y, scale, 0);
+     result->build_cycles = profile_stop();
+
+     display_claim_vram(DISPLAY_OWNER_BITMAP, 0, M4_WIDTH);
+
+     profile_start();
+     qr_scanline_vblank_isr();
+     result->frame_cycles = profile_stop();
+     REG_DMA0CNT = 0;
+
+     result->vram_bytes = s_scanline.row_bytes;
+     result->ram_bytes = QR_SCANLINE_LINES * s_scanline.row_bytes;
+     result->dma_bytes_per_frame = SCREEN_HEIGHT * s_scanline.row_bytes;
+
+     profile_start();
+     bool rendered = render_qr_to_screen(qr_state, x, y, scale);
+     result->mode3_cycles = profile_stop();
+     result->mode3_vram_bytes = width * width * 2;
+
+     LOG_INFO(MODULE_OPTIMIZE, "Scanline build cycles", result->build_cycles);
+     LOG_INFO(MODULE_OPTIMIZE, "Scanline frame cycles", result->frame_cycles);
+     LOG_INFO(MODULE_OPTIMIZE, "Scanline VRAM bytes", result->vram_bytes);
+     LOG_INFO(MODULE_OPTIMIZE, "Mode 3 render cycles", result->mode3_cycles);
+     LOG_INFO(MODULE_OPTIMIZE, "Mode 3 VRAM bytes", result->mode3_vram_bytes);
+
+     return rendered;
+ }
@@ -0,0 +1,229 @@
+/**
+ * @file qr_sprite_renderer.c
+ * @brief Sprite (OAM) based QR overlay
+ *
+ * The symbol and its quiet zone are built from up to 3x3 64x64 4bpp sprites
+ * in OBJ VRAM. The text and menu backgrounds are never touched, so showing
+ * or hiding the QR only changes OAM attributes and the screen behind it
+ * does not need a redraw.
+ *
+ * Layout:
+ * - OAM entries QR_SPRITE_FIRST_OBJ onward (entry 0 is the menu cursor)
+ * - OBJ tiles from QR_SPRITE_FIRST_TILE, 64 tiles per sprite (1D mapping)
+ * - OBJ palette bank QR_SPRITE_PALETTE_BANK: 1 = white, 2 = black
+ *
+ * The tiles lie in the lower half of OBJ VRAM, which is only available in
+ * the tiled video modes.
+ *
+ * @author Claude
+ * @date October 2026
+ * @version 1.0.0
+ */
+
+ #include <tonc.h>
+ #include <string.h>
+ #include "qr_system.h"
+ #include "qr_debug.h"
+ #include "menu_system.h"
+ #include "display_compositor.h"
+ #include "vblank_queue.h"
+
+ #define QR_SPRITE_SIZE          64
+ #define QR_SPRITE_TILES         ((QR_SPRITE_SIZE / 8) * (QR_SPRITE_SIZE / 8))
+ #define QR_SPRITE_GRID          3
+ #define QR_SPRITE_MAX_PIXELS    (QR_SPRITE_GRID * QR_SPRITE_SIZE)
+
+ #define QR_SPRITE_CLR_WHITE     1
+ #define QR_SPRITE_CLR_BLACK     2
+
+ /**
+  * Renderer state
+  */
+ typedef struct {
+     const u8 *last_data;        // Module data currently uploaded
+     int last_size;              // Symbol size currently uploaded
+     int last_scale;             // Scale currently uploaded
+     int last_quiet_zone;        // Quiet zone currently uploaded
+     u32 last_checksum;          // Checksum of uploaded module data
+     int grid;                   // Sprites per side in use
+     bool visible;               // Whether the sprites are shown
+ } QrSpriteRenderer;
+
+ static QrSpriteRenderer s_sprites = {0};
+
+ /**
+  * @brief Upload the symbol and quiet zone into the sprite tiles
+  *
+  * A lookup table maps each pixel column/row to its module (including the
+  * quiet zone), which keeps divisions out of the pixel loop. Pixels past
+  * the quiet zone are transparent.
+  */
+ static void qr_sprite_upload(const QrState *qr, int scale, int quiet_zone) {
+     int modules = qr->size + 2 * quiet_zone;
+     int pixels = modules * scale;
+     s16 module_at[QR_SPRITE_MAX_PIXELS];
+
+     for (int p = 0, m = 0, left = scale; p < QR_SPRITE_MAX_PIXELS; p++) {
+         module_at[p] = (p < pixels) ? m : -1;
+         if (--left == 0) {
+             m++;
+             left = scale;
+         }
+     }
+
+     s_sprites.grid = (pixels + QR_SPRITE_SIZE - 1) / QR_SPRITE_SIZE;
+
+     for (int sy = 0; sy < s_sprites.grid; sy++) {
+         for (int sx = 0; sx < s_sprites.grid; sx++) {
+             TILE *dst = &tile_mem[4][QR_SPRITE_FIRST_TILE +
+                                      (sy * QR_SPRITE_GRID + sx) * QR_SPRITE_TILES];
+
+             for (int ty = 0; ty < 8; ty++) {
+                 for (int tx = 0; tx < 8; tx++) {
+                     TILE tile;
+
+                     for (int py = 0; py < 8; py++) {
+                         int row = module_at[sy * QR_SPRITE_SIZE + ty * 8 + py];
+                         int my = row - quiet_zone;
+                         u32 bits = 0;
+
+                         for (int px = 0; px < 8; px++) {
+                             int col = module_at[sx * QR_SPRITE_SIZE + tx * 8 + px];
+                             int mx = col - quiet_zone;
+                             u32 index;
+
+                             if (row < 0 || col < 0) {
+                                 index = 0;
+                             } else if (mx >= 0 && my >= 0 && mx < qr->size && my < qr->size &&
+                                        qr->data[my * qr->size + mx] == 1) {
+                                 index = QR_SPRITE_CLR_BLACK;
+                             } else {
+                                 index = QR_SPRITE_CLR_WHITE;
+                             }
+                             bits |= index << (px * 4);
+                         }
+                         tile.data[py] = bits;
+                     }
+
+                     memcpy32(&dst[ty * 8 + tx], &tile, sizeof(TILE) / 4);
+                 }
+             }
+         }
+     }
+ }
+
+ /**
+  * @brief Write the OAM entries of the QR sprites and queue them for OAM
+  */
+ static void qr_sprite_place(int left, int top) {
+     OBJ_ATTR *obj = &obj_buffer[QR_SPRITE_FIRST_OBJ];
+
+     for (int sy = 0; sy < QR_SPRITE_GRID; sy++) {
+         for (int sx = 0; sx < QR_SPRITE_GRID; sx++, obj++) {
+             if (sx >= s_sprites.grid || sy >= s_sprites.grid) {
+                 obj_set_attr(obj, ATTR0_HIDE, 0, 0);
+                 continue;
+             }
+
+             int tile = QR_SPRITE_FIRST_TILE + (sy * QR_SPRITE_GRID + sx) * QR_SPRITE_TILES;
+             obj_set_attr(obj,
+                          ATTR0_SQUARE | ATTR0_4BPP | ATTR0_Y(top + sy * QR_SPRITE_SIZE),
+                          ATTR1_SIZE_64 | ATTR1_X(left + sx * QR_SPRITE_SIZE),
+                          ATTR2_PALBANK(QR_SPRITE_PALETTE_BANK) | ATTR2_PRIO(0) | ATTR2_ID(tile));
+         }
+     }
+
+     vblank_queue_copy(&oam_mem[QR_SPRITE_FIRST_OBJ], &obj_buffer[QR_SPRITE_FIRST_OBJ],
+                       QR_SPRITE_MAX_OBJS * sizeof(OBJ_ATTR));
+ }
+
+ /**
+  * @brief Renders a QR code as a sprite overlay
+  *
+  * Tiles are only rebuilt when the symbol, scale or quiet zone changed;
+  * otherwise only the OAM positions are written.
+  *
+  * @param qr_state QR code state
+  * @param x X position of the symbol on screen
+  * @param y Y position of the symbol on screen
+  * @param scale Module scale in pixels
+  * @param quiet_zone Quiet zone width in modules
+  * @return Success status
+  */
+ bool render_qr_sprites(QrState *qr_state, int x, int y, int scale, int quiet_zone) {
+     if (!qr_state || !qr_state->data) {
+         LOG_ERROR(MODULE_RENDER, "Invalid QR state for sprite rendering", 0);
+         return false;
+     }
+
+     int border = quiet_zone * scale;
+     int pixels = (qr_state->size + 2 * quiet_zone) * scale;
+
+     if (scale < 1 || quiet_zone < 0 || pixels > QR_SPRITE_MAX_PIXELS ||
+         x - border < 0 || y - border < 0 ||
+         x - border + pixels > SCREEN_WIDTH || y - border + pixels > SCREEN_HEIGHT) {
+         LOG_ERROR(MODULE_RENDER, "QR won't fit sprite overlay", qr_state->size);
+         return false;
+     }
+
+     // Bitmap pages overlap the lower OBJ tiles
+     if (!display_claim_obj(DISPLAY_OWNER_QR_SPRITES, QR_SPRITE_FIRST_TILE,
+                            QR_SPRITE_MAX_OBJS * QR_SPRITE_TILES)) {
+         s_sprites.last_data = NULL;
+     }
+
+     u32 checksum = qr_matrix_checksum(qr_state);
+
+     if (s_sprites.last_data != qr_state->data ||
+         s_sprites.last_size != qr_state->size ||
+         s_sprites.last_scale != scale ||
+         s_sprites.last_quiet_zone != quiet_zone ||
+         s_sprites.last_checksum != checksum) {
+
+         qr_sprite_upload(qr_state, scale, quiet_zone);
+
+         s_sprites.last_data = qr_state->data;
+         s_sprites.last_size = qr_state->size;
+         s_sprites.last_scale = scale;
+         s_sprites.last_quiet_zone = quiet_zone;
+         s_sprites.last_checksum = checksum;
+
+         LOG_INFO(MODULE_RENDER, "QR sprites uploaded", s_sprites.grid * s_sprites.grid);
+     }
+
+     pal_obj_bank[QR_SPRITE_PALETTE_BANK][QR_SPRITE_CLR_WHITE] = CLR_WHITE;
+     pal_obj_bank[QR_SPRITE_PALETTE_BANK][QR_SPRITE_CLR_BLACK] = CLR_BLACK;
+
+     qr_sprite_place(x - border, y - border);
+     display_enable(DCNT_OBJ | DCNT_OBJ_1D);
+     s_sprites.visible = true;
+
+     return true;
+ }
+
+ /**
+  * @brief Hide the QR sprites
+  *
+  * Tiles stay in OBJ VRAM, so showing the same symbol again only
+  * rewrites the OAM entries.
+  */
+ void render_qr_sprites_hide(void) {
+     if (!s_sprites.visible) return;
+
+     for (int i = 0; i < QR_SPRITE_MAX_OBJS; i++) {
+         obj_hide(&obj_buffer[QR_SPRITE_FIRST_OBJ + i]);
+     }
+     vblank_queue_copy(&oam_mem[QR_SPRITE_FIRST_OBJ], &obj_buffer[QR_SPRITE_FIRST_OBJ],
+                       QR_SPRITE_MAX_OBJS * sizeof(OBJ_ATTR));
+
+     s_sprites.visible = false;
+ }
+
+ /**
+  * @brief Force the next sprite render to rebuild the tiles
+  *
+  * Call after other code has reused the QR sprite tiles.
+  */
+ void render_qr_sprites_invalidate(void) {
+     s_sprites.last_data = NULL;
+ }
@@ -8,6 +8,7 @@
  */
 
 #include "qr_system.h"
+#include "memory_system.h"
 
 // Global QR system state
 QrSystemState g_qr_state = {
@@ -22,19 +23,33 @@ QrSystemState g_qr_state = {
 // Static buffer for text storage
 static char text_buffer[256];
 
+// QR matrices: one pool block per encoded QrState
+static MemPool s_qr_matrix_pool;
+
 // Forward declarations for functions implemented in other files
 extern bool qr_encode_text(QrState *qr_state, const char *text, QrEcLevel ec_level);
 extern bool render_qr_to_screen(QrState *qr_state, int x, int y, int scale);
 
+/**
+ * Carve the QR matrix pool on first use (the first qr_init at boot)
+ */
+static bool qr_matrix_pool_init(void) {
+    if (s_qr_matrix_pool.base) return true;
+
+    return mem_pool_init(&s_qr_matrix_pool, MEM_REGION_EWRAM,
+                         QR_MATRIX_MAX_SIZE * QR_MATRIX_MAX_SIZE,
+                         QR_MATRIX_POOL_BLOCKS, "QR matrix pool");
+}
+
 /**
  * Initialize a QR state
  */
 void qr_init(QrState *qr_state) {
     if (!qr_state) return;
 
-    qr_state->size = 0;
-    qr_state->data = NULL;
-    qr_state->data_length = 0;
+    qr_matrix_pool_init();
+    qr_free(qr_state);
+
     qr_state->ec_level = QR_ECLEVEL_M;
     qr_state->mask_pattern = 0;
     qr_state->auto_mask = true;
@@ -47,7 +62,7 @@ void qr_free(QrState *qr_state) {
     if (!qr_state) return;
 
     if (qr_state->data) {
-        free(qr_state->data);
+        mem_pool_free(&s_qr_matrix_pool, qr_state->data);
         qr_state->data = NULL;
     }
 
@@ -55,6 +70,15 @@ void qr_free(QrState *qr_state) {
     qr_state->data_length = 0;
 }
 
+/**
+ * Take a QR matrix buffer from the pool
+ */
+u8 *qr_matrix_alloc(void) {
+    if (!qr_matrix_pool_init()) return NULL;
+
+    return mem_pool_alloc(&s_qr_matrix_pool);
+}
+
 /**
  * Set the text content for a QR code
  */
@@ -17,6 +17,7 @@
  #include <tonc.h>
  #include <stdlib.h>
  #include <string.h>
+ #include "gba_sections.h"
  
  /**
   * Maximum QR code size in modules (Version 40)
@@ -24,6 +25,17 @@
   * the largest QR codes at a readable size.
   */
  #define QR_MAX_SIZE 177
+
+ /**
+  * Largest QR code the encoder produces (Version 5), in modules
+  * QR matrices are pool blocks of this size squared
+  */
+ #define QR_MATRIX_MAX_SIZE 37
+
+ /**
+  * QR matrices alive at once: menu, wallet and the protection variations
+  */
+ #define QR_MATRIX_POOL_BLOCKS 12
  
  /**
   * Screen dimensions (used for boundary checks)
@@ -61,7 +73,6 @@
   */
  typedef struct {
      QrState qr_state;         // The main QR state
-     u16 qr_buffer[128*128];   // Buffer for QR rendering
      int refresh_rate;         // Screen refresh rate in FPS
      int update_interval;      // Update interval in frames
      int qr_pixel_size;        // Size of each QR module in pixels
@@ -82,12 +93,36 @@
      int border_size;            // Border size in pixels
  } QrRenderParams;
 
+ /**
+  * Destination pixel formats for render_qr_output
+  */
+ typedef enum {
+     QR_FORMAT_1BPP,             // Packed bits, leftmost pixel in bit 0, 1 = dark
+     QR_FORMAT_4BPP_TILE,        // 8x8 4bpp tiles, left to right within a tile row
+     QR_FORMAT_15BPP             // One BGR555 halfword per pixel
+ } QrPixelFormat;
+
+ /**
+  * Output description for render_qr_output
+  */
+ typedef struct {
+     QrPixelFormat format;       // Destination format
+     void *dest;                 // Destination in RAM or VRAM
+     int stride;                 // Bytes between pixel rows (tile rows for 4bpp); 0 = packed
+     int scale;                  // Pixels per module
+     u16 dark;                   // Dark modules: color (15bpp) or palette index (4bpp)
+     u16 light;                  // Light modules: color (15bpp) or palette index (4bpp)
+     bool use_dma;               // Copy rows with DMA3 instead of the CPU
+ } QrOutputParams;
+
  /**
   * QR code generation and management functions
   */
 
  /**
   * Initialize a QR state
+  * A matrix the state still holds goes back to the pool first, so the
+  * state must be zeroed or previously initialized
   * @param qr_state QR code state to initialize
   */
  void qr_init(QrState *qr_state);
@@ -98,6 +133,12 @@
   */
  void qr_free(QrState *qr_state);
  
+ /**
+  * Take a QR matrix buffer (QR_MATRIX_MAX_SIZE squared bytes) from the pool
+  * @return Buffer, or NULL if every matrix is in use
+  */
+ u8 *qr_matrix_alloc(void);
+ 
  /**
   * Set the text content for a QR code
   * @param qr_state QR code state
@@ -134,17 +175,258 @@
   * @param scale Scaling factor (1 = 1 pixel per module)
   * @return Success status
   */
- bool render_qr_to_screen(QrState *qr_state, int x, int y, int scale);
+ IWRAM_CODE bool render_qr_to_screen(QrState *qr_state, int x, int y, int scale);
  
  /**
-  * Optimized QR rendering for GBA
-  * Uses sprite or tile-based rendering for better performance
+  * Benchmark the Mode 3 span renderer against per-pixel plotting
+  * @param qr_state QR code state with pattern data
+  * @param x Top-left x position for rendering
+  * @param y Top-left y position for rendering
+  * @param scale Scaling factor
+  * @param plot_cycles Output: cycles for per-pixel plotting
+  * @param span_cycles Output: cycles for span rendering
+  * @return Success status
+  */
+ bool render_qr_benchmark(QrState *qr_state, int x, int y, int scale,
+                          u32 *plot_cycles, u32 *span_cycles);
+
+ /**
+  * Tile-mode QR layer configuration
+  * The QR background uses BG2 in Mode 0, next to the TTE text layer
+  * (BG0, CBB 0, SBB 30) and the menu background (BG1, CBB 1, SBB 28/29).
+  */
+ #define QR_TILE_BG              2
+ #define QR_TILE_CHAR_BLOCK      2
+ #define QR_TILE_SCREEN_BLOCK    26
+ #define QR_TILE_PALETTE_BANK    15
+ #define QR_TILE_MAX_TILES       256
+
+ /**
+  * Render a QR code on the tiled QR background (BG2)
+  * Only map entries are written; unchanged symbols cost two scroll writes
+  * @param qr_state QR code state with pattern data
+  * @param x Top-left x position for rendering
+  * @param y Top-left y position for rendering
+  * @param scale Scaling factor (1 = 1 pixel per module)
+  * @return Success status
+  */
+ bool render_qr_tile_based(QrState *qr_state, int x, int y, int scale);
+
+ /**
+  * Hide the tiled QR background
+  */
+ void render_qr_tile_hide(void);
+
+ /**
+  * Force the next tile-based render to rebuild tiles and map
+  */
+ void render_qr_tile_invalidate(void);
+
+ /**
+  * Time building a symbol on the tiled background and redrawing it unchanged
+  * Leaves the layer hidden
+  * @param qr_state QR code state with pattern data
+  * @param x Top-left x position for rendering
+  * @param y Top-left y position for rendering
+  * @param scale Scaling factor
+  * @param build_cycles Output: cycles for tiles and map from scratch
+  * @param redraw_cycles Output: cycles for a redraw of the same symbol
+  * @return Success status
+  */
+ bool render_qr_tile_benchmark(QrState *qr_state, int x, int y, int scale,
+                               u32 *build_cycles, u32 *redraw_cycles);
+
+ /**
+  * Prepare the shared QR tile set for a scale
+  * Scales 4 and 8 keep a precomputed set; other scales empty the dictionary
+  * @param scale Module scale of the maps that follow
+  */
+ void qr_tile_reset(int scale);
+
+ /**
+  * Emit a tile map for a symbol, uploading missing tiles
+  * @param qr QR code state
+  * @param scale Module scale (as passed to qr_tile_reset)
+  * @param map Screen block to write (32 entries per row), or NULL to only register tiles
+  * @return Map side length in tiles, or -1 if the dictionary is full
+  */
+ int qr_tile_emit_map(const QrState *qr, int scale, SCR_ENTRY *map);
+
+ /**
+  * Number of QR tiles in use (excluding the transparent tile 0)
+  * @return Tile count
+  */
+ int qr_tile_count(void);
+
+ /**
+  * Tile set generation; changes whenever tile ids are reassigned
+  * @return Generation counter
+  */
+ u32 qr_tile_generation(void);
+
+ /**
+  * Claim the QR char block, the single-symbol map and extra map blocks
+  * Invalidates the tile set if another screen overwrote any of them
+  * @param map_blocks Additional screen blocks holding QR maps
+  */
+ void qr_tile_claim_vram(u32 map_blocks);
+
+ /**
+  * Sprite QR overlay configuration
+  * Up to 3x3 64x64 4bpp sprites after the menu cursor (OAM entry 0,
+  * OBJ tiles 0-3); OBJ tiles QR_SPRITE_FIRST_TILE onward
+  */
+ #define QR_SPRITE_FIRST_OBJ     1
+ #define QR_SPRITE_MAX_OBJS      9
+ #define QR_SPRITE_FIRST_TILE    16
+ #define QR_SPRITE_PALETTE_BANK  15
+
+ /**
+  * Render a QR code as a sprite overlay above the text and menu layers
+  * Unchanged symbols only rewrite OAM; the backgrounds are never touched
+  * @param qr_state QR code state with pattern data
+  * @param x Top-left x position of the symbol
+  * @param y Top-left y position of the symbol
+  * @param scale Scaling factor
+  * @param quiet_zone White border around the symbol, in modules
+  * @return Success status
+  */
+ bool render_qr_sprites(QrState *qr_state, int x, int y, int scale, int quiet_zone);
+
+ /**
+  * Hide the sprite QR overlay
+  */
+ void render_qr_sprites_hide(void);
+
+ /**
+  * Force the next sprite render to rebuild its tiles
+  */
+ void render_qr_sprites_invalidate(void);
+
+ /**
+  * Scanline display cost compared with a Mode 3 render
+  */
+ typedef struct {
+     u32 build_cycles;           // Building the line stream (once per symbol)
+     u32 frame_cycles;           // VBlank re-arm, per frame
+     u32 vram_bytes;             // VRAM holding symbol pixels
+     u32 ram_bytes;              // Line stream in RAM
+     u32 dma_bytes_per_frame;    // Bytes HBlank DMA moves each frame
+     u32 mode3_cycles;           // Full Mode 3 render
+     u32 mode3_vram_bytes;       // Mode 3 framebuffer pixels of the symbol
+ } QrScanlineBenchmark;
+
+ /**
+  * Show a QR code streamed line by line through HBlank DMA
+  * Mode 4 BG2 samples a single affine-stretched bitmap row that DMA0
+  * refills every HBlank; a VBlank interrupt re-arms the stream each frame
+  * @param qr_state QR code state with pattern data
+  * @param x Top-left x position of the symbol
+  * @param y Top-left y position of the symbol
+  * @param scale Scaling factor
+  * @param quiet_zone White border around the symbol, in modules
+  * @return Success status
+  */
+ bool render_qr_scanline_begin(QrState *qr_state, int x, int y, int scale, int quiet_zone);
+
+ /**
+  * Stop the scanline display; callers restore their text graphics
+  */
+ void render_qr_scanline_end(void);
+
+ /**
+  * Measure the scanline display against a Mode 3 render (overwrites VRAM)
+  * @param qr_state QR code state with pattern data
+  * @param x Top-left x position of the symbol
+  * @param y Top-left y position of the symbol
+  * @param scale Scaling factor
+  * @param result Output: measured cost
+  * @return Success status
+  */
+ bool render_qr_scanline_benchmark(QrState *qr_state, int x, int y, int scale,
+                                   QrScanlineBenchmark *result);
+
+ /**
+  * Affine QR layer configuration
+  * BG2 in Mode 1 with a 16x16-tile (128 px) 8bpp affine map. Tiles start at
+  * CBB 3 (SBB 24-25) and the map uses SBB 27, clear of the tile layer above
+  * and of the text/menu screen blocks 28-30. Those two blocks hold 63 tiles
+  * besides the transparent one, so symbol plus quiet zone is at most 56
+  * modules; a wallet address (29-37 modules) fits with room for a border.
+  */
+ #define QR_AFFINE_CHAR_BLOCK    3
+ #define QR_AFFINE_SCREEN_BLOCK  27
+
+ /**
+  * Render a QR code scaled in hardware through the BG2 affine matrix
+  * The symbol is uploaded once at 1 px per module; no per-frame CPU cost
+  * Fails if symbol plus quiet zone exceeds 56 modules
+  * @param qr_state QR code state with pattern data
+  * @param x Top-left x position (including quiet zone)
+  * @param y Top-left y position (including quiet zone)
+  * @param size Side length on screen in pixels (including quiet zone)
+  * @param quiet_zone Quiet zone width in modules
+  * @return Success status
+  */
+ bool render_qr_affine(QrState *qr_state, int x, int y, int size, int quiet_zone);
+
+ /**
+  * Render a QR code at the largest size that fits the screen height
+  * @param qr_state QR code state with pattern data
+  * @param margin Margin in pixels above and below the code
+  * @param quiet_zone Quiet zone width in modules
+  * @return Success status
+  */
+ bool render_qr_affine_fit(QrState *qr_state, int margin, int quiet_zone);
+
+ /**
+  * Hide the affine QR layer and return to Mode 0
+  */
+ void render_qr_affine_hide(void);
+
+ /**
+  * Render a QR code as 15bpp colors, one pixel per module
+  * Rows are packed (stride = qr_size pixels); see render_qr_output
   * @param qr_state QR code state
   * @param buffer Target buffer (can be NULL if rendering directly)
   * @return Success status
   */
  bool render_qr_optimized(QrState *qr_state, u16 *buffer);
  
+ /**
+  * Render a QR code into a buffer in a selectable format
+  * Rows are written with halfword copies, so dest may be VRAM
+  * @param qr_state QR code state
+  * @param out Destination format, stride, scale and copy method
+  * @return Success status
+  */
+ bool render_qr_output(const QrState *qr_state, const QrOutputParams *out);
+
+ /**
+  * Packed stride for a format (1bpp rows are padded to 16 bits)
+  * @param qr_size Symbol size in modules
+  * @param format Destination format
+  * @param scale Pixels per module
+  * @return Bytes per pixel row (per tile row for 4bpp)
+  */
+ int qr_output_stride(int qr_size, QrPixelFormat format, int scale);
+
+ /**
+  * Buffer size needed for a packed render_qr_output
+  * @param qr_size Symbol size in modules
+  * @param format Destination format
+  * @param scale Pixels per module
+  * @return Size in bytes
+  */
+ u32 qr_output_size(int qr_size, QrPixelFormat format, int scale);
+
+ /**
+  * Cheap checksum over a symbol's modules, to tell whether it changed
+  * @param qr_state QR code state with pattern data
+  * @return Checksum
+  */
+ u32 qr_matrix_checksum(const QrState *qr_state);
+
  /**
   * Creates a border around the QR code for better scanning
   * @param x Top-left x position of QR code
@@ -153,6 +435,22 @@
   * @param border_size Size of border in pixels
   */
  void render_qr_border(int x, int y, int size, int border_size);
+
+ /**
+  * Show the quiet zone from the white backdrop inside window 0
+  * Other layers are clipped out of the rectangle; no pixels are drawn
+  * (except in Mode 3, whose opaque bitmap needs render_qr_border)
+  * @param x Top-left x position of QR code
+  * @param y Top-left y position of QR code
+  * @param size Size of QR code in pixels
+  * @param border_size Size of border in pixels
+  */
+ void render_qr_quiet_zone(int x, int y, int size, int border_size);
+
+ /**
+  * Remove the hardware quiet zone and restore the black backdrop
+  */
+ void render_qr_quiet_zone_hide(void);
  
  /**
   * Renders a cryptocurrency QR code
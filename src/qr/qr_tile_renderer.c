@@ -0,0 +1,428 @@
+/**
+ * @file qr_tile_renderer.c
+ * @brief Tile-mode QR renderer using an 8x8 tile background
+ *
+ * Instead of plotting every pixel of every module in Mode 3, the QR symbol
+ * is drawn on a regular Mode 0 background (BG2). The renderer builds the
+ * small set of 8x8 tiles the symbol needs and then only writes screen-block
+ * map entries. Positioning is done with the BG scroll registers, so the map
+ * always starts at tile (0,0) and moving the code costs two register writes.
+ *
+ * Tile sets:
+ * - Scale 4 and 8: a tile covers a 2x2 or 1x1 block of modules, so the full
+ *   set of patterns (16 or 2 tiles) is precomputed once and reused.
+ * - Other scales: tiles are built on demand and de-duplicated through a
+ *   small hash dictionary, which typically yields a few dozen unique tiles.
+ *
+ * The tile set is shared: qr_tile_reset() and qr_tile_emit_map() let other
+ * renderers (the protection atlas) place several maps on the same tiles.
+ *
+ * The layer coexists with the TTE text layer (BG0, CBB 0, SBB 30) and the
+ * menu background (BG1, CBB 1, SBB 28/29). Tile 0 is left transparent so
+ * everything outside the symbol shows the layers below.
+ *
+ * @author Claude
+ * @date October 2026
+ * @version 1.0.0
+ */
+
+ #include <tonc.h>
+ #include <string.h>
+ #include "qr_system.h"
+ #include "qr_debug.h"
+ #include "display_compositor.h"
+
+ // Palette indices used inside QR tiles (0 stays transparent)
+ #define QR_TILE_CLR_WHITE   1
+ #define QR_TILE_CLR_BLACK   2
+
+ // Dictionary hash table size (power of two, larger than QR_TILE_MAX_TILES)
+ #define QR_TILE_HASH_SIZE   512
+ #define QR_TILE_HASH_EMPTY  0xFFFF
+
+ /**
+  * Renderer state
+  * Remembers what is currently on the QR layer so unchanged frames
+  * only touch the scroll registers.
+  */
+ typedef struct {
+     int fixed_scale;            // Scale of the precomputed tile set in VRAM (0 = none)
+     int tile_count;             // Tiles used in the char block (excluding tile 0)
+     u32 generation;             // Bumped whenever existing tile ids change meaning
+     u32 last_generation;        // Tile generation the current map was built with
+     int map_width;              // Width of last drawn map area in tiles
+     int map_height;             // Height of last drawn map area in tiles
+     const u8 *last_data;        // Module data of last drawn symbol
+     int last_size;              // Size of last drawn symbol
+     int last_scale;             // Scale of last drawn symbol
+     u32 last_checksum;          // Checksum of last drawn module data
+ } QrTileRenderer;
+
+ static QrTileRenderer s_tiles = {0};
+
+ // Dictionary for on-demand tiles: pixel mask -> tile id
+ static u64 s_tile_keys[QR_TILE_MAX_TILES];
+ static u16 s_tile_hash[QR_TILE_HASH_SIZE];
+
+ /**
+  * @brief Get module color, padding outside the symbol with white
+  *
+  * Padding up to the tile edge with white extends the quiet zone instead
+  * of leaving a ragged edge.
+  */
+ static inline int qr_tile_module(const QrState *qr, int mx, int my) {
+     if (mx >= qr->size || my >= qr->size) return 0;
+     return qr->data[my * qr->size + mx] & 1;
+ }
+
+ /**
+  * @brief Expand a 64-bit pixel mask (bit set = black) into a 4bpp tile
+  */
+ static void qr_tile_expand(TILE *dst, u64 mask) {
+     for (int row = 0; row < 8; row++) {
+         u32 bits = (u32)(mask >> (row * 8)) & 0xFF;
+         u32 word = 0;
+         for (int col = 0; col < 8; col++) {
+             word |= ((bits >> col) & 1 ? QR_TILE_CLR_BLACK : QR_TILE_CLR_WHITE) << (col * 4);
+         }
+         dst->data[row] = word;
+     }
+ }
+
+ /**
+  * @brief Set up palette and tile 0
+  */
+ static void qr_tile_setup_layer(void) {
+     pal_bg_bank[QR_TILE_PALETTE_BANK][QR_TILE_CLR_WHITE] = CLR_WHITE;
+     pal_bg_bank[QR_TILE_PALETTE_BANK][QR_TILE_CLR_BLACK] = CLR_BLACK;
+
+     // Transparent tile used for everything outside the symbol
+     memset32(&tile_mem[QR_TILE_CHAR_BLOCK][0], 0, sizeof(TILE) / 4);
+ }
+
+ /**
+  * @brief Upload the precomputed tile set for scales that divide a tile
+  *
+  * At scale 4 a tile holds 2x2 modules (16 patterns), at scale 8 a single
+  * module (2 patterns). Pattern bit i corresponds to module (i % n, i / n).
+  * Tile id for a pattern is 1 + pattern.
+  *
+  * @param scale Module scale (4 or 8)
+  */
+ static void qr_tile_build_fixed(int scale) {
+     if (s_tiles.fixed_scale == scale) return;
+
+     int n = 8 / scale;
+     int patterns = 1 << (n * n);
+     TILE tile;
+
+     for (int p = 0; p < patterns; p++) {
+         for (int row = 0; row < 8; row++) {
+             u32 word = 0;
+             for (int col = 0; col < 8; col++) {
+                 int bit = (row / scale) * n + (col / scale);
+                 word |= ((p >> bit) & 1 ? QR_TILE_CLR_BLACK : QR_TILE_CLR_WHITE) << (col * 4);
+             }
+             tile.data[row] = word;
+         }
+         memcpy32(&tile_mem[QR_TILE_CHAR_BLOCK][1 + p], &tile, sizeof(TILE) / 4);
+     }
+
+     s_tiles.fixed_scale = scale;
+     s_tiles.tile_count = patterns;
+     LOG_INFO(MODULE_RENDER, "QR fixed tile set uploaded", patterns);
+ }
+
+ /**
+  * @brief Build the pixel mask of one 8x8 screen tile of the symbol
+  */
+ static u64 qr_tile_mask(const QrState *qr, int tx, int ty, int scale) {
+     u64 mask = 0;
+     for (int row = 0; row < 8; row++) {
+         int my = (ty * 8 + row) / scale;
+         u32 bits = 0;
+         for (int col = 0; col < 8; col++) {
+             bits |= qr_tile_module(qr, (tx * 8 + col) / scale, my) << col;
+         }
+         mask |= (u64)bits << (row * 8);
+     }
+     return mask;
+ }
+
+ /**
+  * @brief Look up a tile in the dictionary, uploading it if new
+  * @return Tile id, or -1 if the char block is exhausted
+  */
+ static int qr_tile_lookup(u64 mask) {
+     u32 h = (u32)(mask ^ (mask >> 29) ^ (mask >> 47)) * 0x9E3779B1u;
+     u32 slot = h >> (32 - 9);
+
+     while (s_tile_hash[slot] != QR_TILE_HASH_EMPTY) {
+         int id = s_tile_hash[slot];
+         if (s_tile_keys[id] == mask) return id + 1;
+         slot = (slot + 1) & (QR_TILE_HASH_SIZE - 1);
+     }
+
+     int id = s_tiles.tile_count;
+     if (id >= QR_TILE_MAX_TILES) return -1;
+
+     s_tile_keys[id] = mask;
+     s_tile_hash[slot] = id;
+     s_tiles.tile_count++;
+
+     TILE tile;
+     qr_tile_expand(&tile, mask);
+     memcpy32(&tile_mem[QR_TILE_CHAR_BLOCK][id + 1], &tile, sizeof(TILE) / 4);
+     return id + 1;
+ }
+
+ /**
+  * @brief Clear the map area used by the previously drawn symbol
+  */
+ static void qr_tile_clear_map(void) {
+     SCR_ENTRY *map = se_mem[QR_TILE_SCREEN_BLOCK];
+     for (int ty = 0; ty < s_tiles.map_height; ty++) {
+         for (int tx = 0; tx < s_tiles.map_width; tx++) {
+             map[ty * 32 + tx] = 0;
+         }
+     }
+     s_tiles.map_width = 0;
+     s_tiles.map_height = 0;
+ }
+
+ /**
+  * @brief Prepare the shared tile set for a scale
+  *
+  * Scales 4 and 8 keep their precomputed set across calls. Any other
+  * scale starts an empty on-demand dictionary. Maps built before a
+  * reset that changed tiles are stale; see qr_tile_generation().
+  *
+  * @param scale Module scale the following maps will use
+  */
+ void qr_tile_reset(int scale) {
+     qr_tile_setup_layer();
+
+     if (scale == 4 || scale == 8) {
+         if (s_tiles.fixed_scale != scale) {
+             qr_tile_build_fixed(scale);
+             s_tiles.generation++;
+         }
+         return;
+     }
+
+     s_tiles.fixed_scale = 0;
+     s_tiles.tile_count = 0;
+     memset(s_tile_hash, 0xFF, sizeof(s_tile_hash));
+     s_tiles.generation++;
+ }
+
+ /**
+  * @brief Emit the map for one symbol using the shared tile set
+  *
+  * Tiles missing from the dictionary are uploaded on the way. Passing a
+  * NULL map only registers the tiles, which lets callers learn the final
+  * tile count before choosing where maps go.
+  *
+  * @param qr QR code state
+  * @param scale Module scale (must match the last qr_tile_reset())
+  * @param map Screen block to write, or NULL
+  * @return Map side length in tiles, or -1 if the dictionary is full
+  */
+ int qr_tile_emit_map(const QrState *qr, int scale, SCR_ENTRY *map) {
+     int map_size = (qr->size * scale + 7) / 8;
+     SCR_ENTRY pal = SE_PALBANK(QR_TILE_PALETTE_BANK);
+
+     for (int ty = 0; ty < map_size; ty++) {
+         for (int tx = 0; tx < map_size; tx++) {
+             int id;
+
+             if (s_tiles.fixed_scale == scale) {
+                 // Precomputed set: tile id is 1 + module pattern
+                 int n = 8 / scale;
+                 int pattern = 0;
+                 for (int i = 0; i < n * n; i++) {
+                     pattern |= qr_tile_module(qr, tx * n + (i % n), ty * n + (i / n)) << i;
+                 }
+                 id = 1 + pattern;
+             } else {
+                 id = qr_tile_lookup(qr_tile_mask(qr, tx, ty, scale));
+                 if (id < 0) {
+                     LOG_ERROR(MODULE_RENDER, "QR tile dictionary full", s_tiles.tile_count);
+                     return -1;
+                 }
+             }
+
+             if (map) {
+                 map[ty * 32 + tx] = pal | id;
+             }
+         }
+     }
+
+     return map_size;
+ }
+
+ /**
+  * @brief Number of tiles in use in the QR char block (excluding tile 0)
+  */
+ int qr_tile_count(void) {
+     return s_tiles.tile_count;
+ }
+
+ /**
+  * @brief Current tile set generation
+  *
+  * Changes whenever tile ids are reassigned, so callers holding maps
+  * can tell when they must rebuild them.
+  */
+ u32 qr_tile_generation(void) {
+     return s_tiles.generation;
+ }
+
+ /**
+  * @brief Claim the QR char block and maps for the tile layer
+  *
+  * The tile set and every map built on it share one owner, so a bitmap
+  * screen or any other owner overwriting part of them bumps the
+  * generation and all users rebuild.
+  *
+  * @param map_blocks Additional screen blocks holding QR maps
+  */
+ void qr_tile_claim_vram(u32 map_blocks) {
+     u32 blocks = DISPLAY_CBB_BLOCKS(QR_TILE_CHAR_BLOCK) | BIT(QR_TILE_SCREEN_BLOCK) | map_blocks;
+
+     if (!display_claim(DISPLAY_OWNER_QR_TILES, blocks)) {
+         render_qr_tile_invalidate();
+     }
+ }
+
+ /**
+  * @brief Renders a QR code on the tiled QR background
+  *
+  * The symbol is only rebuilt when its data, size or scale changed since
+  * the previous call; otherwise only the scroll position is updated.
+  *
+  * @param qr_state QR code state
+  * @param x X position on screen
+  * @param y Y position on screen
+  * @param scale Scale factor
+  * @return Success status
+  */
+ bool render_qr_tile_based(QrState *qr_state, int x, int y, int scale) {
+     if (!qr_state || !qr_state->data) {
+         LOG_ERROR(MODULE_RENDER, "Invalid QR state for tile rendering", 0);
+         return false;
+     }
+
+     int qr_size = qr_state->size;
+     int screen_size = qr_size * scale;
+
+     if (scale < 1 || x < 0 || y < 0 ||
+         x + screen_size > SCREEN_WIDTH ||
+         y + screen_size > SCREEN_HEIGHT) {
+         LOG_ERROR(MODULE_RENDER, "QR code won't fit on screen", qr_size);
+         return false;
+     }
+
+     qr_tile_claim_vram(0);
+
+     u32 checksum = qr_matrix_checksum(qr_state);
+
+     bool unchanged = (s_tiles.last_data == qr_state->data &&
+                       s_tiles.last_size == qr_size &&
+                       s_tiles.last_scale == scale &&
+                       s_tiles.last_checksum == checksum &&
+                       s_tiles.last_generation == s_tiles.generation);
+
+     if (!unchanged) {
+         qr_tile_clear_map();
+         qr_tile_reset(scale);
+
+         int map_size = qr_tile_emit_map(qr_state, scale, se_mem[QR_TILE_SCREEN_BLOCK]);
+         if (map_size < 0) {
+             s_tiles.last_data = NULL;
+             return false;
+         }
+
+         s_tiles.map_width = map_size;
+         s_tiles.map_height = map_size;
+         s_tiles.last_data = qr_state->data;
+         s_tiles.last_size = qr_size;
+         s_tiles.last_scale = scale;
+         s_tiles.last_checksum = checksum;
+         s_tiles.last_generation = s_tiles.generation;
+
+         LOG_INFO(MODULE_RENDER, "QR tiles rendered", s_tiles.tile_count);
+     }
+
+     // BG2 may have been left in affine mode or on another map
+     display_set_bg(2, BG_CBB(QR_TILE_CHAR_BLOCK) | BG_SBB(QR_TILE_SCREEN_BLOCK) |
+                       BG_4BPP | BG_REG_32x32 | BG_PRIO(0));
+
+     // Position via scrolling: map pixel (0,0) lands on screen (x,y)
+     REG_BG2HOFS = (u16)(-x);
+     REG_BG2VOFS = (u16)(-y);
+     display_set_mode(DCNT_MODE0);
+     display_enable(DCNT_BG2);
+
+     return true;
+ }
+
+ /**
+  * @brief Hide the tiled QR layer
+  *
+  * Leaves tiles and map in VRAM, so showing the same symbol again only
+  * needs the layer to be re-enabled.
+  */
+ void render_qr_tile_hide(void) {
+     display_disable(DCNT_BG2);
+ }
+
+ /**
+  * @brief Force the next tile-based render to rebuild the symbol
+  *
+  * Call after other code has reused the QR char or screen block.
+  */
+ void render_qr_tile_invalidate(void) {
+     // Other users may have left entries anywhere in the map
+     s_tiles.last_data = NULL;
+     s_tiles.map_width = 32;
+     s_tiles.map_height = 32;
+     s_tiles.fixed_scale = 0;
+     s_tiles.generation++;
+ }
+
+ /**
+  * @brief Time building the tiled symbol and redrawing it unchanged
+  *
+  * The build writes tiles and map from scratch, as after another screen
+  * took the VRAM; the redraw is what every later frame costs.
+  *
+  * @param qr_state QR code state
+  * @param x X position on screen
+  * @param y Y position on screen
+  * @param scale Scale factor
+  * @param build_cycles Output: cycles for the build
+  * @param redraw_cycles Output: cycles for the redraw
+  * @return Success status
+  */
+ bool render_qr_tile_benchmark(QrState *qr_state, int x, int y, int scale,
+                               u32 *build_cycles, u32 *redraw_cycles) {
+     if (!build_cycles || !redraw_cycles) return false;
+
+     render_qr_tile_invalidate();
+
+     profile_start();
+     bool ok = render_qr_tile_based(qr_state, x, y, scale);
+     *build_cycles = profile_stop();
+
+     profile_start();
+     ok = ok && render_qr_tile_based(qr_state, x, y, scale);
+     *redraw_cycles = profile_stop();
+
+     render_qr_tile_hide();
+
+     LOG_INFO(MODULE_OPTIMIZE, "QR tile build cycles", *build_cycles);
+     LOG_INFO(MODULE_OPTIMIZE, "QR tile redraw cycles", *redraw_cycles);
+     LOG_INFO(MODULE_OPTIMIZE, "QR tiles used", s_tiles.tile_count);
+     return ok;
+ }
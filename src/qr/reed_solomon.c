@@ -18,10 +18,11 @@
  #include "reed_solomon.h"
  #include "qr_system.h"
  #include "qr_debug.h"
+ #include "gba_sections.h"
 
- // Galois field arithmetic tables for GF(2^8)
- static u8 rs_exp_table[256];  // Exponentiation table (alpha^i)
- static u8 rs_log_table[256];  // Logarithm table (log_alpha(i))
+ // Galois field arithmetic tables for GF(2^8), in IWRAM for the ECC loop
+ IWRAM_BSS static u8 rs_exp_table[256];  // Exponentiation table (alpha^i)
+ IWRAM_BSS static u8 rs_log_table[256];  // Logarithm table (log_alpha(i))
  
  // Generator polynomials for different error correction levels
  static u8 rs_generator_poly[RS_MAX_POLY][RS_MAX_POLY];
@@ -30,7 +31,7 @@
  // Forward declarations for internal functions
  static void rs_init_tables(void);
  static void rs_init_generator_polynomials(void);
- static u8 rs_gf_mul(u8 a, u8 b);
+ static inline u8 rs_gf_mul(u8 a, u8 b);
  static u8 rs_gf_inv(u8 a);
  static void rs_gf_poly_mul(const u8 *p, int p_deg, const u8 *q, int q_deg, u8 *result);
  
@@ -109,7 +110,7 @@
   * @param b Second element
   * @return a * b in GF(2^8)
   */
- static u8 rs_gf_mul(u8 a, u8 b) {
+ static inline u8 rs_gf_mul(u8 a, u8 b) {
      if (a == 0 || b == 0) return 0;
      
      // Use the logarithm tables to multiply: a*b = α^(log(a) + log(b))
@@ -164,8 +165,10 @@
   * @param ecc Output error correction codewords buffer
   * @param ecc_length Number of error correction codewords to generate
   * @return true if successful, false otherwise
+  * 
+  * Runs from IWRAM as ARM code: the division loop is the encoder's hottest path.
   */
- bool rs_compute_ecc(const u8 *data, int data_length, u8 *ecc, int ecc_length) {
+ IWRAM_CODE bool rs_compute_ecc(const u8 *data, int data_length, u8 *ecc, int ecc_length) {
      // Validate parameters
      if (!data || !ecc || data_length <= 0 || ecc_length <= 0 || ecc_length >= RS_MAX_POLY) {
          LOG_ERROR(MODULE_QR, "Invalid parameters for RS ECC", ecc_length);
@@ -0,0 +1,352 @@
+/**
+ * @file wallet_address.c
+ * @brief Packed form of cryptocurrency addresses
+ *
+ * The packer does not validate checksums: a mistyped address packs and
+ * expands just as well, it only has to round-trip.
+ *
+ * @author Claude
+ * @date October 2026
+ * @version 1.0.0
+ */
+
+ #include <tonc.h>
+ #include <string.h>
+ #include "wallet_address.h"
+
+ #define ADDRESS_TEXT_MAX    (MAX_ADDRESS_LENGTH - 1)
+
+ static const char BASE58_ALPHABET[] =
+     "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+
+ static const char BECH32_CHARSET[] = "qpzry9x8gf2tvdw0s3jn54khce6mua7l";
+
+ static int hex_value(char c) {
+     if (c >= '0' && c <= '9') return c - '0';
+     if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+     if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+     return -1;
+ }
+
+ static int base58_value(char c) {
+     const char *p = c ? strchr(BASE58_ALPHABET, c) : NULL;
+     return p ? p - BASE58_ALPHABET : -1;
+ }
+
+ static int bech32_value(char c) {
+     if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+     const char *p = c ? strchr(BECH32_CHARSET, c) : NULL;
+     return p ? p - BECH32_CHARSET : -1;
+ }
+
+ /* ---------------------------------------------------------------------------
+  * Hex
+  * ------------------------------------------------------------------------- */
+
+ static u32 hex_pack(const char *text, u32 len, u8 *out) {
+     u8 form = WALLET_ADDRESS_HEX;
+     bool lower = false, upper = false;
+
+     if (len >= 2 && text[0] == '0' && text[1] == 'x') {
+         form |= WALLET_ADDRESS_PREFIX_0X;
+         text += 2;
+         len -= 2;
+     }
+     if (len == 0 || (len & 1)) return 0;
+
+     u32 bytes = len / 2;
+     u8 *data = out + 2;
+     u8 *mask = data + bytes;
+     memset(mask, 0, (len + 7) / 8);
+
+     for (u32 i = 0; i < len; i++) {
+         int v = hex_value(text[i]);
+         if (v < 0) return 0;
+
+         if (text[i] >= 'a') lower = true;
+         else if (text[i] >= 'A') {
+             upper = true;
+             mask[i / 8] |= BIT(i % 8);
+         }
+
+         if (i & 1) data[i / 2] |= v;
+         else data[i / 2] = v << 4;
+     }
+
+     u32 size = 2 + bytes;
+     if (lower && upper) {
+         form |= WALLET_ADDRESS_MIXED;
+         size += (len + 7) / 8;
+     } else if (upper) {
+         form |= WALLET_ADDRESS_UPPER;
+     }
+
+     out[0] = form;
+     out[1] = bytes;
+     return size;
+ }
+
+ static u32 hex_unpack(const u8 *in, u32 len, char *text) {
+     u8 form = in[0];
+     u32 bytes = in[1];
+     u32 digits = bytes * 2;
+     u32 prefix = (form & WALLET_ADDRESS_PREFIX_0X) ? 2 : 0;
+     u32 size = 2 + bytes + ((form & WALLET_ADDRESS_MIXED) ? (digits + 7) / 8 : 0);
+
+     if (size > len || prefix + digits > ADDRESS_TEXT_MAX) return 0;
+
+     const u8 *data = in + 2;
+     const u8 *mask = data + bytes;
+     static const char LOWER[] = "0123456789abcdef";
+     static const char UPPER[] = "0123456789ABCDEF";
+
+     if (prefix) {
+         *text++ = '0';
+         *text++ = 'x';
+     }
+     for (u32 i = 0; i < digits; i++) {
+         u8 v = (i & 1) ? data[i / 2] & 0x0F : data[i / 2] >> 4;
+         bool up = (form & WALLET_ADDRESS_MIXED) ? (mask[i / 8] >> (i % 8)) & 1 :
+                   (form & WALLET_ADDRESS_UPPER) != 0;
+         *text++ = up ? UPPER[v] : LOWER[v];
+     }
+     *text = '\0';
+     return size;
+ }
+
+ /* ---------------------------------------------------------------------------
+  * Base58
+  * ------------------------------------------------------------------------- */
+
+ static u32 base58_pack(const char *text, u32 len, u8 *out) {
+     u8 num[ADDRESS_TEXT_MAX];           // Big-endian, least significant byte last
+     u32 num_len = 0;
+     u32 zeros = 0;
+
+     if (len == 0) return 0;
+     while (zeros < len && text[zeros] == '1') zeros++;
+
+     for (u32 i = zeros; i < len; i++) {
+         int v = base58_value(text[i]);
+         if (v < 0) return 0;
+
+         u32 carry = v;
+         for (u32 j = 0; j < num_len; j++) {
+             carry += num[ADDRESS_TEXT_MAX - 1 - j] * 58;
+             num[ADDRESS_TEXT_MAX - 1 - j] = carry;
+             carry >>= 8;
+         }
+         while (carry) {
+             num[ADDRESS_TEXT_MAX - 1 - num_len++] = carry;
+             carry >>= 8;
+         }
+     }
+
+     out[0] = WALLET_ADDRESS_BASE58;
+     out[1] = zeros + num_len;
+     memset(out + 2, 0, zeros);
+     memcpy(out + 2 + zeros, num + ADDRESS_TEXT_MAX - num_len, num_len);
+     return 2 + zeros + num_len;
+ }
+
+ static u32 base58_unpack(const u8 *in, u32 len, char *text) {
+     u32 bytes = in[1];
+     u8 digits[ADDRESS_TEXT_MAX + 1];    // Base 58, least significant first
+     u32 count = 0;
+     u32 zeros = 0;
+
+     if (2 + bytes > len) return 0;
+
+     const u8 *data = in + 2;
+     while (zeros < bytes && data[zeros] == 0) zeros++;
+
+     for (u32 i = zeros; i < bytes; i++) {
+         u32 carry = data[i];
+         for (u32 j = 0; j < count; j++) {
+             carry += digits[j] << 8;
+             digits[j] = carry % 58;
+             carry /= 58;
+         }
+         while (carry) {
+             if (count == sizeof(digits)) return 0;
+             digits[count++] = carry % 58;
+             carry /= 58;
+         }
+     }
+
+     if (zeros + count > ADDRESS_TEXT_MAX) return 0;
+
+     memset(text, '1', zeros);
+     for (u32 i = 0; i < count; i++) {
+         text[zeros + i] = BASE58_ALPHABET[digits[count - 1 - i]];
+     }
+     text[zeros + count] = '\0';
+     return 2 + bytes;
+ }
+
+ /* ---------------------------------------------------------------------------
+  * Bech32
+  * ------------------------------------------------------------------------- */
+
+ static u32 bech32_pack(const char *text, u32 len, u8 *out) {
+     const char *sep = strrchr(text, '1');
+     bool lower = false, upper = false;
+
+     if (!sep || sep == text) return 0;
+
+     u32 prefix = sep - text;
+     u32 chars = len - prefix - 1;
+     if (chars < 6) return 0;
+
+     for (u32 i = 0; i < len; i++) {
+         char c = text[i];
+         if (c < 33 || c > 126) return 0;
+         if (c >= 'a' && c <= 'z') lower = true;
+         if (c >= 'A' && c <= 'Z') upper = true;
+     }
+     if (lower && upper) return 0;
+
+     out[0] = WALLET_ADDRESS_BECH32 | (upper ? WALLET_ADDRESS_UPPER : 0);
+     out[1] = prefix;
+     for (u32 i = 0; i < prefix; i++) {
+         char c = text[i];
+         out[2 + i] = (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+     }
+
+     u8 *p = out + 2 + prefix;
+     *p++ = chars;
+     memset(p, 0, (chars * 5 + 7) / 8);
+
+     for (u32 i = 0; i < chars; i++) {
+         int v = bech32_value(sep[1 + i]);
+         if (v < 0) return 0;
+
+         // 5 bits, most significant first, may straddle two bytes
+         u32 bit = i * 5;
+         u32 pair = (v << 11) >> (bit % 8);
+         p[bit / 8] |= pair >> 8;
+         if ((bit % 8) > 3) p[bit / 8 + 1] |= pair;
+     }
+
+     return 3 + prefix + (chars * 5 + 7) / 8;
+ }
+
+ static u32 bech32_unpack(const u8 *in, u32 len, char *text) {
+     bool upper = (in[0] & WALLET_ADDRESS_UPPER) != 0;
+     u32 prefix = in[1];
+
+     if (3 + prefix > len) return 0;
+
+     const u8 *p = in + 2 + prefix;
+     u32 chars = *p++;
+     u32 size = 3 + prefix + (chars * 5 + 7) / 8;
+     if (size > len || prefix + 1 + chars > ADDRESS_TEXT_MAX) return 0;
+
+     for (u32 i = 0; i < prefix; i++) {
+         char c = in[2 + i];
+         *text++ = (upper && c >= 'a' && c <= 'z') ? c - ('a' - 'A') : c;
+     }
+     *text++ = '1';
+
+     for (u32 i = 0; i < chars; i++) {
+         u32 bit = i * 5;
+         u32 pair = (p[bit / 8] << 8) | ((bit / 8 + 1 < (chars * 5 + 7) / 8) ? p[bit / 8 + 1] : 0);
+         char c = BECH32_CHARSET[(pair >> (11 - bit % 8)) & 0x1F];
+         *text++ = (upper && c >= 'a') ? c - ('a' - 'A') : c;
+     }
+     *text = '\0';
+     return size;
+ }
+
+ /* ---------------------------------------------------------------------------
+  * Interface
+  * ------------------------------------------------------------------------- */
+
+ static u32 text_pack(const char *text, u32 len, u8 *out) {
+     out[0] = WALLET_ADDRESS_TEXT;
+     out[1] = len;
+     memcpy(out + 2, text, len);
+     return 2 + len;
+ }
+
+ static u32 text_unpack(const u8 *in, u32 len, char *text) {
+     u32 n = in[1];
+
+     if (n > ADDRESS_TEXT_MAX || 2 + n > len) return 0;
+
+     memcpy(text, in + 2, n);
+     text[n] = '\0';
+     return 2 + n;
+ }
+
+ /**
+  * @brief Expand a packed address
+  */
+ u32 wallet_address_unpack(const u8 *in, u32 len, char *text) {
+     if (len < 2) return 0;
+
+     switch (in[0] & WALLET_ADDRESS_FORM_MASK) {
+     case WALLET_ADDRESS_HEX:    return hex_unpack(in, len, text);
+     case WALLET_ADDRESS_BASE58: return base58_unpack(in, len, text);
+     case WALLET_ADDRESS_BECH32: return bech32_unpack(in, len, text);
+     default:                    return text_unpack(in, len, text);
+     }
+ }
+
+ /**
+  * @brief Size of a packed address without expanding it
+  */
+ u32 wallet_address_packed_size(const u8 *in, u32 len) {
+     u32 size;
+
+     if (len < 2) return 0;
+
+     switch (in[0] & WALLET_ADDRESS_FORM_MASK) {
+     case WALLET_ADDRESS_HEX:
+         size = 2 + in[1] + ((in[0] & WALLET_ADDRESS_MIXED) ? (in[1] * 2 + 7) / 8 : 0);
+         break;
+     case WALLET_ADDRESS_BECH32:
+         if (3 + in[1] > len) return 0;
+         size = 3 + in[1] + (in[2 + in[1]] * 5 + 7) / 8;
+         break;
+     default:
+         size = 2 + in[1];
+         break;
+     }
+
+     return size <= len ? size : 0;
+ }
+
+ /**
+  * @brief Pack an address into the smallest form that expands back exactly
+  */
+ u32 wallet_address_pack(const char *address, u8 *out) {
+     char text[MAX_ADDRESS_LENGTH];
+     u32 len = strnlen(address, ADDRESS_TEXT_MAX);
+
+     // The packers scan for separators, so work on a terminated copy
+     memcpy(text, address, len);
+     text[len] = '\0';
+
+     u32 best = text_pack(text, len, out);
+
+     static u32 (*const PACKERS[])(const char *, u32, u8 *) = {
+         hex_pack, base58_pack, bech32_pack
+     };
+
+     for (u32 i = 0; i < sizeof(PACKERS) / sizeof(PACKERS[0]); i++) {
+         u8 packed[WALLET_ADDRESS_PACKED_MAX + 8];
+         char check[MAX_ADDRESS_LENGTH];
+
+         u32 size = PACKERS[i](text, len, packed);
+         if (!size || size >= best) continue;
+
+         if (wallet_address_unpack(packed, size, check) == size &&
+             memcmp(check, text, len) == 0 && check[len] == '\0') {
+             memcpy(out, packed, size);
+             best = size;
+         }
+     }
+
+     return best;
+ }
@@ -0,0 +1,81 @@
+/**
+ * @file wallet_address.h
+ * @brief Packed form of cryptocurrency addresses
+ *
+ * Addresses are text in a restricted alphabet, so most of their bytes
+ * carry a few bits each. The packer recognises the common encodings and
+ * stores what they encode instead:
+ *   hex       "0x" and hex digits (Ethereum): the raw bytes, plus one bit
+ *             per digit when the letters mix case (EIP-55 checksums)
+ *   base58    Bitcoin, Litecoin and Dogecoin legacy addresses: the
+ *             decoded bytes, leading '1's as zero bytes
+ *   bech32    "bc1...", "ltc1...": the human-readable part as text and
+ *             the data characters at 5 bits each
+ * Anything else is kept as text. Every packed form is expanded again and
+ * compared before it is used, so unpacking always gives back the exact
+ * string that was packed.
+ *
+ * Packed layout: form u8, then
+ *   text      length u8, characters
+ *   hex       byte count u8, bytes, case mask (mixed case only)
+ *   base58    byte count u8, bytes
+ *   bech32    prefix length u8, prefix, character count u8, 5-bit groups
+ *
+ * @author Claude
+ * @date October 2026
+ * @version 1.0.0
+ */
+
+ #ifndef WALLET_ADDRESS_H
+ #define WALLET_ADDRESS_H
+
+ #include <tonc.h>
+ #include "wallet_system.h"
+
+ /**
+  * Forms (low two bits of the form byte)
+  */
+ #define WALLET_ADDRESS_TEXT         0
+ #define WALLET_ADDRESS_HEX          1
+ #define WALLET_ADDRESS_BASE58       2
+ #define WALLET_ADDRESS_BECH32       3
+ #define WALLET_ADDRESS_FORM_MASK    0x03
+
+ /**
+  * Form flags
+  */
+ #define WALLET_ADDRESS_PREFIX_0X    0x04        // Hex: "0x" in front of the digits
+ #define WALLET_ADDRESS_UPPER        0x08        // Hex, bech32: letters in upper case
+ #define WALLET_ADDRESS_MIXED        0x10        // Hex: case mask follows the bytes
+
+ /**
+  * Largest packed address (text form of the longest address)
+  */
+ #define WALLET_ADDRESS_PACKED_MAX   (2 + MAX_ADDRESS_LENGTH - 1)
+
+ /**
+  * Pack an address
+  * @param address Address; characters past MAX_ADDRESS_LENGTH - 1 are ignored
+  * @param out Output of at least WALLET_ADDRESS_PACKED_MAX bytes
+  * @return Bytes written (the smallest form that expands back exactly)
+  */
+ u32 wallet_address_pack(const char *address, u8 *out);
+
+ /**
+  * Expand a packed address
+  * @param in Packed bytes
+  * @param len Bytes available
+  * @param text Output of MAX_ADDRESS_LENGTH characters (NUL-terminated)
+  * @return Bytes consumed, or 0 if the packed form is damaged
+  */
+ u32 wallet_address_unpack(const u8 *in, u32 len, char *text);
+
+ /**
+  * Size of a packed address without expanding it
+  * @param in Packed bytes
+  * @param len Bytes available
+  * @return Bytes it takes, or 0 if it runs past len or is damaged
+  */
+ u32 wallet_address_packed_size(const u8 *in, u32 len);
+
+ #endif // WALLET_ADDRESS_H
@@ -0,0 +1,811 @@
+/**
+ * @file wallet_log.c
+ * @brief Log-structured wallet store for flash save chips
+ *
+ * A save appends one record per changed entry and then the commit
+ * record; the commit record is written last, so a save cut short leaves
+ * only records newer than the last complete commit, which recovery
+ * ignores. Records are never rewritten in place: compaction copies live
+ * records unchanged (same sequence number) to the head before erasing
+ * their sector, so a copy interrupted at any point leaves either the
+ * original or an identical duplicate.
+ *
+ * Wear: erased sectors are taken least-worn first, and compaction picks
+ * the sector with the least live data, least-worn on a tie. Compaction
+ * normally runs from wallet_log_maintain() outside the save path; a
+ * save only compacts itself when the log is too full for it.
+ *
+ * @author Claude
+ * @date October 2026
+ * @version 1.0.0
+ */
+
+ #include <tonc.h>
+ #include <string.h>
+ #include "wallet_log.h"
+ #include "crc32.h"
+ #include "memory_system.h"
+ #include "qr_debug.h"
+
+ #define WALLET_LOG_USABLE           (FLASH_SECTOR_SIZE - WALLET_LOG_SECTOR_HEADER)
+ #define WALLET_LOG_LOC(sector, off) ((u32)(sector) * FLASH_SECTOR_SIZE + (off))
+ #define WALLET_LOG_SECTOR_OF(loc)   ((loc) / FLASH_SECTOR_SIZE)
+
+ // Background compaction skips sectors that would free less than this
+ #define WALLET_LOG_MIN_GARBAGE      (WALLET_LOG_USABLE / 4)
+
+ // RAM stand-in used by the benchmark; 32 KB fits in the shared scratch
+ #define WALLET_LOG_BENCH_SECTORS    8
+ #define WALLET_LOG_BENCH_HEAP       5120    // Benchmark book heap; fits the frame arena beside book and log
+ #define WALLET_LOG_BENCH_EDITS      1000
+
+ static inline void put_u16(u8 *p, u16 value) {
+     p[0] = value;
+     p[1] = value >> 8;
+ }
+
+ static inline void put_u32(u8 *p, u32 value) {
+     p[0] = value;
+     p[1] = value >> 8;
+     p[2] = value >> 16;
+     p[3] = value >> 24;
+ }
+
+ static inline u16 get_u16(const u8 *p) {
+     return p[0] | (p[1] << 8);
+ }
+
+ static inline u32 get_u32(const u8 *p) {
+     return p[0] | (p[1] << 8) | (p[2] << 16) | ((u32)p[3] << 24);
+ }
+
+ /**
+  * @brief Fill in the head and CRC of a record whose payload is in place
+  *
+  * @param record Buffer with the payload at WALLET_LOG_RECORD_HEAD
+  * @return Record size in bytes
+  */
+ static u32 wallet_log_seal(u8 *record, u8 type, u8 key, u32 sequence, u32 len) {
+     u32 size = WALLET_LOG_RECORD_HEAD + len;
+
+     put_u16(record, len);
+     record[2] = type;
+     record[3] = key;
+     put_u32(record + 4, sequence);
+     put_u32(record + size, crc32(record, size));
+
+     return size + 4;
+ }
+
+ /**
+  * @brief Erase a sector and write its header
+  *
+  * @param erase_count Erases the sector had before this one
+  */
+ static bool wallet_log_format(WalletLog *log, int s, u32 erase_count) {
+     WalletLogSector *sector = &log->sectors[s];
+     u8 header[WALLET_LOG_SECTOR_HEADER];
+
+     sector->erase_count = erase_count + 1;
+     sector->end = WALLET_LOG_SECTOR_HEADER;
+     sector->live = 0;
+     sector->state = WALLET_LOG_SECTOR_BAD;
+
+     put_u32(header, WALLET_LOG_MAGIC);
+     put_u32(header + 4, sector->erase_count);
+     put_u32(header + 8, crc32(header, 8));
+
+     if (!flash_erase_sector(log->dev, s) ||
+         !flash_program(log->dev, WALLET_LOG_LOC(s, 0), header, sizeof(header))) {
+         LOG_ERROR(MODULE_WALLET, "Flash sector format failed", s);
+         return false;
+     }
+
+     sector->state = WALLET_LOG_SECTOR_FREE;
+     return true;
+ }
+
+ static int wallet_log_free_count(const WalletLog *log) {
+     int count = 0;
+
+     for (int s = 0; s < log->sector_count; s++) {
+         if (log->sectors[s].state == WALLET_LOG_SECTOR_FREE) count++;
+     }
+
+     return count;
+ }
+
+ /**
+  * @brief Least-worn erased sector, or -1
+  */
+ static int wallet_log_free_sector(const WalletLog *log) {
+     int best = -1;
+
+     for (int s = 0; s < log->sector_count; s++) {
+         const WalletLogSector *sector = &log->sectors[s];
+
+         if (sector->state == WALLET_LOG_SECTOR_FREE &&
+             (best < 0 || sector->erase_count < log->sectors[best].erase_count)) {
+             best = s;
+         }
+     }
+
+     return best;
+ }
+
+ /**
+  * @brief Append a complete record, moving to a new sector if it does not fit
+  *
+  * @param loc Output: device offset of the record
+  */
+ static bool wallet_log_write(WalletLog *log, const u8 *record, u32 size, u32 *loc) {
+     if (log->head < 0 || log->sectors[log->head].end + size > FLASH_SECTOR_SIZE) {
+         int s = wallet_log_free_sector(log);
+         if (s < 0) {
+             LOG_ERROR(MODULE_WALLET, "Flash log full", size);
+             return false;
+         }
+
+         log->sectors[s].state = WALLET_LOG_SECTOR_USED;
+         log->head = s;
+     }
+
+     WalletLogSector *head = &log->sectors[log->head];
+     *loc = WALLET_LOG_LOC(log->head, head->end);
+
+     if (!flash_program(log->dev, *loc, record, size)) {
+         // A record cut short cannot be written over; close the sector
+         head->end = FLASH_SECTOR_SIZE;
+         return false;
+     }
+
+     head->end += size;
+     return true;
+ }
+
+ /**
+  * @brief Recompute how many bytes of each sector the committed wallet uses
+  */
+ static void wallet_log_count_live(WalletLog *log) {
+     for (int s = 0; s < log->sector_count; s++) {
+         log->sectors[s].live = 0;
+     }
+     if (!log->committed) return;
+
+     log->sectors[WALLET_LOG_SECTOR_OF(log->commit_loc)].live += log->commit_len;
+     for (int i = 0; i < log->count; i++) {
+         u8 id = log->committed_ids[i];
+         log->sectors[WALLET_LOG_SECTOR_OF(log->entry_loc[id])].live += log->entry_len[id];
+     }
+ }
+
+ /**
+  * @brief Pick the sector that frees the most space for the least copying
+  *
+  * Ties go to the least-worn sector. The head is never picked.
+  *
+  * @param min_garbage Reclaimable bytes a sector needs to be considered
+  * @return Sector, or -1 if none qualifies
+  */
+ static int wallet_log_victim(const WalletLog *log, u32 min_garbage) {
+     int best = -1;
+
+     for (int s = 0; s < log->sector_count; s++) {
+         const WalletLogSector *sector = &log->sectors[s];
+
+         if (sector->state != WALLET_LOG_SECTOR_USED || s == log->head) continue;
+         if (sector->end - WALLET_LOG_SECTOR_HEADER - sector->live < min_garbage) continue;
+
+         if (best < 0 || sector->live < log->sectors[best].live ||
+             (sector->live == log->sectors[best].live &&
+              sector->erase_count < log->sectors[best].erase_count)) {
+             best = s;
+         }
+     }
+
+     return best;
+ }
+
+ /**
+  * @brief Copy a record to the head unchanged
+  */
+ static bool wallet_log_relocate(WalletLog *log, u32 *loc, u16 size) {
+     u8 record[WALLET_LOG_RECORD_MAX];
+     u32 new_loc;
+
+     flash_read(log->dev, *loc, record, size);
+     if (!wallet_log_write(log, record, size, &new_loc)) {
+         return false;
+     }
+
+     *loc = new_loc;
+     log->records_copied++;
+     return true;
+ }
+
+ /**
+  * @brief Copy a sector's live records to the head, then erase it
+  */
+ static bool wallet_log_compact(WalletLog *log, int victim) {
+     if (log->committed && WALLET_LOG_SECTOR_OF(log->commit_loc) == (u32)victim &&
+         !wallet_log_relocate(log, &log->commit_loc, log->commit_len)) {
+         return false;
+     }
+
+     for (int i = 0; i < log->count; i++) {
+         u8 id = log->committed_ids[i];
+
+         if (WALLET_LOG_SECTOR_OF(log->entry_loc[id]) == (u32)victim &&
+             !wallet_log_relocate(log, &log->entry_loc[id], log->entry_len[id])) {
+             return false;
+         }
+     }
+
+     bool ok = wallet_log_format(log, victim, log->sectors[victim].erase_count);
+     log->compactions++;
+     wallet_log_count_live(log);
+     return ok;
+ }
+
+ /**
+  * @brief Bytes that can surely be appended without touching the spare sector
+  *
+  * Records do not span sectors, so up to one record's worth at the end
+  * of every sector may go unused.
+  */
+ static u32 wallet_log_capacity(const WalletLog *log) {
+     u32 bytes = 0;
+     int free = wallet_log_free_count(log);
+
+     if (log->head >= 0) {
+         u32 left = FLASH_SECTOR_SIZE - log->sectors[log->head].end;
+         if (left > WALLET_LOG_RECORD_MAX) bytes += left - WALLET_LOG_RECORD_MAX;
+     }
+     if (free > 1) {
+         bytes += (free - 1) * (WALLET_LOG_USABLE - WALLET_LOG_RECORD_MAX);
+     }
+
+     return bytes;
+ }
+
+ /**
+  * @brief Compact until a save of the given size fits
+  *
+  * Every pass reclaims garbage, so this ends once none is left.
+  */
+ static bool wallet_log_make_room(WalletLog *log, u32 bytes) {
+     while (wallet_log_capacity(log) < bytes) {
+         int victim = wallet_log_victim(log, 1);
+
+         if (victim < 0 || !wallet_log_compact(log, victim)) {
+             LOG_ERROR(MODULE_WALLET, "Flash log cannot make room", bytes);
+             return false;
+         }
+     }
+
+     return true;
+ }
+
+ /**
+  * @brief Smallest id no current entry uses
+  */
+ static u8 wallet_log_new_id(const WalletLog *log) {
+     u32 used[BITSET_WORDS(WALLET_LOG_ENTRIES)];
+
+     bitset_clear_all(used, WALLET_LOG_ENTRIES);
+     for (int i = 0; i < log->working_count; i++) {
+         bitset_set(used, log->ids[i]);
+     }
+
+     u8 id = 0;
+     while (bitset_test(used, id)) id++;
+     return id;
+ }
+
+ /**
+  * @brief Mark an entry as changed
+  */
+ void wallet_log_entry_changed(WalletLog *log, int index) {
+     if (index < 0 || index >= WALLET_LOG_ENTRIES) return;
+
+     // New entries get an id nothing else in the wallet uses
+     while (log->working_count <= index) {
+         bitset_set(log->dirty, log->working_count);
+         log->ids[log->working_count] = wallet_log_new_id(log);
+         log->working_count++;
+     }
+
+     bitset_set(log->dirty, index);
+ }
+
+ /**
+  * @brief Record that an entry was removed
+  */
+ void wallet_log_entry_removed(WalletLog *log, int index) {
+     if (index < 0 || index >= log->working_count) return;
+
+     for (int i = index; i < log->working_count - 1; i++) {
+         log->ids[i] = log->ids[i + 1];
+     }
+     log->working_count--;
+
+     bitset_remove(log->dirty, WALLET_LOG_ENTRIES, index);
+     log->map_changed = true;
+ }
+
+ /**
+  * @brief Append the changed entries, then a commit record
+  */
+ bool wallet_log_commit(WalletLog *log, const WalletSystem *wallet, u32 *bytes_written) {
+     if (bytes_written) *bytes_written = 0;
+     if (!log->dev) return false;
+
+     int count = wallet->count;
+     if (count < 0) count = 0;
+     if (count > WALLET_LOG_ENTRIES) {
+         LOG_ERROR(MODULE_WALLET, "Too many entries for flash log", count);
+         return false;
+     }
+
+     // Entries the hooks did not see
+     if (count > log->working_count) {
+         wallet_log_entry_changed(log, count - 1);
+     } else if (count < log->working_count) {
+         log->working_count = count;
+         log->map_changed = true;
+     }
+
+     u8 flags = wallet->is_encrypted ? WALLET_SAVE_ENCRYPTED : 0;
+
+     if (log->committed && !bitset_any_first(log->dirty, count) && !log->map_changed &&
+         count == log->count && flags == log->flags &&
+         wallet->password_hash == log->password_hash) {
+         return true;
+     }
+
+     // The capacity already allows for sector ends, so exact sizes will do
+     u32 needed = WALLET_LOG_RECORD_OVERHEAD + WALLET_LOG_COMMIT_FIXED + count;
+     for (int i = 0; i < count; i++) {
+         if (bitset_test(log->dirty, i)) {
+             u32 len;
+             wallet_book_record(wallet, i, &len);
+             needed += len + WALLET_LOG_RECORD_OVERHEAD;
+         }
+     }
+     if (!wallet_log_make_room(log, needed)) {
+         return false;
+     }
+
+     u8 record[WALLET_LOG_RECORD_MAX];
+     u32 new_loc[WALLET_LOG_ENTRIES];
+     u16 new_len[WALLET_LOG_ENTRIES];
+     u32 written = 0;
+
+     for (int i = 0; i < count; i++) {
+         if (!bitset_test(log->dirty, i)) continue;
+
+         u32 len;
+         const u8 *packed = wallet_book_record(wallet, i, &len);
+         memcpy(record + WALLET_LOG_RECORD_HEAD, packed, len);
+         u32 size = wallet_log_seal(record, WALLET_LOG_ENTRY, log->ids[i], ++log->sequence, len);
+
+         if (!wallet_log_write(log, record, size, &new_loc[i])) {
+             return false;
+         }
+         new_len[i] = size;
+         written += size;
+     }
+
+     // The save exists once this record is complete
+     u8 *payload = record + WALLET_LOG_RECORD_HEAD;
+     payload[0] = flags;
+     payload[1] = count;
+     put_u16(payload + 2, wallet->password_hash);
+     memcpy(payload + WALLET_LOG_COMMIT_FIXED, log->ids, count);
+
+     u32 commit_loc;
+     u32 size = wallet_log_seal(record, WALLET_LOG_COMMIT, 0, ++log->sequence,
+                                WALLET_LOG_COMMIT_FIXED + count);
+     if (!wallet_log_write(log, record, size, &commit_loc)) {
+         return false;
+     }
+     written += size;
+
+     for (int i = 0; i < count; i++) {
+         if (!bitset_test(log->dirty, i)) continue;
+
+         log->entry_loc[log->ids[i]] = new_loc[i];
+         log->entry_len[log->ids[i]] = new_len[i];
+     }
+
+     log->committed = true;
+     log->commit_loc = commit_loc;
+     log->commit_len = size;
+     log->count = count;
+     log->flags = flags;
+     log->password_hash = wallet->password_hash;
+     memcpy(log->committed_ids, log->ids, sizeof(log->committed_ids));
+     bitset_clear_all(log->dirty, WALLET_LOG_ENTRIES);
+     log->map_changed = false;
+     wallet_log_count_live(log);
+
+     if (bytes_written) *bytes_written = written;
+     return true;
+ }
+
+ /**
+  * @brief Reclaim one sector if too few are erased
+  */
+ bool wallet_log_maintain(WalletLog *log) {
+     if (!log->dev || wallet_log_free_count(log) >= WALLET_LOG_FREE_TARGET) {
+         return false;
+     }
+
+     int victim = wallet_log_victim(log, WALLET_LOG_MIN_GARBAGE);
+     return victim >= 0 && wallet_log_compact(log, victim);
+ }
+
+ /**
+  * A commit record found by the recovery scan
+  */
+ typedef struct {
+     bool found;
+     u32 sequence;
+     u32 loc;
+     u16 size;
+ } WalletLogCommit;
+
+ /**
+  * @brief Load the wallet a commit names
+  *
+  * Each entry is the newest version of its id written before the commit;
+  * versions after it belong to a save that never completed.
+  *
+  * @param valid_end End of the intact records of each sector
+  * @return False if an entry is missing or damaged
+  */
+ static bool wallet_log_load_commit(WalletLog *log, const WalletLogCommit *commit,
+                                    const u16 *valid_end, WalletSystem *wallet) {
+     u8 record[WALLET_LOG_RECORD_MAX];
+     u32 best_seq[WALLET_LOG_ENTRIES];
+     u32 have[BITSET_WORDS(WALLET_LOG_ENTRIES)];
+     u32 orphaned[BITSET_WORDS(WALLET_LOG_ENTRIES)];
+
+     bitset_clear_all(have, WALLET_LOG_ENTRIES);
+     bitset_clear_all(orphaned, WALLET_LOG_ENTRIES);
+
+     flash_read(log->dev, commit->loc, record, commit->size);
+     const u8 *payload = record + WALLET_LOG_RECORD_HEAD;
+     u8 count = payload[1];
+     if (count > WALLET_LOG_ENTRIES ||
+         commit->size != WALLET_LOG_RECORD_OVERHEAD + WALLET_LOG_COMMIT_FIXED + count) {
+         return false;
+     }
+
+     u8 flags = payload[0];
+     u16 password_hash = get_u16(payload + 2);
+     memcpy(log->committed_ids, payload + WALLET_LOG_COMMIT_FIXED, count);
+
+     // Only record heads are read; the scan already checked every CRC
+     for (int s = 0; s < log->sector_count; s++) {
+         u32 off = WALLET_LOG_SECTOR_HEADER;
+
+         while (off < valid_end[s]) {
+             u8 head[WALLET_LOG_RECORD_HEAD];
+             flash_read(log->dev, WALLET_LOG_LOC(s, off), head, sizeof(head));
+
+             u32 size = get_u16(head) + WALLET_LOG_RECORD_OVERHEAD;
+             u32 seq = get_u32(head + 4);
+             u8 id = head[3];
+
+             if (head[2] == WALLET_LOG_ENTRY && id < WALLET_LOG_ENTRIES) {
+                 if ((s32)(seq - commit->sequence) > 0) {
+                     bitset_set(orphaned, id);
+                 } else if (!bitset_test(have, id) || (s32)(seq - best_seq[id]) > 0) {
+                     bitset_set(have, id);
+                     best_seq[id] = seq;
+                     log->entry_loc[id] = WALLET_LOG_LOC(s, off);
+                     log->entry_len[id] = size;
+                 }
+             }
+
+             off += size;
+         }
+     }
+
+     wallet_book_clear(wallet);
+     for (int i = 0; i < count; i++) {
+         u8 id = log->committed_ids[i];
+         if (id >= WALLET_LOG_ENTRIES || !bitset_test(have, id)) {
+             LOG_ERROR(MODULE_WALLET, "Flash log entry missing", i);
+             return false;
+         }
+
+         u32 len = log->entry_len[id] - WALLET_LOG_RECORD_OVERHEAD;
+         flash_read(log->dev, log->entry_loc[id], record, log->entry_len[id]);
+         if (!wallet_book_load_record(wallet, record + WALLET_LOG_RECORD_HEAD, len)) {
+             LOG_ERROR(MODULE_WALLET, "Flash log entry corrupt", i);
+             return false;
+         }
+     }
+
+     log->committed = true;
+     log->commit_loc = commit->loc;
+     log->commit_len = commit->size;
+     log->count = count;
+     log->flags = flags;
+     log->password_hash = password_hash;
+     memcpy(log->ids, log->committed_ids, sizeof(log->ids));
+     log->working_count = count;
+
+     // A version left by a save that never completed would count as the
+     // newest one before the next commit; rewrite those entries with it
+     for (int i = 0; i < count; i++) {
+         if (bitset_test(orphaned, log->committed_ids[i])) bitset_set(log->dirty, i);
+     }
+
+     wallet->selected_index = count > 0 ? 0 : -1;
+     wallet->is_encrypted = (flags & WALLET_SAVE_ENCRYPTED) != 0;
+     wallet->password_hash = password_hash;
+     return true;
+ }
+
+ /**
+  * @brief Limit a wallet to what the log can hold
+  *
+  * A save with every entry changed has to fit next to the copy it
+  * replaces, in the sectors other than the spare. Each entry costs its
+  * record, the record's framing and its id in the commit.
+  */
+ static void wallet_log_set_limits(const WalletLog *log, WalletSystem *wallet) {
+     s32 limit = 0;
+
+     if (log->sector_count > WALLET_LOG_FREE_TARGET) {
+         limit = (log->sector_count - WALLET_LOG_FREE_TARGET) *
+                 (WALLET_LOG_USABLE - WALLET_LOG_RECORD_MAX) / 2 -
+                 (WALLET_LOG_RECORD_OVERHEAD + WALLET_LOG_COMMIT_FIXED);
+     }
+
+     // A limit of 0 would mean none
+     wallet->record_limit = limit > 0 ? limit : 1;
+     wallet->record_overhead = WALLET_LOG_RECORD_OVERHEAD + 1;
+     wallet->entry_limit = WALLET_LOG_ENTRIES;
+ }
+
+ /**
+  * @brief Recover the log and load the newest complete save
+  */
+ bool wallet_log_open(WalletLog *log, FlashDevice *dev, u16 sector_count, WalletSystem *wallet) {
+     u16 valid_end[FLASH_MAX_SECTORS];
+     WalletLogCommit commits[2];             // Newest first
+     u32 max_erase = 0;
+     bool any = false;
+     int newest_sector = -1;
+
+     memset(log, 0, sizeof(WalletLog));
+     memset(commits, 0, sizeof(commits));
+     log->dev = dev;
+     if (sector_count > dev->sector_count) sector_count = dev->sector_count;
+     log->sector_count = sector_count < FLASH_MAX_SECTORS ? sector_count : FLASH_MAX_SECTORS;
+     log->head = -1;
+
+     wallet_book_clear(wallet);
+     wallet->selected_index = -1;
+     wallet_log_set_limits(log, wallet);
+
+     for (int s = 0; s < log->sector_count; s++) {
+         WalletLogSector *sector = &log->sectors[s];
+         u8 record[WALLET_LOG_RECORD_MAX];
+
+         valid_end[s] = 0;
+         flash_read(dev, WALLET_LOG_LOC(s, 0), record, WALLET_LOG_SECTOR_HEADER);
+         if (get_u32(record) != WALLET_LOG_MAGIC || crc32(record, 8) != get_u32(record + 8)) {
+             sector->state = WALLET_LOG_SECTOR_BAD;
+             continue;
+         }
+
+         sector->erase_count = get_u32(record + 4);
+         if (sector->erase_count > max_erase) max_erase = sector->erase_count;
+
+         u32 off = WALLET_LOG_SECTOR_HEADER;
+         bool sealed = false;
+
+         while (off + WALLET_LOG_RECORD_OVERHEAD <= FLASH_SECTOR_SIZE) {
+             flash_read(dev, WALLET_LOG_LOC(s, off), record, WALLET_LOG_RECORD_HEAD);
+
+             u32 len = get_u16(record);
+             if (len == 0xFFFF) break;
+
+             // A record cut short ends this sector's log
+             u32 size = len + WALLET_LOG_RECORD_OVERHEAD;
+             if (size > WALLET_LOG_RECORD_MAX || off + size > FLASH_SECTOR_SIZE) {
+                 sealed = true;
+                 break;
+             }
+             flash_read(dev, WALLET_LOG_LOC(s, off + WALLET_LOG_RECORD_HEAD),
+                        record + WALLET_LOG_RECORD_HEAD, len + 4);
+             if (crc32(record, WALLET_LOG_RECORD_HEAD + len) !=
+                 get_u32(record + WALLET_LOG_RECORD_HEAD + len)) {
+                 sealed = true;
+                 break;
+             }
+
+             u32 seq = get_u32(record + 4);
+             if (!any || (s32)(seq - log->sequence) > 0) {
+                 log->sequence = seq;
+                 newest_sector = s;
+                 any = true;
+             }
+
+             // Keep the two newest commits; copies made by compaction share a sequence
+             if (record[2] == WALLET_LOG_COMMIT) {
+                 WalletLogCommit found = { true, seq, WALLET_LOG_LOC(s, off), size };
+
+                 if (!commits[0].found || (s32)(seq - commits[0].sequence) > 0) {
+                     commits[1] = commits[0];
+                     commits[0] = found;
+                 } else if (seq != commits[0].sequence &&
+                            (!commits[1].found || (s32)(seq - commits[1].sequence) > 0)) {
+                     commits[1] = found;
+                 }
+             }
+
+             off += size;
+         }
+
+         valid_end[s] = off;
+         sector->end = sealed ? FLASH_SECTOR_SIZE : off;
+         sector->state = (sealed || off > WALLET_LOG_SECTOR_HEADER) ?
+                         WALLET_LOG_SECTOR_USED : WALLET_LOG_SECTOR_FREE;
+     }
+
+     // Sectors whose erase or format was cut short
+     for (int s = 0; s < log->sector_count; s++) {
+         if (log->sectors[s].state == WALLET_LOG_SECTOR_BAD) {
+             wallet_log_format(log, s, max_erase);
+         }
+     }
+
+     if (newest_sector >= 0 && log->sectors[newest_sector].end < FLASH_SECTOR_SIZE) {
+         log->head = newest_sector;
+     }
+
+     for (int attempt = 0; attempt < 2; attempt++) {
+         if (commits[attempt].found &&
+             wallet_log_load_commit(log, &commits[attempt], valid_end, wallet)) {
+             wallet_log_count_live(log);
+             LOG_INFO(MODULE_WALLET, "Flash log loaded", wallet->count);
+             return true;
+         }
+     }
+
+     // Nothing usable: start a new wallet on top of what is there
+     log->committed = false;
+     log->count = 0;
+     log->working_count = 0;
+     wallet_book_clear(wallet);
+     wallet->selected_index = -1;
+     wallet_log_count_live(log);
+     return false;
+ }
+
+ /**
+  * @brief Expand an entry of the benchmark book
+  */
+ static bool wallet_log_bench_entry(const WalletSystem *book, int index, WalletEntry *entry) {
+     u32 len;
+     const u8 *record = wallet_book_record(book, index, &len);
+
+     return record && wallet_record_decode(record, len, entry) == len;
+ }
+
+ /**
+  * @brief Time 1000 edits on a RAM flash stand-in and check recovery
+  *
+  * Each edit changes one entry of a full book of maximum-length entries
+  * and saves it, the way the wallet menu saves after every edit. The
+  * background step runs after each save, as the main loop would.
+  */
+ bool wallet_log_benchmark(WalletLogBenchmark *result) {
+     if (!result) return false;
+     memset(result, 0, sizeof(WalletLogBenchmark));
+
+     u8 *ram = mem_scratch_acquire(WALLET_LOG_BENCH_SECTORS * FLASH_SECTOR_SIZE,
+                                   "wallet log benchmark");
+     if (!ram) {
+         LOG_ERROR(MODULE_OPTIMIZE, "Shared scratch busy", 0);
+         return false;
+     }
+
+     u32 mark = mem_arena_mark(&g_mem_frame);
+     WalletSystem *book = mem_arena_alloc(&g_mem_frame, sizeof(WalletSystem));
+     WalletLog *log = mem_arena_alloc(&g_mem_frame, sizeof(WalletLog));
+     u8 *heap = mem_arena_alloc(&g_mem_frame, WALLET_LOG_BENCH_HEAP);
+     FlashDevice dev;
+     bool ok = book && log && heap;
+
+     if (ok) {
+         wallet_book_init(book, heap, WALLET_LOG_BENCH_HEAP);
+         flash_ram_open(&dev, ram, WALLET_LOG_BENCH_SECTORS, true);
+         wallet_log_open(log, &dev, WALLET_LOG_BENCH_SECTORS, book);
+
+         for (int i = 0; i < WALLET_LOG_ENTRIES; i++) {
+             WalletEntry entry;
+             wallet_record_fill_max(&entry, i);
+             if (!wallet_book_put(book, i, &entry)) break;
+         }
+         // Leave the heap room for an edited record to grow
+         wallet_book_remove(book, book->count - 1);
+         int count = book->count;
+         ok = count > 0 && wallet_log_commit(log, book, NULL);
+
+         u32 erases = dev.erases;
+         u32 programmed = dev.bytes_programmed;
+         u64 total = 0;
+
+         for (int e = 0; e < WALLET_LOG_BENCH_EDITS && ok; e++) {
+             int i = (e * 7) % count;
+             WalletEntry entry;
+
+             wallet_log_bench_entry(book, i, &entry);
+             entry.balance++;
+             entry.last_used = e;
+             ok = wallet_book_put(book, i, &entry);
+             wallet_log_entry_changed(log, i);
+
+             profile_start();
+             ok = wallet_log_commit(log, book, NULL) && ok;
+             u32 cycles = profile_stop();
+             total += cycles;
+             if (cycles > result->save_max_cycles) result->save_max_cycles = cycles;
+
+             profile_start();
+             wallet_log_maintain(log);
+             cycles = profile_stop();
+             if (cycles > result->maintain_max_cycles) result->maintain_max_cycles = cycles;
+         }
+
+         result->edits = WALLET_LOG_BENCH_EDITS;
+         result->save_avg_cycles = total / WALLET_LOG_BENCH_EDITS;
+         result->erases = dev.erases - erases;
+         result->erases_per_1000 = result->erases * 1000 / WALLET_LOG_BENCH_EDITS;
+         result->bytes_per_edit = (dev.bytes_programmed - programmed) / WALLET_LOG_BENCH_EDITS;
+
+         // Lose power halfway through the next save's entry record
+         int edited = count / 2;
+         WalletEntry entry;
+         wallet_log_bench_entry(book, edited, &entry);
+         u32 saved_balance = entry.balance;
+         entry.balance += 1000;
+         ok = wallet_book_put(book, edited, &entry) && ok;
+         wallet_log_entry_changed(log, edited);
+         dev.fail_after = WALLET_LOG_RECORD_MAX / 2;
+         bool cut_short = !wallet_log_commit(log, book, NULL);
+
+         // Reboot from what the device holds
+         flash_ram_open(&dev, ram, WALLET_LOG_BENCH_SECTORS, false);
+         profile_start();
+         bool loaded = wallet_log_open(log, &dev, WALLET_LOG_BENCH_SECTORS, book);
+         result->open_cycles = profile_stop();
+
+         result->recovered = cut_short && loaded && book->count == count &&
+                             wallet_log_bench_entry(book, edited, &entry) &&
+                             entry.balance == saved_balance;
+         ok = ok && result->recovered;
+     }
+
+     mem_arena_release(&g_mem_frame, mark);
+     mem_scratch_release(ram);
+
+     LOG_INFO(MODULE_OPTIMIZE, "Flash log save avg cycles", result->save_avg_cycles);
+     LOG_INFO(MODULE_OPTIMIZE, "Flash log save max cycles", result->save_max_cycles);
+     LOG_INFO(MODULE_OPTIMIZE, "Flash log compaction max cycles", result->maintain_max_cycles);
+     LOG_INFO(MODULE_OPTIMIZE, "Flash log erases per 1000 edits", result->erases_per_1000);
+     LOG_INFO(MODULE_OPTIMIZE, "Flash log bytes per edit", result->bytes_per_edit);
+     LOG_INFO(MODULE_OPTIMIZE, "Flash log open cycles", result->open_cycles);
+
+     if (!ok) {
+         LOG_ERROR(MODULE_OPTIMIZE, "Flash log benchmark failed", result->recovered);
+     }
+     return ok;
+ }
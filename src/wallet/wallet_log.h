@@ -0,0 +1,185 @@
+/**
+ * @file wallet_log.h
+ * @brief Log-structured wallet store for flash save chips
+ *
+ * Flash cannot rewrite a byte in place, so the wallet is kept as a log:
+ * every save appends a new version of each changed entry and then a
+ * commit record naming the entries in order. The newest commit whose
+ * records check out is the saved wallet. Older versions become garbage,
+ * and compaction copies whatever a sector still holds that is live into
+ * the head of the log before erasing it.
+ *
+ * Sector layout (all values little-endian):
+ *   header    magic u32, erase count u32, CRC-32 of the first 8 bytes
+ *   records   length u16, type u8, key u8, sequence u32, payload,
+ *             CRC-32 of everything before it; an erased length ends the log
+ *
+ * An entry record's key is the entry's id and its payload the entry's
+ * packed record, as the wallet holds it in RAM.
+ * A commit record's payload is flags u8, count u8, password hash u16 and
+ * the id of each entry in order.
+ *
+ * @author Claude
+ * @date October 2026
+ * @version 1.0.0
+ */
+
+ #ifndef WALLET_LOG_H
+ #define WALLET_LOG_H
+
+ #include <tonc.h>
+ #include "wallet_system.h"
+ #include "wallet_record.h"
+ #include "save_flash.h"
+ #include "bitset.h"
+
+ #define WALLET_LOG_MAGIC            0x46574247  // "GBWF"
+
+ /**
+  * Entries a commit can name; ids and the commit's count are one byte
+  */
+ #define WALLET_LOG_ENTRIES          255
+
+ /**
+  * Sector and record layout
+  */
+ #define WALLET_LOG_SECTOR_HEADER    12
+ #define WALLET_LOG_RECORD_HEAD      8           // length, type, key, sequence
+ #define WALLET_LOG_RECORD_OVERHEAD  (WALLET_LOG_RECORD_HEAD + 4)
+ #define WALLET_LOG_COMMIT_FIXED     4           // flags, count, password hash
+ #define WALLET_LOG_RECORD_MAX       (WALLET_LOG_RECORD_OVERHEAD + WALLET_RECORD_MAX)
+
+ #if WALLET_LOG_COMMIT_FIXED + WALLET_LOG_ENTRIES > WALLET_RECORD_MAX
+ #error "A commit naming every entry must fit in a record"
+ #endif
+
+ /**
+  * Record types
+  */
+ #define WALLET_LOG_ENTRY            1
+ #define WALLET_LOG_COMMIT           2
+
+ /**
+  * Erased sectors kept ready: one spare for compaction to copy into, plus
+  * one so that an ordinary save never has to wait for an erase
+  */
+ #define WALLET_LOG_FREE_TARGET      2
+
+ /**
+  * Sector states
+  */
+ typedef enum {
+     WALLET_LOG_SECTOR_FREE = 0,             // Erased with a header, no records
+     WALLET_LOG_SECTOR_USED,                 // Holds records
+     WALLET_LOG_SECTOR_BAD                   // Could not be erased
+ } WalletLogSectorState;
+
+ /**
+  * Sector bookkeeping
+  */
+ typedef struct {
+     u16 end;                                // First unwritten byte (sector size if sealed)
+     u16 live;                               // Bytes of records the committed wallet uses
+     u32 erase_count;                        // Erases over the sector's lifetime
+     u8 state;                               // WalletLogSectorState
+ } WalletLogSector;
+
+ /**
+  * Log state
+  */
+ typedef struct {
+     FlashDevice *dev;                       // Device the log lives on
+     u16 sector_count;                       // Sectors in use by the log
+     s16 head;                               // Sector records are appended to (-1 if none)
+     u32 sequence;                           // Last sequence number written
+     WalletLogSector sectors[FLASH_MAX_SECTORS];
+
+     // Committed wallet
+     bool committed;                         // A commit record exists
+     u32 commit_loc;                         // Device offset of the commit record
+     u16 commit_len;                         // Its size in bytes
+     u8 count;                               // Entries in the commit
+     u8 flags;                               // WALLET_SAVE_ENCRYPTED
+     u16 password_hash;
+     u8 committed_ids[WALLET_LOG_ENTRIES];   // Id of each entry, in order
+     u32 entry_loc[WALLET_LOG_ENTRIES];      // Device offset of each id's record (0 = none)
+     u16 entry_len[WALLET_LOG_ENTRIES];      // Its size in bytes
+
+     // Wallet in RAM
+     u8 ids[WALLET_LOG_ENTRIES];             // Id of each entry, in order
+     u8 working_count;                       // Entries the ids cover
+     u32 dirty[BITSET_WORDS(WALLET_LOG_ENTRIES)]; // Entries changed since the commit
+     bool map_changed;                       // Entries removed since the commit
+
+     // Statistics
+     u32 compactions;                        // Sectors reclaimed
+     u32 records_copied;                     // Live records moved by compaction
+ } WalletLog;
+
+ /**
+  * Save latency and wear over a run of edits
+  */
+ typedef struct {
+     u32 edits;                  // Edits saved
+     u32 save_avg_cycles;        // Average save (commit only)
+     u32 save_max_cycles;        // Slowest save, including any compaction it needed
+     u32 maintain_max_cycles;    // Slowest background compaction step
+     u32 erases;                 // Sector erases over the run
+     u32 erases_per_1000;        // Erases per 1000 edits
+     u32 bytes_per_edit;         // Flash bytes programmed per edit
+     u32 open_cycles;            // Recovery scan and load of the full book
+     bool recovered;             // An interrupted save rolled back to the previous one
+ } WalletLogBenchmark;
+
+ /**
+  * Recover the log and load the newest complete save
+  * Sectors with a damaged header (an erase or format cut short) are
+  * erased again; a record cut short ends its sector's log. Without a
+  * usable save the wallet is left empty and the log starts fresh. Also
+  * sets the wallet's limits to what the log can hold.
+  * @param log Log to set up
+  * @param dev Flash device
+  * @param sector_count Sectors from the start of the device the log owns
+  * @param wallet Wallet system to fill
+  * @return False if the device holds no usable save
+  */
+ bool wallet_log_open(WalletLog *log, FlashDevice *dev, u16 sector_count, WalletSystem *wallet);
+
+ /**
+  * Append the entries changed since the last commit, then a commit record
+  * Compacts first if the log is too full for the save; returns at once
+  * if nothing changed
+  * @param log Log
+  * @param wallet Wallet system to save
+  * @param bytes_written Output: flash bytes programmed (may be NULL)
+  * @return False if the save could not be written
+  */
+ bool wallet_log_commit(WalletLog *log, const WalletSystem *wallet, u32 *bytes_written);
+
+ /**
+  * Mark an entry as changed (added or updated)
+  */
+ void wallet_log_entry_changed(WalletLog *log, int index);
+
+ /**
+  * Record that an entry was removed and the entries after it moved down
+  */
+ void wallet_log_entry_removed(WalletLog *log, int index);
+
+ /**
+  * Reclaim one sector if fewer than WALLET_LOG_FREE_TARGET are erased
+  * Call when the application is idle; an erase takes tens of milliseconds
+  * @return True if a sector was reclaimed
+  */
+ bool wallet_log_maintain(WalletLog *log);
+
+ /**
+  * Time 1000 single-entry edits of a full book on a RAM flash stand-in,
+  * then cut a save short and check that recovery rolls it back
+  * Borrows the shared scratch for the stand-in
+  * @param result Output timings and wear
+  * @return Success status
+  */
+ bool wallet_log_benchmark(WalletLogBenchmark *result);
+
+ #endif // WALLET_LOG_H
@@ -15,6 +15,11 @@
  #include <stdio.h>
  #include "wallet_menu.h"
  #include "wallet_system.h"
+ #include "wallet_record.h"
+ #include "wallet_search.h"
+ #include "wallet_storage.h"
+ #include "wallet_log.h"
+ #include "save_media.h"
  #include "qr_debug.h"
  #include "qr_system.h"
  #include "crypto_types.h"
@@ -42,6 +47,27 @@
  bool g_edit_is_new_entry = false;
  bool g_confirm_delete = false;
  
+ // Retained QR screen: full redraw only after invalidation
+ static bool s_qr_screen_dirty = true;
+ static int s_qr_screen_variation = -1;
+ 
+ // List screen search: L/R pick a character, A types it, B erases one
+ static const char s_search_chars[] = "abcdefghijklmnopqrstuvwxyz0123456789 ";
+ static bool s_search_active = false;
+ static int s_search_char = 0;
+ 
+ // Settings screen: selected option (shared by input and render) and QR display path
+ #define WALLET_SETTINGS_OPTIONS 5
+ static int s_settings_option = 0;
+ static WalletQrDisplay s_qr_display = WALLET_QR_DISPLAY_STANDARD;
+ static const char* const s_qr_display_names[WALLET_QR_DISPLAY_COUNT] = { "Standard", "Scaled", "Scanline", "Tiled" };
+ static bool s_qr_scanline_shown = false;
+ 
+ // Last benchmark run from Settings (the numbers themselves go to the log)
+ #define WALLET_BENCH_QR_TEXT "bc1qar0srrr7xfkvy5l643lydnw9re59gtzzwf5mdq"
+ static int s_bench_run = 0;
+ static int s_bench_passed = 0;
+ 
  // Function pointer for QR rendering (can be replaced by QR protection system)
  bool (*wallet_render_qr_function)(int x, int y, int scale) = wallet_render_current_qr;
  
@@ -260,7 +286,7 @@
      }
      
      // Copy data for editing
-     memcpy(&g_edit_wallet_entry, &wallet->entries[wallet->selected_index], sizeof(WalletEntry));
+     memcpy(&g_edit_wallet_entry, wallet_get_selected_entry(), sizeof(WalletEntry));
      g_edit_is_new_entry = false;
      g_edit_current_field = 0;
      g_wallet_screen_state = WALLET_SCREEN_EDIT;
@@ -324,6 +350,7 @@
      // Generate QR for the selected wallet
      if (wallet_generate_qr(wallet->selected_index)) {
          g_wallet_screen_state = WALLET_SCREEN_QR;
+         wallet_invalidate_qr_screen();
          LOG_INFO(MODULE_WALLET, "Displaying QR for wallet", wallet->selected_index);
      } else {
          LOG_ERROR(MODULE_WALLET, "Failed to generate QR", wallet->selected_index);
@@ -526,6 +553,45 @@
          wallet_next_entry();
      }
      
+     // Start or end a search; ending it shows every entry again
+     if (key_hit(KEY_SELECT)) {
+         s_search_active = !s_search_active;
+         if (!s_search_active) {
+             wallet_search_clear();
+         }
+         return;
+     }
+     
+     if (s_search_active) {
+         int chars = sizeof(s_search_chars) - 1;
+         
+         if (key_hit(KEY_R)) {
+             s_search_char = (s_search_char + 1) % chars;
+         } else if (key_hit(KEY_L)) {
+             s_search_char = (s_search_char + chars - 1) % chars;
+         }
+         
+         if (key_hit(KEY_A)) {
+             // Each character narrows the previous results; keep the selection in them
+             wallet_search_append(s_search_chars[s_search_char]);
+             if (wallet_get_filtered_index(wallet->selected_index) < 0 &&
+                 wallet_get_filtered_count() > 0) {
+                 wallet_select_entry(wallet_get_actual_index(0));
+             }
+         } else if (key_hit(KEY_B)) {
+             if (wallet_get_search_query()[0] != '\0') {
+                 wallet_search_backspace();
+             } else {
+                 s_search_active = false;
+             }
+         } else if (key_hit(KEY_START)) {
+             if (wallet_get_filtered_index(wallet->selected_index) >= 0) {
+                 wallet_action_view_details(NULL);
+             }
+         }
+         return;
+     }
+     
      // Select wallet
      if (key_hit(KEY_A)) {
          if (wallet->count > 0 && wallet->selected_index >= 0) {
@@ -576,8 +642,36 @@
   * @brief Process input in the QR display screen
   */
  void wallet_process_qr_input(void) {
+     if (key_hit(KEY_ANY)) {
+         wallet_invalidate_qr_screen();
+     }
+     
+     // SELECT: fullscreen page-flipped display of the protected variations
+     if (key_hit(KEY_SELECT) && g_qr_protection.enabled && !qr_protection_display_active()) {
+         QrState *qr = &g_qr_protection.variations[g_qr_protection.current_variation];
+         if (qr->size > 0) {
+             int scale = SCREEN_HEIGHT / (qr->size + 8);
+             if (scale < 1) scale = 1;
+             int size = qr->size * scale;
+             qr_protection_display_begin((SCREEN_WIDTH - size) / 2, (SCREEN_HEIGHT - size) / 2, scale);
+         }
+         return;
+     }
+     
      // Return to details
      if (key_hit(KEY_A) || key_hit(KEY_B)) {
+         qr_protection_display_end();
+         qr_protection_atlas_hide();
+         qr_protection_palette_hide();
+         render_qr_sprites_hide();
+         render_qr_affine_hide();
+         render_qr_tile_hide();
+         render_qr_scanline_end();
+         s_qr_scanline_shown = false;
+         render_qr_quiet_zone_hide();
+         
+         // Reloads only what a bitmap fallback overwrote
+         menu_restore_graphics();
          g_wallet_screen_state = WALLET_SCREEN_DETAILS;
      }
  }
@@ -667,11 +761,18 @@
          g_edit_wallet_entry.last_used = get_system_ticks();
          
          // Save wallet
+         // Either can fail once the save space is full; stay in the editor
          if (g_edit_is_new_entry) {
-             wallet_add_entry(&g_edit_wallet_entry);
+             if (wallet_add_entry(&g_edit_wallet_entry) < 0) {
+                 LOG_ERROR(MODULE_WALLET, "No room for new wallet", wallet->count);
+                 return;
+             }
              LOG_INFO(MODULE_WALLET, "New wallet added", wallet->count - 1);
          } else {
-             wallet_update_entry(wallet->selected_index, &g_edit_wallet_entry);
+             if (!wallet_update_entry(wallet->selected_index, &g_edit_wallet_entry)) {
+                 LOG_ERROR(MODULE_WALLET, "No room for wallet changes", wallet->selected_index);
+                 return;
+             }
              LOG_INFO(MODULE_WALLET, "Wallet updated", wallet->selected_index);
          }
          
@@ -688,20 +789,81 @@
  /**
   * @brief Process input in the settings screen
   */
+ /**
+  * @brief Run every benchmark once; each logs its own results
+  *
+  * Takes a few seconds. The rendering benchmarks draw over VRAM, so
+  * the menu graphics are restored after.
+  */
+ static void wallet_run_benchmarks(void) {
+     static QrState bench_qr;
+     WalletBookBenchmark book;
+     WalletSearchBenchmark search;
+     WalletRecordBenchmark record;
+     WalletStorageBenchmark storage;
+     WalletLogBenchmark log;
+     SaveMediaBenchmark media;
+     QrScanlineBenchmark scanline;
+     
+     s_bench_run = 0;
+     s_bench_passed = 0;
+     
+     s_bench_run++; s_bench_passed += wallet_book_benchmark(&book);
+     s_bench_run++; s_bench_passed += wallet_search_benchmark(&search);
+     s_bench_run++; s_bench_passed += wallet_record_benchmark(&record);
+     s_bench_run++; s_bench_passed += wallet_log_benchmark(&log);
+     s_bench_run++; s_bench_passed += save_media_benchmark(&media);
+     if (save_media_type() == SAVE_MEDIA_SRAM) {
+         s_bench_run++; s_bench_passed += wallet_storage_benchmark(&storage);
+     }
+     
+     // Rendering: a typical address at the largest scale the screen height allows
+     qr_init(&bench_qr);
+     if (qr_set_text(&bench_qr, WALLET_BENCH_QR_TEXT) && qr_generate(&bench_qr)) {
+         int scale = SCREEN_HEIGHT / bench_qr.size;
+         int side = bench_qr.size * scale;
+         int x = (SCREEN_WIDTH - side) / 2;
+         int y = (SCREEN_HEIGHT - side) / 2;
+         
+         u32 plot_cycles, span_cycles, build_cycles, redraw_cycles;
+         
+         s_bench_run++;
+         s_bench_passed += render_qr_scanline_benchmark(&bench_qr, x, y, scale, &scanline);
+         
+         // A full-screen redraw, per-pixel plotting against spans
+         s_bench_run++;
+         if (render_qr_benchmark(&bench_qr, x, y, scale, &plot_cycles, &span_cycles)) {
+             s_bench_passed++;
+             LOG_INFO(MODULE_OPTIMIZE, "QR span speedup x10",
+                      span_cycles ? plot_cycles * 10 / span_cycles : 0);
+         }
+         
+         s_bench_run++;
+         s_bench_passed += render_qr_tile_benchmark(&bench_qr, x, y, scale,
+                                                    &build_cycles, &redraw_cycles);
+     } else {
+         s_bench_run += 3;
+     }
+     qr_free(&bench_qr);
+     menu_restore_graphics();
+     
+     LOG_INFO(MODULE_OPTIMIZE, "Benchmarks run", s_bench_run);
+     LOG_INFO(MODULE_OPTIMIZE, "Benchmarks passed", s_bench_passed);
+ }
+ 
  void wallet_process_settings_input(void) {
      WalletSystem* wallet = wallet_system_get_instance();
      
      // Navigation between options
-     static int settings_option = 0;
      if (key_hit(KEY_UP)) {
-         settings_option = (settings_option - 1 + 3) % 3;
+         s_settings_option = (s_settings_option - 1 + WALLET_SETTINGS_OPTIONS) % WALLET_SETTINGS_OPTIONS;
      } else if (key_hit(KEY_DOWN)) {
-         settings_option = (settings_option + 1) % 3;
+         s_settings_option = (s_settings_option + 1) % WALLET_SETTINGS_OPTIONS;
      }
      
      // Change options
      if (key_hit(KEY_A)) {
-         switch (settings_option) {
+         switch (s_settings_option) {
              case 0: // Enable/disable encryption
                  if (wallet->is_encrypted) {
                      wallet_decrypt_data();
@@ -721,9 +883,18 @@
                  
              case 2: // Reset filters
                  wallet->show_favorites_only = false;
-                 wallet->active_crypto_filter = CRYPTO_TYPE_COUNT;
+                 wallet->active_crypto_filter = WALLET_FILTER_NONE;
                  LOG_INFO(MODULE_WALLET, "Filters reset", 0);
                  break;
+                 
+             case 3: // QR display path
+                 s_qr_display = (s_qr_display + 1) % WALLET_QR_DISPLAY_COUNT;
+                 LOG_INFO(MODULE_WALLET, "QR display changed", s_qr_display);
+                 break;
+                 
+             case 4: // Benchmarks
+                 wallet_run_benchmarks();
+                 break;
          }
      }
      
@@ -752,7 +923,7 @@
          switch (filter_option) {
              case 0: // All
                  wallet->show_favorites_only = false;
-                 wallet->active_crypto_filter = CRYPTO_TYPE_COUNT;
+                 wallet->active_crypto_filter = WALLET_FILTER_NONE;
                  LOG_INFO(MODULE_WALLET, "Filter: All", 0);
                  break;
                  
@@ -763,25 +934,25 @@
                  
              case 2: // Bitcoin
                  wallet->active_crypto_filter = (wallet->active_crypto_filter == CRYPTO_TYPE_BITCOIN) ? 
-                                                CRYPTO_TYPE_COUNT : CRYPTO_TYPE_BITCOIN;
+                                                WALLET_FILTER_NONE : CRYPTO_TYPE_BITCOIN;
                  LOG_INFO(MODULE_WALLET, "Filter: Bitcoin", wallet->active_crypto_filter == CRYPTO_TYPE_BITCOIN);
                  break;
                  
              case 3: // Ethereum
                  wallet->active_crypto_filter = (wallet->active_crypto_filter == CRYPTO_TYPE_ETHEREUM) ? 
-                                                CRYPTO_TYPE_COUNT : CRYPTO_TYPE_ETHEREUM;
+                                                WALLET_FILTER_NONE : CRYPTO_TYPE_ETHEREUM;
                  LOG_INFO(MODULE_WALLET, "Filter: Ethereum", wallet->active_crypto_filter == CRYPTO_TYPE_ETHEREUM);
                  break;
                  
              case 4: // Litecoin
                  wallet->active_crypto_filter = (wallet->active_crypto_filter == CRYPTO_TYPE_LITECOIN) ? 
-                                                CRYPTO_TYPE_COUNT : CRYPTO_TYPE_LITECOIN;
+                                                WALLET_FILTER_NONE : CRYPTO_TYPE_LITECOIN;
                  LOG_INFO(MODULE_WALLET, "Filter: Litecoin", wallet->active_crypto_filter == CRYPTO_TYPE_LITECOIN);
                  break;
                  
              case 5: // Dogecoin
                  wallet->active_crypto_filter = (wallet->active_crypto_filter == CRYPTO_TYPE_DOGECOIN) ? 
-                                                CRYPTO_TYPE_COUNT : CRYPTO_TYPE_DOGECOIN;
+                                                WALLET_FILTER_NONE : CRYPTO_TYPE_DOGECOIN;
                  LOG_INFO(MODULE_WALLET, "Filter: Dogecoin", wallet->active_crypto_filter == CRYPTO_TYPE_DOGECOIN);
                  break;
          }
@@ -842,50 +1013,66 @@
      
      // Get number of filtered wallets
      int filtered_count = wallet_get_filtered_count();
+     int y = 30;
+     int rows = 8;
+     
+     // Search line: the query so far, then the character A would type
+     if (s_search_active || wallet_get_search_query()[0] != '\0') {
+         char search_text[64];
+         char next = s_search_chars[s_search_char];
+         
+         if (s_search_active) {
+             sprintf(search_text, "Find: %s[%c]", wallet_get_search_query(), next == ' ' ? '_' : next);
+         } else {
+             sprintf(search_text, "Find: %s", wallet_get_search_query());
+         }
+         tte_write_ex(10, y, search_text, RGB15(0,31,31));
+         sprintf(search_text, "%d found", filtered_count);
+         tte_write_ex(170, y, search_text, RGB15(15,15,15));
+         
+         y += 15;
+         rows--;
+     }
+     
      if (filtered_count == 0) {
-         tte_write_ex(10, 30, "No wallets match current filters.", RGB15(31,0,0));
-         tte_write_ex(10, 50, "Change filters or add new wallets.", RGB15(31,31,31));
+         tte_write_ex(10, y, "No wallets match current filters.", RGB15(31,0,0));
+         tte_write_ex(10, y + 20, "Change filters or add new wallets.", RGB15(31,31,31));
          
          // Instructions
-         tte_write_ex(5, 150, "START: New wallet  B: Return", RGB15(31,31,31));
+         if (s_search_active) {
+             tte_write_ex(5, 150, "L/R:Char  A:Type  B:Erase", RGB15(31,31,31));
+         } else {
+             tte_write_ex(5, 150, "START: New wallet  B: Return", RGB15(31,31,31));
+         }
          return;
      }
      
-     // Display wallet list
-     int y = 30;
-     int count = 0;
-     
-     for (int i = 0; i < wallet->count && count < 8; i++) {
-         // Apply current filters
-         if (wallet->show_favorites_only && !wallet->entries[i].favorite) {
-             continue;
-         }
-         
-         if (wallet->active_crypto_filter < CRYPTO_TYPE_COUNT && 
-             wallet->entries[i].type_index != wallet->active_crypto_filter) {
-             continue;
-         }
+     // Display wallet list; the filter index finds each row's entry
+     for (int row = 0; row < filtered_count && row < rows; row++) {
+         int i = wallet_get_actual_index(row);
          
          // Color selection based on whether this entry is selected
          u16 color = (i == wallet->selected_index) ? RGB15(31,31,0) : RGB15(31,31,31);
          
-         // Prepare wallet text
+         // Prepare wallet text (only the name is read from the packed record)
          char wallet_text[64];
+         char name[MAX_NAME_LENGTH];
+         wallet_get_entry_name(i, name);
          
          // Get crypto type info
-         const CryptoTypeInfo* type_info = crypto_get_type_info(wallet->entries[i].type_index);
+         const CryptoTypeInfo* type_info = crypto_get_type_info(wallet_get_entry_type(i));
          
          if (type_info) {
              sprintf(wallet_text, "%s [%s]", 
-                     wallet->entries[i].name, 
+                     name, 
                      type_info->symbol);
          } else {
              sprintf(wallet_text, "%s [???]", 
-                     wallet->entries[i].name);
+                     name);
          }
          
          // Show favorite marker
-         if (wallet->entries[i].favorite) {
+         if (wallet_is_favorite(i)) {
              tte_write_ex(5, y, "★", RGB15(31,31,0));
          }
          
@@ -898,11 +1085,14 @@
          tte_write_ex(20, y, wallet_text, color);
          
          y += 15;
-         count++;
      }
      
      // Instructions
-     tte_write_ex(5, 150, "A: View  START: New  B: Return", RGB15(31,31,31));
+     if (s_search_active) {
+         tte_write_ex(5, 150, "L/R:Char  A:Type  B:Erase  START:View", RGB15(31,31,31));
+     } else {
+         tte_write_ex(5, 150, "A:View  START:New  SEL:Find  B:Return", RGB15(31,31,31));
+     }
  }
  
  /**
@@ -917,7 +1107,7 @@
          return;
      }
      
-     WalletEntry* entry = &wallet->entries[wallet->selected_index];
+     WalletEntry* entry = wallet_get_selected_entry();
      
      // Clear screen
      tte_erase_screen();
@@ -999,8 +1189,31 @@
      }
  }
  
+ /**
+  * @brief Mark the QR screen for a full redraw on the next frame
+  */
+ void wallet_invalidate_qr_screen(void) {
+     s_qr_screen_dirty = true;
+ }
+ 
+ /**
+  * @brief Check whether the retained QR screen is being shown
+  * 
+  * While it is, the main loop skips the generic menu render, which would
+  * otherwise erase the screen every frame.
+  * 
+  * @return true if the wallet QR screen is current
+  */
+ bool wallet_qr_screen_active(void) {
+     return g_wallet_screen_state == WALLET_SCREEN_QR;
+ }
+ 
  /**
   * @brief Render the QR code screen
+  * 
+  * Retained mode: the whole screen is drawn only after
+  * wallet_invalidate_qr_screen(). Otherwise only a protection variation
+  * switch re-renders the QR code, and unchanged frames draw nothing.
   */
  void wallet_render_qr_screen(void) {
      WalletSystem* wallet = wallet_system_get_instance();
@@ -1011,7 +1224,44 @@
          return;
      }
      
-     WalletEntry* entry = &wallet->entries[wallet->selected_index];
+     // QR code placement: the symbol wallet_action_show_qr generated,
+     // centred between the title lines and the instructions
+     const int scale = 2;
+     int modules = wallet->qr_state.size > 0 ? wallet->qr_state.size : 21;
+     int qr_size = modules * scale;
+     int x = (SCREEN_WIDTH - qr_size) / 2;
+     int y = (35 + 148 - qr_size) / 2;
+     
+     if (!s_qr_screen_dirty) {
+         // Only the QR code changes when the protection switches variation
+         if (g_qr_protection.enabled && s_qr_screen_variation != g_qr_protection.current_variation) {
+             s_qr_screen_variation = g_qr_protection.current_variation;
+             wallet_render_qr_function(x, y, scale);
+         }
+         return;
+     }
+     
+     s_qr_screen_dirty = false;
+     s_qr_screen_variation = g_qr_protection.current_variation;
+     
+     // Mode 4 shows only the streamed symbol: centre it at the largest
+     // scale that leaves room for the quiet zone. Nothing to redraw after.
+     if (s_qr_display == WALLET_QR_DISPLAY_SCANLINE && !g_qr_protection.enabled) {
+         if (s_qr_scanline_shown) {
+             return;
+         }
+         
+         int fit = SCREEN_HEIGHT / (modules + 8);
+         int side = modules * fit;
+         
+         if (fit >= 1 && render_qr_scanline_begin(&wallet->qr_state, (SCREEN_WIDTH - side) / 2,
+                                                  (SCREEN_HEIGHT - side) / 2, fit, 4)) {
+             s_qr_scanline_shown = true;
+             return;
+         }
+     }
+     
+     WalletEntry* entry = wallet_get_selected_entry();
      
      // Clear screen
      tte_erase_screen();
@@ -1036,27 +1286,46 @@
      
      tte_write_ex(120 - strlen(title) * 3, 25, title, RGB15(31,31,31));
      
-     // Render QR code
-     int qr_size = 21 * 2; // Default QR size x scale factor
-     int x = (SCREEN_WIDTH - qr_size) / 2;
-     int y = 40;
+     // A full redraw starts from an erased screen
+     qr_protection_delta_reset();
      
-     // Add white border around QR code
-     for (int i = x - 4; i < x + qr_size + 4; i++) {
-         for (int j = y - 4; j < y + qr_size + 4; j++) {
-             if (i >= 0 && i < SCREEN_WIDTH && j >= 0 && j < SCREEN_HEIGHT) {
-                 m3_plot(i, j, CLR_WHITE);
-             }
+     // The affine layer scales to any size: fill the height, leaving room
+     // for the quiet zone. Protected codes keep their own renderers.
+     bool rendered = false;
+     int border = 4 * scale;
+     
+     if (s_qr_display == WALLET_QR_DISPLAY_SCALED && !g_qr_protection.enabled) {
+         int size = (148 - 35) * modules / (modules + 8);
+         int sx = (SCREEN_WIDTH - size) / 2;
+         int sy = (35 + 148 - size) / 2;
+         
+         if (render_qr_affine(&wallet->qr_state, sx, sy, size, 0)) {
+             rendered = true;
+             x = sx;
+             y = sy;
+             qr_size = size;
+             border = 4 * size / modules;
          }
+     } else if (s_qr_display == WALLET_QR_DISPLAY_TILED && !g_qr_protection.enabled) {
+         // Map entries only; the text layer is left as it is
+         rendered = render_qr_tile_based(&wallet->qr_state, x, y, scale);
      }
      
+     // Quiet zone from the backdrop: window registers, no pixels; QR
+     // readers need four modules of it
+     render_qr_quiet_zone(x, y, qr_size, border);
+     
      // Render the QR code using the (potentially protected) function
-     if (!wallet_render_qr_function(x, y, 2)) {
+     if (!rendered && !wallet_render_qr_function(x, y, scale)) {
          tte_write_ex(60, 80, "Failed to render QR code", RGB15(31,0,0));
      }
      
      // Instructions
-     tte_write_ex(40, 150, "A/B: Return to Details", RGB15(31,31,31));
+     if (g_qr_protection.enabled) {
+         tte_write_ex(20, 150, "A/B: Back  SELECT: Fullscreen", RGB15(31,31,31));
+     } else {
+         tte_write_ex(40, 150, "A/B: Return to Details", RGB15(31,31,31));
+     }
  }
  
  /**
@@ -1178,7 +1447,7 @@
      }
      
      // Options
-     static int settings_option = 0;
+     int settings_option = s_settings_option;
      
      // Encryption
      int y = 40;
@@ -1210,6 +1479,32 @@
      if (settings_option == 2) {
          tte_write_ex(5, y, ">", RGB15(0,31,0));
      }
+     y += 25;
+     
+     // QR display path
+     color = (settings_option == 3) ? RGB15(31,31,0) : RGB15(31,31,31);
+     
+     tte_write_ex(10, y, "QR Display:", RGB15(31,31,31));
+     tte_write_ex(100, y, s_qr_display_names[s_qr_display], color);
+     
+     if (settings_option == 3) {
+         tte_write_ex(5, y, ">", RGB15(0,31,0));
+     }
+     y += 25;
+     
+     // Benchmarks
+     color = (settings_option == 4) ? RGB15(31,31,0) : RGB15(31,31,31);
+     
+     tte_write_ex(10, y, "Run Benchmarks", color);
+     if (s_bench_run > 0) {
+         char bench_text[32];
+         sprintf(bench_text, "%d/%d passed", s_bench_passed, s_bench_run);
+         tte_write_ex(130, y, bench_text, RGB15(15,15,15));
+     }
+     
+     if (settings_option == 4) {
+         tte_write_ex(5, y, ">", RGB15(0,31,0));
+     }
      
      // Instructions
      tte_write_ex(5, 150, "A:Select  B:Return", RGB15(31,31,31));
@@ -1245,7 +1540,7 @@
          tte_write_ex(10, y, ">", RGB15(0,31,0));
      }
      
-     if (wallet->active_crypto_filter == CRYPTO_TYPE_COUNT && !wallet->show_favorites_only) {
+     if (wallet->active_crypto_filter == WALLET_FILTER_NONE && !wallet->show_favorites_only) {
          tte_write_ex(150, y, "[Active]", RGB15(0,31,0));
      }
      y += 20;
@@ -1422,6 +1717,9 @@
          return false;
      }
      
-     // Render the QR code
+     // Sprite overlay leaves the text layer intact; bitmap render as fallback
+     if (render_qr_sprites(&wallet->qr_state, x, y, scale, 2)) {
+         return true;
+     }
      return render_qr_to_screen(&wallet->qr_state, x, y, scale);
  }
\ No newline at end of file
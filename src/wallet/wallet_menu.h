@@ -33,6 +33,17 @@
      WALLET_SCREEN_QR_PROTECTION  // QR protection settings
  } WalletScreenState;
  
+ /**
+  * How the QR screen shows an unprotected code (chosen in Settings)
+  */
+ typedef enum {
+     WALLET_QR_DISPLAY_STANDARD = 0,  // Sprites, or a Mode 3 bitmap, at an integer scale
+     WALLET_QR_DISPLAY_SCALED,        // Affine BG2, scaled to fill the screen height
+     WALLET_QR_DISPLAY_SCANLINE,      // Streamed by HBlank DMA in Mode 4, symbol only
+     WALLET_QR_DISPLAY_TILED,         // Tile map on BG2 in Mode 0, at an integer scale
+     WALLET_QR_DISPLAY_COUNT
+ } WalletQrDisplay;
+ 
  /**
   * Initialize the wallet menu system
   */
@@ -163,10 +174,21 @@
  void wallet_render_details_screen(void);
  
  /**
-  * Render QR code screen
+  * Render QR code screen (retained: redraws fully only after invalidation)
   */
  void wallet_render_qr_screen(void);
  
+ /**
+  * Mark the QR screen for a full redraw on the next frame
+  */
+ void wallet_invalidate_qr_screen(void);
+ 
+ /**
+  * Check whether the retained QR screen is being shown
+  * @return true if the wallet QR screen is current
+  */
+ bool wallet_qr_screen_active(void);
+ 
  /**
   * Render wallet edit screen
   */
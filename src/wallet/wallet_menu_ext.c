@@ -562,7 +562,7 @@
      }
      
      // Get the address from the selected wallet entry
-     WalletEntry* entry = &wallet->entries[wallet->selected_index];
+     WalletEntry* entry = wallet_get_selected_entry();
      if (!entry->address[0]) {
          return false;
      }
@@ -0,0 +1,346 @@
+/**
+ * @file wallet_record.c
+ * @brief Compact stored form of a wallet entry
+ *
+ * @author Claude
+ * @date October 2026
+ * @version 1.0.0
+ */
+
+ #include <tonc.h>
+ #include <stdio.h>
+ #include <string.h>
+ #include <stddef.h>
+ #include "wallet_record.h"
+
+ const WalletTextField WALLET_TEXT_FIELDS[WALLET_TEXT_FIELD_COUNT] = {
+     { offsetof(WalletEntry, name),    MAX_NAME_LENGTH },
+     { offsetof(WalletEntry, address), MAX_ADDRESS_LENGTH },
+     { offsetof(WalletEntry, notes),   MAX_NOTES_LENGTH },
+     { offsetof(WalletEntry, tags),    MAX_TAGS_LENGTH },
+ };
+
+ /**
+  * Benchmark samples: one of each address form of the supported coins
+  */
+ typedef struct {
+     u8 type;
+     const char *name;
+     const char *address;
+     const char *notes;
+     const char *tags;
+ } WalletRecordSample;
+
+ static const WalletRecordSample SAMPLES[] = {
+     { CRYPTO_TYPE_ETHEREUM, "Main ETH",
+       "0x5aAeb6053F3E94C9b9A09f33669435E7Ef1BeAed", "Hardware wallet", "eth,cold" },
+     { CRYPTO_TYPE_ETHEREUM, "Exchange",
+       "0xde0b295669a9fd93d5f28d9ec85e40f4cb697bae", "Deposit only", "eth" },
+     { CRYPTO_TYPE_BITCOIN, "Genesis",
+       "1A1zP1eP5QGefi2DMPTfTL5SLmv7DivfNa", "", "btc" },
+     { CRYPTO_TYPE_BITCOIN, "Multisig",
+       "3J98t1WpEZ73CNmQviecrnyiWrnqRhWNLy", "2 of 3", "btc,shared" },
+     { CRYPTO_TYPE_BITCOIN, "Savings",
+       "bc1qar0srrr7xfkvy5l643lydnw9re59gtzzwf5mdq", "Segwit", "btc,cold" },
+     { CRYPTO_TYPE_LITECOIN, "LTC paper",
+       "LVg2kJoFNg45Nbpy53h7Fe1wKyeXVRhMH9", "", "ltc" },
+     { CRYPTO_TYPE_DOGECOIN, "Tips",
+       "DH5yaieqoZN36fDVciNyRueRGvGLR3mr7L", "Donations", "doge" },
+ };
+
+ #define SAMPLE_COUNT    (sizeof(SAMPLES) / sizeof(SAMPLES[0]))
+
+ static inline void put_u32(u8 *p, u32 value) {
+     p[0] = value;
+     p[1] = value >> 8;
+     p[2] = value >> 16;
+     p[3] = value >> 24;
+ }
+
+ static inline u32 get_u32(const u8 *p) {
+     return p[0] | (p[1] << 8) | (p[2] << 16) | ((u32)p[3] << 24);
+ }
+
+ static u8 *put_text(u8 *p, const char *text, u32 size) {
+     u32 len = strnlen(text, size - 1);
+
+     *p++ = len;
+     memcpy(p, text, len);
+     return p + len;
+ }
+
+ /**
+  * @brief Copy a length-prefixed text into its array
+  *
+  * @return Position after the text, or NULL if it does not fit
+  */
+ static const u8 *get_text(const u8 *p, const u8 *end, char *text, u32 size) {
+     if (p >= end) return NULL;
+
+     u32 n = *p++;
+     if (n >= size || n > (u32)(end - p)) return NULL;
+
+     memcpy(text, p, n);
+     memset(text + n, 0, size - n);
+     return p + n;
+ }
+
+ static const u8 *skip_text(const u8 *p, const u8 *end, u32 size) {
+     if (p >= end) return NULL;
+
+     u32 n = *p++;
+     if (n >= size || n > (u32)(end - p)) return NULL;
+     return p + n;
+ }
+
+ /**
+  * @brief Size of the fixed fields of a record
+  */
+ static inline u32 wallet_record_fixed(const u8 *in) {
+     return 2 + ((in[1] & WALLET_RECORD_BALANCE) ? 4 : 0) +
+                ((in[1] & WALLET_RECORD_LAST_USED) ? 4 : 0);
+ }
+
+ /**
+  * @brief Encode an entry as a compact record
+  */
+ u32 wallet_record_encode(const WalletEntry *entry, u8 *out) {
+     u8 flags = entry->favorite ? WALLET_RECORD_FAVORITE : 0;
+     u8 *p = out + 2;
+
+     // Zero is the usual balance and last-used time, so it is left out
+     if (entry->balance) {
+         flags |= WALLET_RECORD_BALANCE;
+         put_u32(p, entry->balance);
+         p += 4;
+     }
+     if (entry->last_used) {
+         flags |= WALLET_RECORD_LAST_USED;
+         put_u32(p, entry->last_used);
+         p += 4;
+     }
+
+     p = put_text(p, entry->name, MAX_NAME_LENGTH);
+     p += wallet_address_pack(entry->address, p);
+     p = put_text(p, entry->notes, MAX_NOTES_LENGTH);
+     p = put_text(p, entry->tags, MAX_TAGS_LENGTH);
+
+     out[0] = entry->type_index;
+     out[1] = flags;
+     return p - out;
+ }
+
+ /**
+  * @brief Decode a record into an entry
+  */
+ u32 wallet_record_decode(const u8 *in, u32 len, WalletEntry *entry) {
+     const u8 *end = in + len;
+
+     if (len < 2 || wallet_record_fixed(in) > len) return 0;
+
+     entry->type_index = in[0];
+     entry->favorite = (in[1] & WALLET_RECORD_FAVORITE) != 0;
+
+     const u8 *p = in + 2;
+     entry->balance = 0;
+     entry->last_used = 0;
+     if (in[1] & WALLET_RECORD_BALANCE) {
+         entry->balance = get_u32(p);
+         p += 4;
+     }
+     if (in[1] & WALLET_RECORD_LAST_USED) {
+         entry->last_used = get_u32(p);
+         p += 4;
+     }
+
+     p = get_text(p, end, entry->name, MAX_NAME_LENGTH);
+     if (!p) return 0;
+
+     memset(entry->address, 0, MAX_ADDRESS_LENGTH);
+     u32 n = wallet_address_unpack(p, end - p, entry->address);
+     if (!n) return 0;
+     p += n;
+
+     p = get_text(p, end, entry->notes, MAX_NOTES_LENGTH);
+     if (p) p = get_text(p, end, entry->tags, MAX_TAGS_LENGTH);
+     return p ? p - in : 0;
+ }
+
+ /**
+  * @brief Check a record's structure without expanding it
+  */
+ u32 wallet_record_size(const u8 *in, u32 len) {
+     const u8 *end = in + len;
+
+     if (len < 2 || wallet_record_fixed(in) > len) return 0;
+
+     const u8 *p = skip_text(in + wallet_record_fixed(in), end, MAX_NAME_LENGTH);
+     if (!p) return 0;
+
+     u32 n = wallet_address_packed_size(p, end - p);
+     if (!n) return 0;
+     p += n;
+
+     p = skip_text(p, end, MAX_NOTES_LENGTH);
+     if (p) p = skip_text(p, end, MAX_TAGS_LENGTH);
+     return p ? p - in : 0;
+ }
+
+ /**
+  * @brief Read only the name of a record
+  */
+ bool wallet_record_name(const u8 *in, u32 len, char *name) {
+     if (len < 2 || wallet_record_fixed(in) > len) return false;
+
+     return get_text(in + wallet_record_fixed(in), in + len, name, MAX_NAME_LENGTH) != NULL;
+ }
+
+ /**
+  * @brief Find the name, notes and tags of a record in place
+  */
+ bool wallet_record_search_texts(const u8 *in, u32 len, const char **texts, u8 *lens) {
+     const u8 *end = in + len;
+     int found = 0;
+
+     if (len < 2 || wallet_record_fixed(in) > len) return false;
+
+     const u8 *p = in + wallet_record_fixed(in);
+     for (int f = 0; f < WALLET_TEXT_FIELD_COUNT && p; f++) {
+         if (f == 1) {
+             // The address is packed, and not searched
+             u32 n = wallet_address_packed_size(p, end - p);
+             p = n ? p + n : NULL;
+             continue;
+         }
+
+         const u8 *text = p;
+         p = skip_text(p, end, WALLET_TEXT_FIELDS[f].size);
+         if (p) {
+             texts[found] = (const char *)text + 1;
+             lens[found] = text[0];
+             found++;
+         }
+     }
+
+     return p != NULL;
+ }
+
+ /**
+  * @brief Fill an entry with the longest strings every field allows
+  */
+ void wallet_record_fill_max(WalletEntry *entry, int seed) {
+     memset(entry, 0, sizeof(WalletEntry));
+
+     entry->type_index = seed % CRYPTO_TYPE_COUNT;
+     entry->favorite = (seed & 1) != 0;
+     entry->balance = (u32)seed * 100000;
+     entry->last_used = seed;
+     for (int f = 0; f < WALLET_TEXT_FIELD_COUNT; f++) {
+         char *text = (char *)entry + WALLET_TEXT_FIELDS[f].offset;
+         memset(text, 'a' + (seed + f) % 26, WALLET_TEXT_FIELDS[f].size - 1);
+     }
+ }
+
+ /**
+  * @brief Fill an entry with a typical address book entry
+  */
+ void wallet_record_fill_sample(WalletEntry *entry, int seed) {
+     const WalletRecordSample *sample = &SAMPLES[seed % SAMPLE_COUNT];
+
+     memset(entry, 0, sizeof(WalletEntry));
+     entry->type_index = sample->type;
+     entry->favorite = (seed % 3) == 0;
+     entry->last_used = seed;
+     if (seed < (int)SAMPLE_COUNT) {
+         strcpy(entry->name, sample->name);
+     } else {
+         snprintf(entry->name, MAX_NAME_LENGTH, "%s %d", sample->name, seed / (int)SAMPLE_COUNT + 1);
+     }
+     strcpy(entry->address, sample->address);
+     strcpy(entry->notes, sample->notes);
+     strcpy(entry->tags, sample->tags);
+ }
+
+ /**
+  * @brief Record size with every fixed field present and the address as text
+  *
+  * Only a comparison for the benchmark; no record is stored this way.
+  */
+ static u32 wallet_record_legacy_size(const WalletEntry *entry) {
+     u32 size = WALLET_RECORD_FIXED;
+
+     for (int f = 0; f < WALLET_TEXT_FIELD_COUNT; f++) {
+         const char *text = (const char *)entry + WALLET_TEXT_FIELDS[f].offset;
+         size += 1 + strnlen(text, WALLET_TEXT_FIELDS[f].size - 1);
+     }
+
+     return size;
+ }
+
+ /**
+  * @brief Pack and expand the sample entries and compare the sizes of each form
+  */
+ bool wallet_record_benchmark(WalletRecordBenchmark *result) {
+     if (!result) return false;
+     memset(result, 0, sizeof(WalletRecordBenchmark));
+
+     u32 packed = 0, legacy = 0, address_packed = 0, address_text = 0;
+     u32 encode = 0, decode = 0, name = 0;
+     bool ok = true;
+
+     for (u32 i = 0; i < SAMPLE_COUNT; i++) {
+         WalletEntry entry, check;
+         u8 record[WALLET_RECORD_MAX];
+         char check_name[MAX_NAME_LENGTH];
+
+         wallet_record_fill_sample(&entry, i);
+
+         profile_start();
+         u32 len = wallet_record_encode(&entry, record);
+         encode += profile_stop();
+
+         memset(&check, 0, sizeof(check));
+         profile_start();
+         u32 used = wallet_record_decode(record, len, &check);
+         decode += profile_stop();
+
+         profile_start();
+         bool named = wallet_record_name(record, len, check_name);
+         name += profile_stop();
+
+         ok = ok && used == len && named && wallet_record_size(record, len) == len &&
+              memcmp(&entry, &check, sizeof(entry)) == 0 && strcmp(check_name, entry.name) == 0;
+
+         u8 address[WALLET_ADDRESS_PACKED_MAX];
+         packed += len;
+         legacy += wallet_record_legacy_size(&entry);
+         address_packed += wallet_address_pack(entry.address, address);
+         address_text += 1 + strlen(entry.address);
+     }
+
+     result->samples = SAMPLE_COUNT;
+     result->packed_avg = packed / SAMPLE_COUNT;
+     result->legacy_avg = legacy / SAMPLE_COUNT;
+     result->entry_bytes = sizeof(WalletEntry);
+     result->address_packed_avg = address_packed / SAMPLE_COUNT;
+     result->address_text_avg = address_text / SAMPLE_COUNT;
+     result->per_32k_entries = 0x8000 / sizeof(WalletEntry);
+     result->per_32k_legacy = 0x8000 * SAMPLE_COUNT / legacy;
+     result->per_32k_packed = 0x8000 * SAMPLE_COUNT / packed;
+     result->encode_cycles = encode / SAMPLE_COUNT;
+     result->decode_cycles = decode / SAMPLE_COUNT;
+     result->name_cycles = name / SAMPLE_COUNT;
+
+     LOG_INFO(MODULE_OPTIMIZE, "Record packed avg bytes", result->packed_avg);
+     LOG_INFO(MODULE_OPTIMIZE, "Record legacy avg bytes", result->legacy_avg);
+     LOG_INFO(MODULE_OPTIMIZE, "Address packed avg bytes", result->address_packed_avg);
+     LOG_INFO(MODULE_OPTIMIZE, "Entries per 32 KB (structs)", result->per_32k_entries);
+     LOG_INFO(MODULE_OPTIMIZE, "Entries per 32 KB (packed)", result->per_32k_packed);
+     LOG_INFO(MODULE_OPTIMIZE, "Record encode cycles", result->encode_cycles);
+     LOG_INFO(MODULE_OPTIMIZE, "Record decode cycles", result->decode_cycles);
+
+     if (!ok) {
+         LOG_ERROR(MODULE_OPTIMIZE, "Record round trip failed", 0);
+     }
+     return ok;
+ }
@@ -0,0 +1,160 @@
+/**
+ * @file wallet_record.h
+ * @brief Compact stored form of a wallet entry
+ *
+ * The same packed record is used by every save backend and by the wallet
+ * system in RAM, which expands a record into a WalletEntry only when the
+ * entry is displayed or edited.
+ *
+ * Record layout:
+ *   type u8, flags u8, balance u32 (WALLET_RECORD_BALANCE only),
+ *   last_used u32 (WALLET_RECORD_LAST_USED only), name, packed address
+ *   (see wallet_address.h), notes, tags
+ * Text fields are a length byte followed by the characters (no terminator).
+ *
+ * @author Claude
+ * @date October 2026
+ * @version 1.0.0
+ */
+
+ #ifndef WALLET_RECORD_H
+ #define WALLET_RECORD_H
+
+ #include <tonc.h>
+ #include "wallet_system.h"
+ #include "wallet_address.h"
+
+ /**
+  * Record sizes
+  */
+ #define WALLET_RECORD_FIXED     10          // type, flags, balance, last_used, all present
+ #define WALLET_RECORD_MAX       (WALLET_RECORD_FIXED + 3 + WALLET_ADDRESS_PACKED_MAX + \
+                                  (MAX_NAME_LENGTH - 1) + (MAX_NOTES_LENGTH - 1) + \
+                                  (MAX_TAGS_LENGTH - 1))
+ #define WALLET_RECORD_MIN       6           // type, flags, empty name, address, notes, tags
+
+ /**
+  * Record flags
+  */
+ #define WALLET_RECORD_FAVORITE  0x01
+ #define WALLET_RECORD_BALANCE   0x02        // Balance field present
+ #define WALLET_RECORD_LAST_USED 0x04        // Last-used field present
+
+ /**
+  * Wallet flags, stored once per save
+  */
+ #define WALLET_SAVE_ENCRYPTED   0x01
+
+ /**
+  * Text fields of a record, in stored order
+  */
+ typedef struct {
+     u16 offset;                 // Offset in WalletEntry
+     u8 size;                    // Array size, including the terminator
+ } WalletTextField;
+
+ #define WALLET_TEXT_FIELD_COUNT 4
+ #define WALLET_SEARCH_TEXT_COUNT 3          // Name, notes and tags; not the address
+
+ extern const WalletTextField WALLET_TEXT_FIELDS[WALLET_TEXT_FIELD_COUNT];
+
+ /**
+  * Sizes of a set of sample entries in each form, and packing speed
+  */
+ typedef struct {
+     u32 samples;                // Sample entries packed
+     u32 packed_avg;             // Average compact record, bytes
+     u32 legacy_avg;             // Average record with every fixed field and a text address
+     u32 entry_bytes;            // sizeof(WalletEntry)
+     u32 address_packed_avg;     // Average packed address
+     u32 address_text_avg;       // Average address as text
+     u32 per_32k_entries;        // Entries per 32 KB as WalletEntry structs
+     u32 per_32k_legacy;         // ... as such uncompacted records
+     u32 per_32k_packed;         // ... as compact records
+     u32 encode_cycles;          // Average encode
+     u32 decode_cycles;          // Average full expansion
+     u32 name_cycles;            // Average name-only read
+ } WalletRecordBenchmark;
+
+ /**
+  * Encode an entry as a compact record
+  * @param entry Entry to encode
+  * @param out Output buffer of at least WALLET_RECORD_MAX bytes
+  * @return Bytes written
+  */
+ u32 wallet_record_encode(const WalletEntry *entry, u8 *out);
+
+ /**
+  * Decode a record into an entry
+  * Every length is checked against the array it goes into and against
+  * the end of the buffer before anything is copied
+  * @param in Record bytes
+  * @param len Bytes available
+  * @param entry Entry to fill
+  * @return Bytes consumed, or 0 if the record is damaged
+  */
+ u32 wallet_record_decode(const u8 *in, u32 len, WalletEntry *entry);
+
+ /**
+  * Check a record's structure without expanding it
+  * @param in Record bytes
+  * @param len Bytes available
+  * @return Bytes the record takes, or 0 if it is damaged
+  */
+ u32 wallet_record_size(const u8 *in, u32 len);
+
+ /**
+  * Read only the name of a record
+  * @param in Record bytes
+  * @param len Bytes available
+  * @param name Output of MAX_NAME_LENGTH characters (NUL-terminated)
+  * @return False if the record is damaged
+  */
+ bool wallet_record_name(const u8 *in, u32 len, char *name);
+
+ /**
+  * Find the texts a search looks at (name, notes, tags) in place
+  * @param in Record bytes
+  * @param len Bytes available
+  * @param texts Output: start of each text, not NUL-terminated
+  * @param lens Output: length of each text
+  * @return False if the record is damaged
+  */
+ bool wallet_record_search_texts(const u8 *in, u32 len, const char **texts, u8 *lens);
+
+ /**
+  * Type and favorite flag sit at the start of every record
+  */
+ static inline u8 wallet_record_type(const u8 *in) {
+     return in[0];
+ }
+
+ static inline bool wallet_record_favorite(const u8 *in) {
+     return (in[1] & WALLET_RECORD_FAVORITE) != 0;
+ }
+
+ /**
+  * Fill an entry with the longest strings every field allows
+  * Used by the storage benchmarks for worst-case records
+  * @param entry Entry to fill
+  * @param seed Varies the contents between entries
+  */
+ void wallet_record_fill_max(WalletEntry *entry, int seed);
+
+ /**
+  * Fill an entry with a typical address book entry
+  * Used by the benchmarks; the samples cycle through hex, base58 and
+  * bech32 addresses of the supported coins
+  * @param entry Entry to fill
+  * @param seed Picks and varies the sample
+  */
+ void wallet_record_fill_sample(WalletEntry *entry, int seed);
+
+ /**
+  * Pack and expand the sample entries and compare the sizes of each form
+  * @param result Output sizes and timings
+  * @return Success status (every sample expanded back unchanged)
+  */
+ bool wallet_record_benchmark(WalletRecordBenchmark *result);
+
+ #endif // WALLET_RECORD_H
@@ -0,0 +1,315 @@
+/**
+ * @file wallet_search.c
+ * @brief Incremental text search over wallet names, notes and tags
+ *
+ * The character classes only narrow the candidates: an entry with every
+ * character of the query somewhere in it is still checked against the
+ * query itself, straight from its packed record. Only a first character
+ * that is a letter or digit needs no check, since its class is exactly
+ * the entries that hold it.
+ *
+ * Bits at and past the wallet's entry count are kept clear in every set,
+ * so a set's pop count over all its words is its size.
+ *
+ * @author Claude
+ * @date October 2026
+ * @version 1.0.0
+ */
+
+ #include <tonc.h>
+ #include <stdio.h>
+ #include <string.h>
+ #include "wallet_search.h"
+ #include "wallet_record.h"
+ #include "memory_system.h"
+ #include "qr_debug.h"
+
+ #define WALLET_SEARCH_OTHER         36          // Class of anything not a letter or digit
+
+ // Benchmark book; short entries, so a thousand fit in the shared scratch
+ #define WALLET_SEARCH_BENCH_ENTRIES 1000
+ #define WALLET_SEARCH_BENCH_QUERY   "donat"
+
+ static inline char search_fold(char c) {
+     return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+ }
+
+ static inline u32 search_class(char c) {
+     c = search_fold(c);
+     if (c >= 'a' && c <= 'z') return c - 'a';
+     if (c >= '0' && c <= '9') return 26 + c - '0';
+     return WALLET_SEARCH_OTHER;
+ }
+
+ /**
+  * @brief Check whether an entry matches the first len characters of the query
+  */
+ static bool search_matches(const WalletSearch *search, int index, int len) {
+     const char *texts[WALLET_SEARCH_TEXT_COUNT];
+     u8 lens[WALLET_SEARCH_TEXT_COUNT];
+     u32 size;
+     const u8 *record = wallet_book_record(search->wallet, index, &size);
+
+     if (!record || !wallet_record_search_texts(record, size, texts, lens)) return false;
+
+     for (int t = 0; t < WALLET_SEARCH_TEXT_COUNT; t++) {
+         for (int start = 0; start + len <= lens[t]; start++) {
+             int k = 0;
+             while (k < len && search_fold(texts[t][start + k]) == search->query[k]) k++;
+             if (k == len) return true;
+         }
+     }
+
+     return false;
+ }
+
+ /**
+  * @brief Set an entry's bit in the class of every character it holds
+  */
+ static void search_index_entry(WalletSearch *search, int index) {
+     const char *texts[WALLET_SEARCH_TEXT_COUNT];
+     u8 lens[WALLET_SEARCH_TEXT_COUNT];
+     u32 size;
+     const u8 *record = wallet_book_record(search->wallet, index, &size);
+
+     if (!record || !wallet_record_search_texts(record, size, texts, lens)) return;
+
+     for (int t = 0; t < WALLET_SEARCH_TEXT_COUNT; t++) {
+         for (int i = 0; i < lens[t]; i++) {
+             bitset_set(search->class_set[search_class(texts[t][i])], index);
+         }
+     }
+ }
+
+ /**
+  * @brief Index every entry of a wallet and start with an empty query
+  */
+ void wallet_search_init(WalletSearch *search, WalletSystem *wallet) {
+     memset(search, 0, sizeof(WalletSearch));
+     search->wallet = wallet;
+     wallet->search_set = NULL;
+
+     for (int i = 0; i < wallet->count; i++) {
+         search_index_entry(search, i);
+     }
+ }
+
+ /**
+  * @brief Index an entry that was added or updated
+  *
+  * The entry is checked again against each prefix of the query; once it
+  * fails one, it fails every longer one.
+  */
+ void wallet_search_entry_changed(WalletSearch *search, int index) {
+     if (index < 0 || index >= search->wallet->count) return;
+
+     for (int c = 0; c < WALLET_SEARCH_CLASSES; c++) {
+         bitset_clear(search->class_set[c], index);
+     }
+     search_index_entry(search, index);
+
+     bool match = true;
+     for (int level = 0; level < search->length; level++) {
+         match = match && search_matches(search, index, level + 1);
+         if (match != bitset_test(search->result[level], index)) {
+             if (match) {
+                 bitset_set(search->result[level], index);
+                 search->result_count[level]++;
+             } else {
+                 bitset_clear(search->result[level], index);
+                 search->result_count[level]--;
+             }
+         }
+     }
+ }
+
+ /**
+  * @brief Record that an entry was removed and the entries after it moved down
+  */
+ void wallet_search_entry_removed(WalletSearch *search, int index) {
+     u32 bits = search->wallet->count + 1;
+
+     if (index < 0 || (u32)index >= bits) return;
+
+     for (int c = 0; c < WALLET_SEARCH_CLASSES; c++) {
+         bitset_remove(search->class_set[c], bits, index);
+     }
+     for (int level = 0; level < search->length; level++) {
+         if (bitset_test(search->result[level], index)) {
+             search->result_count[level]--;
+         }
+         bitset_remove(search->result[level], bits, index);
+     }
+ }
+
+ /**
+  * @brief Add a character to the query and narrow the results
+  *
+  * The candidates are the previous results that hold the character;
+  * only they are read.
+  */
+ bool wallet_search_refine(WalletSearch *search, char c) {
+     WalletSystem *wallet = search->wallet;
+     int level = search->length;
+
+     if (level >= WALLET_SEARCH_MAX) return false;
+
+     u32 cls = search_class(c);
+     const u32 *prev = level ? search->result[level - 1] : NULL;
+     u32 *out = search->result[level];
+     bool exact = level == 0 && cls != WALLET_SEARCH_OTHER;
+     u32 count = 0;
+
+     search->query[level] = search_fold(c);
+     search->query[level + 1] = '\0';
+     search->length++;
+
+     for (u32 w = 0; w < WALLET_SEARCH_WORDS; w++) {
+         u32 word = search->class_set[cls][w];
+         if (prev) word &= prev[w];
+
+         if (!exact) {
+             for (u32 candidates = word; candidates; candidates &= candidates - 1) {
+                 u32 bit = __builtin_ctz(candidates);
+                 if (!search_matches(search, w * 32 + bit, level + 1)) {
+                     word &= ~(1u << bit);
+                 }
+             }
+         }
+
+         out[w] = word;
+         count += __builtin_popcount(word);
+     }
+
+     search->result_count[level] = count;
+     wallet->search_set = out;
+     return true;
+ }
+
+ /**
+  * @brief Drop the last character of the query
+  */
+ void wallet_search_widen(WalletSearch *search) {
+     if (search->length == 0) return;
+
+     search->length--;
+     search->query[search->length] = '\0';
+     search->wallet->search_set = search->length ? search->result[search->length - 1] : NULL;
+ }
+
+ /**
+  * @brief Empty the query
+  */
+ void wallet_search_reset(WalletSearch *search) {
+     search->length = 0;
+     search->query[0] = '\0';
+     search->wallet->search_set = NULL;
+ }
+
+ /**
+  * @brief Count the entries the query matches
+  */
+ int wallet_search_count(const WalletSearch *search) {
+     return search->length ? search->result_count[search->length - 1] : search->wallet->count;
+ }
+
+ /**
+  * @brief Fill a short benchmark entry with notes and tags to search
+  */
+ static void search_bench_fill(WalletEntry *entry, u32 seed) {
+     static const char *const NOTES[] = {
+         "Savings", "Exchange deposit", "Donations", "Paper backup",
+         "Cold storage", "Mining payouts", "Shared with family", ""
+     };
+     static const char *const TAGS[] = { "cold", "hot", "btc", "eth,cold", "" };
+
+     memset(entry, 0, sizeof(WalletEntry));
+     snprintf(entry->name, sizeof(entry->name), "Acct %lu", (unsigned long)seed);
+     strcpy(entry->notes, NOTES[seed % 8]);
+     strcpy(entry->tags, TAGS[(seed / 8) % 5]);
+     entry->type_index = seed % CRYPTO_TYPE_COUNT;
+ }
+
+ /**
+  * @brief Time indexing a thousand entries and typing a query into them
+  *
+  * The rescan checks every entry against the whole query, which is what
+  * each keystroke would cost without the index.
+  */
+ bool wallet_search_benchmark(WalletSearchBenchmark *result) {
+     if (!result) return false;
+     memset(result, 0, sizeof(WalletSearchBenchmark));
+
+     u8 *heap = mem_scratch_acquire(MEM_SCRATCH_SIZE, "wallet search benchmark");
+     if (!heap) {
+         LOG_ERROR(MODULE_OPTIMIZE, "Shared scratch busy", 0);
+         return false;
+     }
+
+     u32 mark = mem_arena_mark(&g_mem_frame);
+     WalletSystem *book = mem_arena_alloc(&g_mem_frame, sizeof(WalletSystem));
+     WalletSearch *search = mem_arena_alloc(&g_mem_frame, sizeof(WalletSearch));
+     bool ok = book && search;
+
+     if (ok) {
+         wallet_book_init(book, heap, MEM_SCRATCH_SIZE);
+         for (int i = 0; i < WALLET_SEARCH_BENCH_ENTRIES && ok; i++) {
+             WalletEntry entry;
+             search_bench_fill(&entry, i);
+             ok = wallet_book_put(book, i, &entry);
+         }
+         result->entries = book->count;
+
+         profile_start();
+         wallet_search_init(search, book);
+         result->index_cycles = profile_stop();
+
+         const char *query = WALLET_SEARCH_BENCH_QUERY;
+         int keys = strlen(query);
+         u64 total = 0;
+
+         profile_start();
+         wallet_search_refine(search, query[0]);
+         result->first_key_cycles = profile_stop();
+
+         for (int k = 1; k < keys; k++) {
+             profile_start();
+             wallet_search_refine(search, query[k]);
+             u32 cycles = profile_stop();
+             total += cycles;
+             if (cycles > result->key_max_cycles) result->key_max_cycles = cycles;
+         }
+         result->key_avg_cycles = keys > 1 ? total / (keys - 1) : 0;
+         result->results = wallet_search_count(search);
+
+         u32 found = 0;
+         profile_start();
+         for (int i = 0; i < book->count; i++) {
+             found += search_matches(search, i, keys);
+         }
+         result->rescan_cycles = profile_stop();
+         ok = ok && found == result->results && found > 0;
+
+         profile_start();
+         wallet_search_widen(search);
+         result->erase_cycles = profile_stop();
+         ok = ok && book->search_set == search->result[keys - 2];
+     }
+
+     mem_arena_release(&g_mem_frame, mark);
+     mem_scratch_release(heap);
+
+     LOG_INFO(MODULE_OPTIMIZE, "Search entries", result->entries);
+     LOG_INFO(MODULE_OPTIMIZE, "Search index cycles", result->index_cycles);
+     LOG_INFO(MODULE_OPTIMIZE, "Search first key cycles", result->first_key_cycles);
+     LOG_INFO(MODULE_OPTIMIZE, "Search key avg cycles", result->key_avg_cycles);
+     LOG_INFO(MODULE_OPTIMIZE, "Search key max cycles", result->key_max_cycles);
+     LOG_INFO(MODULE_OPTIMIZE, "Search erase cycles", result->erase_cycles);
+     LOG_INFO(MODULE_OPTIMIZE, "Search rescan cycles", result->rescan_cycles);
+     LOG_INFO(MODULE_OPTIMIZE, "Search results", result->results);
+
+     if (!ok) {
+         LOG_ERROR(MODULE_OPTIMIZE, "Search benchmark failed", result->entries);
+     }
+     return ok;
+ }
@@ -0,0 +1,109 @@
+/**
+ * @file wallet_search.h
+ * @brief Incremental text search over wallet names, notes and tags
+ *
+ * The index keeps a bit set over list positions for each character
+ * class (a-z and 0-9 with case folded, plus one class for everything
+ * else): bit i of a class is set if entry i's name, notes or tags holds
+ * such a character. Edits update it through the same hooks the save
+ * backends get.
+ *
+ * The results for every prefix of the query are kept as bit sets too.
+ * Typing a character narrows the previous results to the entries with
+ * that character, then checks only those against the whole query, so a
+ * keystroke costs in proportion to the results; erasing one returns the
+ * kept set. Matching is a case-insensitive substring of any one field.
+ *
+ * @author Claude
+ * @date October 2026
+ * @version 1.0.0
+ */
+
+ #ifndef WALLET_SEARCH_H
+ #define WALLET_SEARCH_H
+
+ #include <tonc.h>
+ #include "wallet_system.h"
+ #include "bitset.h"
+
+ #define WALLET_SEARCH_MAX           16          // Query characters
+ #define WALLET_SEARCH_CLASSES       37          // a-z, 0-9, anything else
+ #define WALLET_SEARCH_WORDS         BITSET_WORDS(MAX_WALLET_ENTRIES)
+
+ /**
+  * Search index and query of one wallet
+  */
+ typedef struct {
+     WalletSystem *wallet;                                   // Wallet searched
+     u32 class_set[WALLET_SEARCH_CLASSES][WALLET_SEARCH_WORDS]; // Entries holding each class
+     u32 result[WALLET_SEARCH_MAX][WALLET_SEARCH_WORDS];     // Matches of each query prefix
+     u16 result_count[WALLET_SEARCH_MAX];                    // Entries in each
+     char query[WALLET_SEARCH_MAX + 1];                      // Query, case folded
+     u8 length;                                              // Characters in the query
+ } WalletSearch;
+
+ /**
+  * Timings of a search over a thousand entries
+  */
+ typedef struct {
+     u32 entries;                // Entries in the book
+     u32 index_cycles;           // Indexing every entry
+     u32 first_key_cycles;       // Typing the first character of the query
+     u32 key_avg_cycles;         // Typing each later character
+     u32 key_max_cycles;
+     u32 erase_cycles;           // Erasing the last character
+     u32 rescan_cycles;          // Checking every entry against the whole query
+     u32 results;                // Entries the whole query matches
+ } WalletSearchBenchmark;
+
+ /**
+  * Index every entry of a wallet and start with an empty query
+  * Call again after the wallet is loaded or cleared
+  * @param search Search to set up
+  * @param wallet Wallet to search; its filtered list follows the results
+  */
+ void wallet_search_init(WalletSearch *search, WalletSystem *wallet);
+
+ /**
+  * Index an entry that was added or updated
+  */
+ void wallet_search_entry_changed(WalletSearch *search, int index);
+
+ /**
+  * Record that an entry was removed and the entries after it moved down
+  */
+ void wallet_search_entry_removed(WalletSearch *search, int index);
+
+ /**
+  * Add a character to the query and narrow the results
+  * @param search Search
+  * @param c Character typed
+  * @return False if the query is already WALLET_SEARCH_MAX long
+  */
+ bool wallet_search_refine(WalletSearch *search, char c);
+
+ /**
+  * Drop the last character of the query
+  */
+ void wallet_search_widen(WalletSearch *search);
+
+ /**
+  * Empty the query, so every entry matches
+  */
+ void wallet_search_reset(WalletSearch *search);
+
+ /**
+  * Count the entries the query matches
+  * @return Matches, or the wallet's entry count for an empty query
+  */
+ int wallet_search_count(const WalletSearch *search);
+
+ /**
+  * Time indexing a thousand entries and typing a query into them
+  * Uses its own book on the shared scratch; the wallet is not touched
+  * @param result Output timings
+  * @return Success status
+  */
+ bool wallet_search_benchmark(WalletSearchBenchmark *result);
+
+ #endif // WALLET_SEARCH_H
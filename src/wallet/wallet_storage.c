@@ -0,0 +1,647 @@
+/**
+ * @file wallet_storage.c
+ * @brief Wallet persistence on the cartridge save chip
+ *
+ * All chip access goes through save_media.h, so the same store runs on
+ * SRAM (from WALLET_STORE_OFFSET up to the settings area) and on 8 KB
+ * EEPROM (from the start of the chip). Carts with a flash chip save
+ * through the log store in wallet_log.c behind the same API; 512-byte
+ * EEPROM is too small for a wallet.
+ *
+ * The wallet keeps its entries as packed records in RAM, so saving
+ * writes those bytes as they are and loading copies them back after
+ * checking them; nothing is encoded or expanded on the way.
+ *
+ * Saving writes as little as possible, because every byte costs a slow
+ * chip access and a longer window for power loss:
+ * - entries track a dirty bit; only dirty entries are written
+ * - a dirty entry is appended after the bytes the committed header uses,
+ *   never over them, so the committed state stays intact
+ * - when the half runs out, every entry is written compacted into the
+ *   other half, which the committed header does not use
+ * - removing an entry only shifts the offset map; no record is rewritten
+ * - the new header goes over the older of the two header copies; load
+ *   takes the newest copy whose CRC and records check out
+ * The wallet's record limit keeps a compacted copy of every entry within
+ * one half, so a save always has somewhere to go.
+ *
+ * Store layout (all values little-endian):
+ *   half 0, half 1       records, see below
+ *   header A, header B   WALLET_HEADER_SLOT_BYTES each, see WalletSaveHeader
+ *   record               length u16, packed record, CRC-32 of both
+ *
+ * @author Claude
+ * @date October 2026
+ * @version 1.0.0
+ */
+
+ #include <tonc.h>
+ #include <string.h>
+ #include "wallet_storage.h"
+ #include "wallet_log.h"
+ #include "save_media.h"
+ #include "crc32.h"
+ #include "memory_system.h"
+ #include "qr_debug.h"
+
+ // CPU cycles per frame (228 lines of 1232 cycles)
+ #define WALLET_CYCLES_PER_FRAME     280896
+
+ static inline void put_u16(u8 *p, u16 value) {
+     p[0] = value;
+     p[1] = value >> 8;
+ }
+
+ static inline void put_u32(u8 *p, u32 value) {
+     p[0] = value;
+     p[1] = value >> 8;
+     p[2] = value >> 16;
+     p[3] = value >> 24;
+ }
+
+ static inline u16 get_u16(const u8 *p) {
+     return p[0] | (p[1] << 8);
+ }
+
+ static inline u32 get_u32(const u8 *p) {
+     return p[0] | (p[1] << 8) | (p[2] << 16) | ((u32)p[3] << 24);
+ }
+
+ /**
+  * Save state of one store area
+  */
+ typedef struct {
+     u32 base;                                   // Save space offset of the store
+     u16 half_bytes;                             // Size of each record half (0 = no store)
+     bool committed;                             // A valid header exists
+     u8 active_header;                           // Header copy holding the committed state
+     u32 sequence;                               // Newest header sequence seen
+     u16 count;                                  // Committed entry count
+     u8 flags;                                   // Committed header flags
+     u16 password_hash;                          // Committed password hash
+     u8 half;                                    // Half the committed records are in
+     u16 end;                                    // Bytes of that half the committed header uses
+     u16 offset[WALLET_STORE_ENTRIES];           // Record offset of each current entry
+     u32 dirty[BITSET_WORDS(WALLET_STORE_ENTRIES)];// Entries changed since the commit
+     bool map_changed;                           // Entries removed since the commit
+ } WalletStore;
+
+ static WalletStore s_store;
+
+ /**
+  * Flash carts keep the wallet in a log instead (see wallet_log.h)
+  */
+ static WalletLog s_log;
+ static bool s_use_log;
+
+ static inline u32 wallet_half_offset(const WalletStore *store, int half) {
+     return store->base + half * store->half_bytes;
+ }
+
+ static inline u32 wallet_header_offset(const WalletStore *store, int copy) {
+     return store->base + 2 * store->half_bytes + copy * WALLET_HEADER_SLOT_BYTES;
+ }
+
+ /**
+  * @brief Limit a wallet to what fits in one half, so a save can always compact
+  */
+ static inline void wallet_store_set_limits(const WalletStore *store, WalletSystem *wallet) {
+     wallet->record_limit = store->half_bytes;
+     wallet->record_overhead = WALLET_RECORD_OVERHEAD;
+     wallet->entry_limit = WALLET_STORE_ENTRIES;
+ }
+
+ /**
+  * @brief Set up an empty store on a region of the save space
+  */
+ static void wallet_store_init(WalletStore *store, u32 base, u32 bytes) {
+     memset(store, 0, sizeof(WalletStore));
+     store->base = base;
+     store->half_bytes = bytes > 2 * WALLET_HEADER_SLOT_BYTES ? WALLET_STORE_HALF(bytes) : 0;
+ }
+
+ /**
+  * @brief Encode a header into its stored form (CRC included)
+  */
+ static void wallet_header_encode(WalletSaveHeader *header, u8 *out) {
+     put_u32(out, header->magic);
+     out[4] = header->version;
+     out[5] = header->flags;
+     put_u16(out + 6, header->count);
+     put_u16(out + 8, header->password_hash);
+     out[10] = header->half;
+     out[11] = header->reserved;
+     put_u32(out + 12, header->sequence);
+     put_u16(out + 16, header->end);
+     put_u16(out + 18, header->reserved2);
+     for (int i = 0; i < WALLET_STORE_ENTRIES; i++) {
+         put_u16(out + 20 + i * 2, header->offset[i]);
+     }
+
+     header->crc = crc32(out, WALLET_HEADER_CRC_BYTES);
+     put_u32(out + WALLET_HEADER_CRC_BYTES, header->crc);
+ }
+
+ /**
+  * @brief Decode and check a stored header
+  *
+  * @param half_bytes Size of the store's halves; a header pointing past one is damaged
+  * @return False if the header is missing, damaged or not the current version
+  */
+ static bool wallet_header_decode(const u8 *in, u32 half_bytes, WalletSaveHeader *header) {
+     header->magic = get_u32(in);
+     header->version = in[4];
+     if (header->magic != WALLET_SAVE_MAGIC || header->version != WALLET_SAVE_VERSION) {
+         return false;
+     }
+
+     header->crc = get_u32(in + WALLET_HEADER_CRC_BYTES);
+     if (crc32(in, WALLET_HEADER_CRC_BYTES) != header->crc) {
+         return false;
+     }
+
+     header->flags = in[5];
+     header->count = get_u16(in + 6);
+     header->password_hash = get_u16(in + 8);
+     header->half = in[10];
+     header->reserved = in[11];
+     header->sequence = get_u32(in + 12);
+     header->end = get_u16(in + 16);
+     header->reserved2 = get_u16(in + 18);
+     if (header->count > WALLET_STORE_ENTRIES || header->half > 1 || header->end > half_bytes) {
+         return false;
+     }
+
+     for (int i = 0; i < WALLET_STORE_ENTRIES; i++) {
+         header->offset[i] = get_u16(in + 20 + i * 2);
+         if (i < header->count && header->offset[i] + WALLET_RECORD_OVERHEAD > header->end) {
+             return false;
+         }
+     }
+
+     return true;
+ }
+
+ /**
+  * @brief Read one stored record into the wallet's record heap
+  *
+  * @param src Save space offset of the record
+  * @param end Offset the record must not extend past
+  * @return False if the record is damaged or fails its CRC
+  */
+ static bool wallet_record_load(u32 src, u32 end, WalletSystem *wallet) {
+     u8 record[WALLET_RECORD_MAX + WALLET_RECORD_OVERHEAD];
+
+     if (src + WALLET_RECORD_OVERHEAD > end || !save_media_read(src, record, 2)) return false;
+
+     u32 len = get_u16(record);
+     if (len > WALLET_RECORD_MAX || src + len + WALLET_RECORD_OVERHEAD > end ||
+         !save_media_read(src + 2, record + 2, len + 4)) {
+         return false;
+     }
+
+     return crc32(record, 2 + len) == get_u32(record + 2 + len) &&
+            wallet_book_load_record(wallet, record + 2, len);
+ }
+
+ /**
+  * @brief Read the entries a header points to
+  *
+  * @return False if any record is damaged or fails its CRC
+  */
+ static bool wallet_store_read_records(const WalletStore *store, const WalletSaveHeader *header,
+                                       WalletSystem *wallet) {
+     u32 half = wallet_half_offset(store, header->half);
+
+     wallet_book_clear(wallet);
+     for (int i = 0; i < header->count; i++) {
+         if (!wallet_record_load(half + header->offset[i], half + header->end, wallet)) {
+             LOG_ERROR(MODULE_WALLET, "Wallet record corrupt", i);
+             return false;
+         }
+     }
+
+     return true;
+ }
+
+ /**
+  * @brief Load a store into a wallet
+  *
+  * Tries the newest valid header first and falls back to the other copy
+  * if its records do not check out (a save never overwrites records the
+  * newest header uses, but a worn or corrupted byte can).
+  *
+  * @return False if neither header leads to a valid wallet
+  */
+ static bool wallet_store_load(WalletStore *store, WalletSystem *wallet) {
+     WalletSaveHeader headers[2];
+     bool valid[2];
+     u8 raw[WALLET_HEADER_BYTES];
+
+     u32 base = store->base;
+     u16 half_bytes = store->half_bytes;
+     memset(store, 0, sizeof(WalletStore));
+     store->base = base;
+     store->half_bytes = half_bytes;
+
+     wallet_book_clear(wallet);
+     wallet->selected_index = -1;
+
+     for (int copy = 0; copy < 2; copy++) {
+         valid[copy] = save_media_read(wallet_header_offset(store, copy), raw, WALLET_HEADER_BYTES) &&
+                       wallet_header_decode(raw, half_bytes, &headers[copy]);
+
+         // New headers must be newer than anything found, even if unusable
+         if (valid[copy] && (s32)(headers[copy].sequence - store->sequence) > 0) {
+             store->sequence = headers[copy].sequence;
+         }
+     }
+
+     int first = 0;
+     if (valid[0] && valid[1]) {
+         first = (s32)(headers[1].sequence - headers[0].sequence) > 0 ? 1 : 0;
+     } else if (valid[1]) {
+         first = 1;
+     }
+
+     for (int attempt = 0; attempt < 2; attempt++) {
+         int copy = attempt == 0 ? first : first ^ 1;
+         const WalletSaveHeader *header = &headers[copy];
+
+         if (!valid[copy] || !wallet_store_read_records(store, header, wallet)) continue;
+
+         store->committed = true;
+         store->active_header = copy;
+         store->count = header->count;
+         store->flags = header->flags;
+         store->password_hash = header->password_hash;
+         store->half = header->half;
+         store->end = header->end;
+         memcpy(store->offset, header->offset, sizeof(store->offset));
+
+         wallet->selected_index = header->count > 0 ? 0 : -1;
+         wallet->is_encrypted = (header->flags & WALLET_SAVE_ENCRYPTED) != 0;
+         wallet->password_hash = header->password_hash;
+         return true;
+     }
+
+     wallet_book_clear(wallet);
+     return false;
+ }
+
+ /**
+  * @brief Write records to a half
+  *
+  * @param all Write every entry, not just the dirty ones
+  * @param offset Record offset of each entry, updated for those written
+  * @param pos In: offset in the half to start at; out: offset after the last record
+  * @return False if the chip failed
+  */
+ static bool wallet_store_write_records(const WalletStore *store, const WalletSystem *wallet,
+                                        int half, bool all, u16 *offset, u32 *pos) {
+     u8 record[WALLET_RECORD_MAX + WALLET_RECORD_OVERHEAD];
+
+     for (int i = 0; i < wallet->count; i++) {
+         if (!all && !bitset_test(store->dirty, i)) continue;
+
+         u32 len;
+         const u8 *packed = wallet_book_record(wallet, i, &len);
+
+         put_u16(record, len);
+         memcpy(record + 2, packed, len);
+         put_u32(record + 2 + len, crc32(record, 2 + len));
+
+         if (!save_media_write(wallet_half_offset(store, half) + *pos, record,
+                               len + WALLET_RECORD_OVERHEAD)) {
+             return false;
+         }
+         offset[i] = *pos;
+         *pos += len + WALLET_RECORD_OVERHEAD;
+     }
+
+     return true;
+ }
+
+ /**
+  * @brief Write the changed entries of a wallet and commit a new header
+  *
+  * @param store Store to write
+  * @param wallet Wallet to save
+  * @param bytes_written Output: bytes written to the chip (may be NULL)
+  * @return False if the wallet does not fit or the chip failed
+  */
+ static bool wallet_store_commit(WalletStore *store, const WalletSystem *wallet,
+                                 u32 *bytes_written) {
+     int count = wallet->count;
+     u8 flags = wallet->is_encrypted ? WALLET_SAVE_ENCRYPTED : 0;
+
+     if (bytes_written) *bytes_written = 0;
+
+     if (store->committed && !bitset_any_first(store->dirty, count) && !store->map_changed &&
+         count == store->count && flags == store->flags &&
+         wallet->password_hash == store->password_hash) {
+         return true;
+     }
+
+     if (count > WALLET_STORE_ENTRIES) {
+         LOG_ERROR(MODULE_WALLET, "Too many entries for save chip", count);
+         return false;
+     }
+
+     u32 append = 0;
+     for (int i = 0; i < count; i++) {
+         if (bitset_test(store->dirty, i)) {
+             u32 len;
+             wallet_book_record(wallet, i, &len);
+             append += len + WALLET_RECORD_OVERHEAD;
+         }
+     }
+
+     // Append after the committed records, or compact into the other half
+     int half = store->half;
+     u32 pos = store->end;
+     bool compact = !store->committed || store->end + append > store->half_bytes;
+     if (compact) {
+         half = store->committed ? store->half ^ 1 : 0;
+         pos = 0;
+         if (wallet->record_bytes + count * WALLET_RECORD_OVERHEAD > store->half_bytes) {
+             LOG_ERROR(MODULE_WALLET, "Wallet too big for save chip", wallet->record_bytes);
+             return false;
+         }
+     }
+
+     // Offsets only take effect with the header, so a failed save changes nothing
+     u16 offset[WALLET_STORE_ENTRIES];
+     memcpy(offset, store->offset, sizeof(offset));
+
+     u32 start = pos;
+     if (!wallet_store_write_records(store, wallet, half, compact, offset, &pos)) {
+         return false;
+     }
+     u32 written = pos - start;
+
+     WalletSaveHeader header;
+     memset(&header, 0, sizeof(header));
+     header.magic = WALLET_SAVE_MAGIC;
+     header.version = WALLET_SAVE_VERSION;
+     header.flags = flags;
+     header.count = count;
+     header.password_hash = wallet->password_hash;
+     header.half = half;
+     header.sequence = store->sequence + 1;
+     header.end = pos;
+     memcpy(header.offset, offset, count * sizeof(u16));
+
+     u8 raw[WALLET_HEADER_BYTES];
+     wallet_header_encode(&header, raw);
+
+     int copy = store->committed ? store->active_header ^ 1 : 0;
+     if (!save_media_write(wallet_header_offset(store, copy), raw, WALLET_HEADER_BYTES) ||
+         !save_media_commit()) {
+         return false;
+     }
+     written += WALLET_HEADER_BYTES;
+
+     store->committed = true;
+     store->active_header = copy;
+     store->sequence = header.sequence;
+     store->count = count;
+     store->flags = flags;
+     store->password_hash = wallet->password_hash;
+     store->half = half;
+     store->end = pos;
+     memcpy(store->offset, offset, sizeof(store->offset));
+     bitset_clear_all(store->dirty, WALLET_STORE_ENTRIES);
+     store->map_changed = false;
+
+     if (bytes_written) *bytes_written = written;
+     return true;
+ }
+
+ /**
+  * @brief Place the store on the detected chip
+  *
+  * @return False if the chip cannot hold a wallet
+  */
+ static bool wallet_store_place(WalletStore *store) {
+     switch (save_media_type()) {
+     case SAVE_MEDIA_SRAM:
+         wallet_store_init(store, WALLET_STORE_OFFSET,
+                           save_media_settings_offset() - WALLET_STORE_OFFSET);
+         return true;
+
+     case SAVE_MEDIA_EEPROM_8K:
+         wallet_store_init(store, 0, save_media_settings_offset());
+         return store->half_bytes > WALLET_RECORD_OVERHEAD + WALLET_RECORD_MAX;
+
+     default:
+         return false;
+     }
+ }
+
+ /**
+  * @brief Load the wallet from the save chip into the wallet system
+  */
+ bool wallet_storage_load(WalletSystem *wallet) {
+     if (!wallet) return false;
+
+     FlashDevice *flash = save_media_flash();
+     if (flash) {
+         s_use_log = true;
+         return wallet_log_open(&s_log, flash, flash->sector_count - SAVE_MEDIA_FLASH_SECTORS, wallet);
+     }
+
+     s_use_log = false;
+     if (!wallet_store_place(&s_store)) {
+         s_store.half_bytes = 0;
+         wallet_book_clear(wallet);
+         wallet->selected_index = -1;
+         LOG_WARNING(MODULE_WALLET, "Save chip cannot hold a wallet", save_media_type());
+         return false;
+     }
+
+     wallet_store_set_limits(&s_store, wallet);
+
+     if (wallet_store_load(&s_store, wallet)) {
+         LOG_INFO(MODULE_WALLET, "Wallet save loaded", wallet->count);
+         return true;
+     }
+
+     wallet_book_clear(wallet);
+     wallet->selected_index = -1;
+     LOG_INFO(MODULE_WALLET, "No wallet save found", 0);
+     return false;
+ }
+
+ /**
+  * @brief Write the changed entries and commit a header
+  */
+ bool wallet_storage_save(const WalletSystem *wallet) {
+     if (!wallet || (!s_use_log && !s_store.half_bytes)) return false;
+
+     u32 bytes;
+     bool ok = s_use_log ? wallet_log_commit(&s_log, wallet, &bytes) :
+                           wallet_store_commit(&s_store, wallet, &bytes);
+     if (!ok) {
+         return false;
+     }
+
+     if (bytes) {
+         LOG_INFO(MODULE_WALLET, "Wallet saved (bytes)", bytes);
+     }
+     return true;
+ }
+
+ /**
+  * @brief Mark an entry as changed
+  */
+ void wallet_storage_entry_changed(int index) {
+     if (s_use_log) {
+         wallet_log_entry_changed(&s_log, index);
+         return;
+     }
+     if (index < 0 || index >= WALLET_STORE_ENTRIES) return;
+     bitset_set(s_store.dirty, index);
+ }
+
+ /**
+  * @brief Record that an entry was removed
+  *
+  * The entries after it keep their records; only the map moves.
+  */
+ void wallet_storage_entry_removed(int index) {
+     if (s_use_log) {
+         wallet_log_entry_removed(&s_log, index);
+         return;
+     }
+     if (index < 0 || index >= WALLET_STORE_ENTRIES) return;
+     memmove(&s_store.offset[index], &s_store.offset[index + 1],
+             (WALLET_STORE_ENTRIES - 1 - index) * sizeof(u16));
+     bitset_remove(s_store.dirty, WALLET_STORE_ENTRIES, index);
+     s_store.map_changed = true;
+ }
+
+ /**
+  * @brief Background save upkeep
+  */
+ void wallet_storage_idle(void) {
+     if (s_use_log) {
+         wallet_log_maintain(&s_log);
+     }
+ }
+
+ /**
+  * @brief Sample entries a record half has room for
+  *
+  * Not capped at WALLET_STORE_ENTRIES: this measures the format, not the header.
+  */
+ static u32 wallet_storage_sample_capacity(u32 half_bytes) {
+     u32 used = 0;
+     u32 entries = 0;
+
+     for (;;) {
+         WalletEntry entry;
+         u8 record[WALLET_RECORD_MAX];
+
+         wallet_record_fill_sample(&entry, entries);
+         used += wallet_record_encode(&entry, record) + WALLET_RECORD_OVERHEAD;
+         if (used > half_bytes) break;
+         entries++;
+     }
+
+     return entries;
+ }
+
+ /**
+  * @brief Time saves and a load of a full address book
+  *
+  * Every entry uses the longest strings the fields allow, as many as the
+  * benchmark store takes, so the load is the worst case for boot. The
+  * second save edits one entry, which is what a save after a typical
+  * edit costs.
+  */
+ bool wallet_storage_benchmark(WalletStorageBenchmark *result) {
+     if (!result) return false;
+     memset(result, 0, sizeof(WalletStorageBenchmark));
+
+     if (save_media_type() != SAVE_MEDIA_SRAM) {
+         LOG_ERROR(MODULE_OPTIMIZE, "Storage benchmark needs SRAM", save_media_type());
+         return false;
+     }
+
+     // Entries take less heap than save space, so a half's worth of heap will do
+     WalletStore store;
+     wallet_store_init(&store, WALLET_BENCH_OFFSET, WALLET_BENCH_BYTES);
+
+     u32 mark = mem_arena_mark(&g_mem_frame);
+     WalletSystem *book = mem_arena_alloc(&g_mem_frame, sizeof(WalletSystem));
+     u8 *heap = mem_arena_alloc(&g_mem_frame, store.half_bytes);
+     if (!book || !heap) {
+         mem_arena_release(&g_mem_frame, mark);
+         LOG_ERROR(MODULE_OPTIMIZE, "No room for benchmark wallet", sizeof(WalletSystem));
+         return false;
+     }
+
+     // Start from an empty store so old benchmark headers cannot win
+     u8 zero[WALLET_HEADER_BYTES];
+     memset(zero, 0, sizeof(zero));
+     save_media_write(wallet_header_offset(&store, 0), zero, sizeof(zero));
+     save_media_write(wallet_header_offset(&store, 1), zero, sizeof(zero));
+
+     wallet_book_init(book, heap, store.half_bytes);
+     wallet_store_set_limits(&store, book);
+     for (int i = 0; i < WALLET_STORE_ENTRIES; i++) {
+         WalletEntry entry;
+         wallet_record_fill_max(&entry, i);
+         if (!wallet_book_put(book, i, &entry)) break;
+     }
+     result->entries = book->count;
+
+     profile_start();
+     bool ok = wallet_store_commit(&store, book, &result->save_bytes);
+     result->save_cycles = profile_stop();
+
+     wallet_book_init(book, heap, store.half_bytes);
+
+     profile_start();
+     ok = wallet_store_load(&store, book) && ok;
+     result->load_cycles = profile_stop();
+
+     int count = book->count;
+     ok = ok && count > 0 && count == (int)result->entries;
+
+     if (ok) {
+         WalletEntry entry;
+         u32 len;
+         const u8 *record = wallet_book_record(book, count / 2, &len);
+
+         wallet_record_decode(record, len, &entry);
+         entry.balance++;
+         wallet_store_set_limits(&store, book);
+         ok = wallet_book_put(book, count / 2, &entry);
+         bitset_set(store.dirty, count / 2);
+
+         profile_start();
+         ok = wallet_store_commit(&store, book, &result->edit_save_bytes) && ok;
+         result->edit_save_cycles = profile_stop();
+     }
+
+     mem_arena_release(&g_mem_frame, mark);
+
+     result->sram_sample_entries = wallet_storage_sample_capacity(WALLET_STORE_HALF(WALLET_SRAM_STORE_BYTES));
+     result->load_frames_x100 = (u32)((u64)result->load_cycles * 100 / WALLET_CYCLES_PER_FRAME);
+
+     LOG_INFO(MODULE_OPTIMIZE, "Wallet benchmark entries", result->entries);
+     LOG_INFO(MODULE_OPTIMIZE, "Wallet full save bytes", result->save_bytes);
+     LOG_INFO(MODULE_OPTIMIZE, "Wallet full save cycles", result->save_cycles);
+     LOG_INFO(MODULE_OPTIMIZE, "Wallet load cycles", result->load_cycles);
+     LOG_INFO(MODULE_OPTIMIZE, "Wallet load frames x100", result->load_frames_x100);
+     LOG_INFO(MODULE_OPTIMIZE, "Wallet edit save bytes", result->edit_save_bytes);
+     LOG_INFO(MODULE_OPTIMIZE, "Wallet edit save cycles", result->edit_save_cycles);
+     LOG_INFO(MODULE_OPTIMIZE, "Sample entries per SRAM half", result->sram_sample_entries);
+
+     if (!ok) {
+         LOG_ERROR(MODULE_OPTIMIZE, "Wallet storage benchmark failed", count);
+     }
+     return ok;
+ }
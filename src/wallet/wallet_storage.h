@@ -0,0 +1,144 @@
+/**
+ * @file wallet_storage.h
+ * @brief Wallet persistence on the cartridge save chip
+ *
+ * Entries are stored as the packed records the wallet keeps in RAM (see
+ * wallet_record.h), each with a length and a CRC, in one of two record
+ * halves. A header names the half and where each entry's record is.
+ *
+ * Saves are incremental: only entries changed since the last save are
+ * appended after the records in use, and then a new header is written
+ * over the older of two header copies. When the half is full the whole
+ * wallet is written compacted into the other half instead. Either way
+ * nothing the committed header uses is overwritten, so a save
+ * interrupted by power loss falls back to the state before it.
+ *
+ * The store runs on SRAM and 8 KB EEPROM through save_media.h. Carts
+ * with flash use the log-structured store in wallet_log.h through the
+ * same functions.
+ *
+ * @author Claude
+ * @date October 2026
+ * @version 1.0.0
+ */
+
+ #ifndef WALLET_STORAGE_H
+ #define WALLET_STORAGE_H
+
+ #include <tonc.h>
+ #include "wallet_system.h"
+ #include "wallet_record.h"
+ #include "save_media.h"
+ #include "bitset.h"
+
+ /**
+  * Save image identification
+  */
+ #define WALLET_SAVE_MAGIC       0x4C574247  // "GBWL"
+ #define WALLET_SAVE_VERSION     1           // Packed records in two halves
+
+ /**
+  * Where the stores live in SRAM (on EEPROM the wallet store starts at 0)
+  */
+ #define WALLET_BENCH_OFFSET     0x0000      // Scratch store for the benchmark
+ #define WALLET_BENCH_BYTES      0x2000
+ #define WALLET_STORE_OFFSET     0x2000      // Wallet store, up to the settings area
+
+ /**
+  * Entries a store header has room for; a half runs out of bytes first
+  */
+ #define WALLET_STORE_ENTRIES        255
+
+ /**
+  * Store layout: record half 0, record half 1, header A, header B
+  */
+ #define WALLET_HEADER_CRC_BYTES     (20 + WALLET_STORE_ENTRIES * 2)
+ #define WALLET_HEADER_BYTES         (WALLET_HEADER_CRC_BYTES + 4)
+ #define WALLET_HEADER_SLOT_BYTES    ((WALLET_HEADER_BYTES + 31) & ~31)
+ #define WALLET_RECORD_OVERHEAD      6           // Length u16, CRC-32
+
+ #define WALLET_SRAM_STORE_BYTES     (SAVE_MEDIA_SRAM_SIZE - SAVE_MEDIA_SETTINGS_BYTES - \
+                                      WALLET_STORE_OFFSET)
+ #define WALLET_STORE_HALF(bytes)    ((((bytes) - 2 * WALLET_HEADER_SLOT_BYTES) / 2) & ~3)
+
+ #if WALLET_STORE_HALF(WALLET_SRAM_STORE_BYTES) > 0xFFFF
+ #error "Record offsets are 16 bits"
+ #endif
+
+ /**
+  * Store header (stored byte by byte, little-endian)
+  */
+ typedef struct {
+     u32 magic;                          // WALLET_SAVE_MAGIC
+     u8 version;                         // WALLET_SAVE_VERSION
+     u8 flags;                           // WALLET_SAVE_ENCRYPTED
+     u16 count;                          // Number of entries
+     u16 password_hash;                  // Wallet password hash
+     u8 half;                            // Record half in use
+     u8 reserved;                        // Zero
+     u32 sequence;                       // Incremented by every save; newest valid header wins
+     u16 end;                            // Bytes of the half in use
+     u16 reserved2;                      // Zero
+     u16 offset[WALLET_STORE_ENTRIES];   // Offset of each entry's record in the half
+     u32 crc;                            // CRC-32 of all header bytes before it
+ } WalletSaveHeader;
+
+ /**
+  * Timings of saves and a load of a full address book
+  */
+ typedef struct {
+     u32 entries;                // Maximum-length entries the benchmark store held
+     u32 save_cycles;            // Save with every entry changed
+     u32 save_bytes;             // Bytes written by it
+     u32 load_cycles;            // Read, verify and fill the record heap
+     u32 load_frames_x100;       // Load time in frames, times 100
+     u32 edit_save_cycles;       // Save after editing one entry
+     u32 edit_save_bytes;        // Bytes written by it
+     u32 sram_sample_entries;    // Sample entries the SRAM wallet store has room for
+ } WalletStorageBenchmark;
+
+ /**
+  * Load the wallet from the save chip into the wallet system
+  * Records are checked and copied into the wallet's record heap; without
+  * a valid save the wallet is left empty. Also sets the wallet's limits
+  * to what the chip can hold.
+  * @param wallet Wallet system to fill
+  * @return False if the chip holds no valid save or cannot hold a wallet
+  */
+ bool wallet_storage_load(WalletSystem *wallet);
+
+ /**
+  * Write the entries changed since the last save, then commit a header
+  * Returns at once if nothing changed
+  * @param wallet Wallet system to save
+  * @return False if the save could not be written
+  */
+ bool wallet_storage_save(const WalletSystem *wallet);
+
+ /**
+  * Mark an entry as changed (added or updated)
+  * @param index Entry index
+  */
+ void wallet_storage_entry_changed(int index);
+
+ /**
+  * Record that an entry was removed and the entries after it moved down
+  * @param index Index the entry had
+  */
+ void wallet_storage_entry_removed(int index);
+
+ /**
+  * Background save upkeep; call once per frame when the application is idle
+  * On flash carts this reclaims log space, which can take an erase
+  */
+ void wallet_storage_idle(void);
+
+ /**
+  * Time saves and a load of a full address book of maximum-length entries
+  * Uses the benchmark area of SRAM; the wallet's own save is not touched
+  * @param result Output timings
+  * @return Success status
+  */
+ bool wallet_storage_benchmark(WalletStorageBenchmark *result);
+
+ #endif // WALLET_STORAGE_H
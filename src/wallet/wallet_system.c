@@ -2,6 +2,18 @@
  * @file wallet_system.c
  * @brief Cryptocurrency wallet management system implementation
  *
+ * Entries are kept as packed records (wallet_record.h) in a record heap,
+ * reached through a slot per entry id; a separate array of ids gives the
+ * list order, so deleting or reordering moves two bytes per entry, never
+ * a record. The list screen reads type, favorite flag and name straight
+ * from the records; a full WalletEntry is expanded only for the entry
+ * being shown or edited.
+ *
+ * Filtering goes through bit sets over list positions, one per crypto
+ * type plus one for favorites. A filtered view is the AND of at most two
+ * of them: counting it reads a counter, and ranking, selecting and
+ * stepping through it pop-count 32 entries per word.
+ *
  * @author Claude
  * @date March 2025
  * @version 1.0.0
@@ -9,10 +21,43 @@
 
 #include "wallet_system.h"
 #include "crypto_types.h"
+#include "wallet_record.h"
+#include "wallet_storage.h"
+#include "wallet_search.h"
+#include "gba_sections.h"
+#include "memory_system.h"
+#include <stdio.h>
 #include <string.h>
 
-// Global wallet system instance
-static WalletSystem g_wallet_system;
+// Recently expanded entries kept by wallet_get_entry()
+#define WALLET_ENTRY_CACHE_SIZE 4
+
+// Each heap record is preceded by its id
+#define WALLET_HEAP_HEAD 2
+
+// wallet_system_idle() compacts once this much of the heap is unused
+#define WALLET_HEAP_MIN_GARBAGE (WALLET_HEAP_BYTES / 4)
+
+// Book benchmark: entries, and the share deleted before compacting
+#define WALLET_BENCH_ENTRIES 1000
+#define WALLET_BENCH_DELETES (WALLET_BENCH_ENTRIES / 10)
+
+typedef struct {
+    int index;                      // Entry index
+    u32 generation;                 // Book generation it was expanded in
+    WalletEntry entry;              // Expanded entry
+} WalletEntryCacheSlot;
+
+// Global wallet system instance and its record heap; neither belongs in IWRAM
+EWRAM_BSS static WalletSystem g_wallet_system;
+EWRAM_BSS static u8 s_wallet_heap[WALLET_HEAP_BYTES] ALIGN4;
+EWRAM_BSS static WalletSearch s_wallet_search;
+
+EWRAM_BSS static WalletEntryCacheSlot s_entry_cache[WALLET_ENTRY_CACHE_SIZE];
+static u8 s_entry_cache_next;
+
+// Bumped by every change to a book, which makes all cached entries stale
+static u32 s_book_generation = 1;
 
 /**
  * Simple hash function for password
@@ -29,37 +74,368 @@ static u16 simple_hash(const char* str) {
 }
 
 /**
- * Check if an entry passes current filters
+ * Whether the save chip can hold the book with an entry's record changed
+ *
+ * @param old_len Size of the record replaced (0 when adding)
+ * @param len Size of the new record
+ * @param count Entries the book would have
+ */
+static bool wallet_book_fits_save(const WalletSystem* wallet, u32 old_len, u32 len, int count) {
+    if (count > (wallet->entry_limit ? wallet->entry_limit : MAX_WALLET_ENTRIES)) {
+        return false;
+    }
+
+    return !wallet->record_limit ||
+           wallet->record_bytes - old_len + len + count * wallet->record_overhead <=
+           wallet->record_limit;
+}
+
+/**
+ * Take an id off the free list, or a new one
+ */
+static u16 wallet_book_new_id(WalletSystem* wallet) {
+    u16 id = wallet->free_id;
+
+    if (id != WALLET_ID_NONE) {
+        wallet->free_id = wallet->slot_offset[id];
+        return id;
+    }
+    return wallet->id_count++;
+}
+
+/**
+ * Put an id on the free list
+ */
+static void wallet_book_free_id(WalletSystem* wallet, u16 id) {
+    wallet->slot_len[id] = 0;
+    wallet->slot_offset[id] = wallet->free_id;
+    wallet->free_id = id;
+}
+
+/**
+ * Add an entry to the filter index, or take it out
+ *
+ * @param index List position of the entry
+ * @param add True to add, false to remove
  */
-static bool entry_passes_filter(const WalletEntry* entry) {
-    // Check crypto type filter
-    if (g_wallet_system.active_crypto_filter != 0xFF) {
-        if (entry->type_index != g_wallet_system.active_crypto_filter) {
+static void wallet_index_mark(WalletSystem* wallet, int index, u8 type, bool favorite, bool add) {
+    int delta = add ? 1 : -1;
+
+    if (type < MAX_CRYPTO_TYPES) {
+        if (add) bitset_set(wallet->type_set[type], index);
+        else bitset_clear(wallet->type_set[type], index);
+        wallet->type_count[type] += delta;
+        if (favorite) wallet->favorite_type_count[type] += delta;
+    }
+
+    if (favorite) {
+        if (add) bitset_set(wallet->favorite_set, index);
+        else bitset_clear(wallet->favorite_set, index);
+        wallet->favorite_count += delta;
+    }
+}
+
+/**
+ * Append a record for an id to the heap, compacting first if it is full
+ *
+ * The id's old record stays where it is until this succeeds.
+ */
+static bool wallet_heap_append(WalletSystem* wallet, u16 id, const u8* record, u32 len) {
+    if (wallet->heap_end + WALLET_HEAP_HEAD + len > wallet->heap_bytes) {
+        wallet_book_compact(wallet);
+        if (wallet->heap_end + WALLET_HEAP_HEAD + len > wallet->heap_bytes) {
             return false;
         }
     }
 
-    // Check favorites filter
-    if (g_wallet_system.show_favorites_only && !entry->favorite) {
+    u8* p = wallet->heap + wallet->heap_end;
+    p[0] = id;
+    p[1] = id >> 8;
+    memcpy(p + WALLET_HEAP_HEAD, record, len);
+
+    wallet->slot_offset[id] = wallet->heap_end;
+    wallet->slot_len[id] = len;
+    wallet->heap_end += WALLET_HEAP_HEAD + len;
+    return true;
+}
+
+/**
+ * Add an entry after the last one (save limits already checked)
+ */
+static bool wallet_book_append(WalletSystem* wallet, const u8* record, u32 len) {
+    if (wallet->count >= MAX_WALLET_ENTRIES) {
+        return false;
+    }
+
+    u16 id = wallet_book_new_id(wallet);
+    if (!wallet_heap_append(wallet, id, record, len)) {
+        wallet_book_free_id(wallet, id);
         return false;
     }
 
+    wallet_index_mark(wallet, wallet->count, wallet_record_type(record),
+                      wallet_record_favorite(record), true);
+    wallet->order[wallet->count++] = id;
+    wallet->record_bytes += len;
+    s_book_generation++;
     return true;
 }
 
+/**
+ * Word w of a book's filtered view: bit i is set if entry w * 32 + i
+ * passes the filters. Without filters every bit is set, even past the
+ * last entry; the search set has no bits past it.
+ */
+static u32 wallet_filter_word(const WalletSystem* wallet, u32 w) {
+    u32 word = 0xFFFFFFFFu;
+    u8 type = wallet->active_crypto_filter;
+
+    if (type != WALLET_FILTER_NONE) {
+        word = type < MAX_CRYPTO_TYPES ? wallet->type_set[type][w] : 0;
+    }
+    if (wallet->show_favorites_only) {
+        word &= wallet->favorite_set[w];
+    }
+    if (wallet->search_set) {
+        word &= wallet->search_set[w];
+    }
+
+    return word;
+}
+
+/**
+ * Check if an entry passes a book's filters
+ */
+static bool entry_passes_filter(const WalletSystem* wallet, int index) {
+    if (index < 0 || index >= wallet->count) {
+        return false;
+    }
+
+    return (wallet_filter_word(wallet, index >> 5) >> (index & 31)) & 1;
+}
+
+/**
+ * First entry at or after an index that passes a book's filters
+ *
+ * @return Entry index, or -1 if none
+ */
+static int wallet_filter_next(const WalletSystem* wallet, int from) {
+    if (from < 0) from = 0;
+
+    for (u32 w = from >> 5; w < BITSET_WORDS(wallet->count); w++) {
+        u32 word = wallet_filter_word(wallet, w);
+        if (w == (u32)from >> 5) {
+            word &= ~BITSET_MASK(from & 31);
+        }
+        if (word) {
+            int index = w * 32 + __builtin_ctz(word);
+            return index < wallet->count ? index : -1;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * Last entry at or before an index that passes a book's filters
+ *
+ * @return Entry index, or -1 if none
+ */
+static int wallet_filter_prev(const WalletSystem* wallet, int from) {
+    if (from >= wallet->count) from = wallet->count - 1;
+    if (from < 0) return -1;
+
+    for (int w = from >> 5; w >= 0; w--) {
+        u32 word = wallet_filter_word(wallet, w);
+        if (w == from >> 5 && (from & 31) != 31) {
+            word &= BITSET_MASK((from & 31) + 1);
+        }
+        if (word) {
+            return w * 32 + 31 - __builtin_clz(word);
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * Set up an empty book on a heap
+ */
+void wallet_book_init(WalletSystem* wallet, u8* heap, u32 bytes) {
+    memset(wallet, 0, sizeof(WalletSystem));
+    wallet->heap = heap;
+    wallet->heap_bytes = bytes < WALLET_HEAP_BYTES ? bytes : WALLET_HEAP_BYTES;
+    wallet->selected_index = -1;
+    wallet->active_crypto_filter = WALLET_FILTER_NONE;
+    wallet_book_clear(wallet);
+}
+
+/**
+ * Remove every entry
+ */
+void wallet_book_clear(WalletSystem* wallet) {
+    wallet->count = 0;
+    wallet->heap_end = 0;
+    wallet->garbage = 0;
+    wallet->record_bytes = 0;
+    wallet->free_id = WALLET_ID_NONE;
+    wallet->id_count = 0;
+    memset(wallet->type_set, 0, sizeof(wallet->type_set));
+    memset(wallet->favorite_set, 0, sizeof(wallet->favorite_set));
+    memset(wallet->type_count, 0, sizeof(wallet->type_count));
+    memset(wallet->favorite_type_count, 0, sizeof(wallet->favorite_type_count));
+    wallet->favorite_count = 0;
+    wallet->search_set = NULL;
+    s_book_generation++;
+}
+
+/**
+ * Get the packed record of an entry
+ */
+const u8* wallet_book_record(const WalletSystem* wallet, int index, u32* len) {
+    if (index < 0 || index >= wallet->count) {
+        return NULL;
+    }
+
+    u16 id = wallet->order[index];
+    *len = wallet->slot_len[id];
+    return wallet->heap + wallet->slot_offset[id] + WALLET_HEAP_HEAD;
+}
+
+/**
+ * Append a record read from a save
+ */
+bool wallet_book_load_record(WalletSystem* wallet, const u8* record, u32 len) {
+    if (wallet_record_size(record, len) != len) {
+        return false;
+    }
+
+    return wallet_book_append(wallet, record, len);
+}
+
+/**
+ * Store an entry as a packed record
+ */
+bool wallet_book_put(WalletSystem* wallet, int index, const WalletEntry* entry) {
+    if (index < 0 || index > wallet->count) {
+        return false;
+    }
+
+    u8 record[WALLET_RECORD_MAX];
+    u32 len = wallet_record_encode(entry, record);
+
+    if (index == wallet->count) {
+        return wallet_book_fits_save(wallet, 0, len, wallet->count + 1) &&
+               wallet_book_append(wallet, record, len);
+    }
+
+    u16 id = wallet->order[index];
+    u32 old_len = wallet->slot_len[id];
+    if (!wallet_book_fits_save(wallet, old_len, len, wallet->count)) {
+        return false;
+    }
+
+    // Read before the old record can be overwritten or moved
+    const u8* old_record = wallet->heap + wallet->slot_offset[id] + WALLET_HEAP_HEAD;
+    u8 old_type = wallet_record_type(old_record);
+    bool old_favorite = wallet_record_favorite(old_record);
+
+    // A record of the same size is rewritten in place; any other is appended
+    if (len == old_len) {
+        memcpy(wallet->heap + wallet->slot_offset[id] + WALLET_HEAP_HEAD, record, len);
+    } else {
+        if (!wallet_heap_append(wallet, id, record, len)) {
+            return false;
+        }
+        wallet->garbage += WALLET_HEAP_HEAD + old_len;
+    }
+
+    wallet_index_mark(wallet, index, old_type, old_favorite, false);
+    wallet_index_mark(wallet, index, wallet_record_type(record), wallet_record_favorite(record), true);
+    wallet->record_bytes += len - old_len;
+    s_book_generation++;
+    return true;
+}
+
+/**
+ * Remove an entry
+ */
+bool wallet_book_remove(WalletSystem* wallet, int index) {
+    if (index < 0 || index >= wallet->count) {
+        return false;
+    }
+
+    u16 id = wallet->order[index];
+    const u8* record = wallet->heap + wallet->slot_offset[id] + WALLET_HEAP_HEAD;
+    wallet_index_mark(wallet, index, wallet_record_type(record), wallet_record_favorite(record), false);
+
+    // Entries after it move down in every set; a type with no entries left is all clear
+    for (int type = 0; type < MAX_CRYPTO_TYPES; type++) {
+        if (wallet->type_count[type]) {
+            bitset_remove(wallet->type_set[type], wallet->count, index);
+        }
+    }
+    if (wallet->favorite_count) {
+        bitset_remove(wallet->favorite_set, wallet->count, index);
+    }
+
+    wallet->garbage += WALLET_HEAP_HEAD + wallet->slot_len[id];
+    wallet->record_bytes -= wallet->slot_len[id];
+    wallet_book_free_id(wallet, id);
+
+    memmove(&wallet->order[index], &wallet->order[index + 1],
+            (wallet->count - index - 1) * sizeof(u16));
+    wallet->count--;
+    s_book_generation++;
+    return true;
+}
+
+/**
+ * Slide the records in use over the unused ones
+ *
+ * A record is in use if its id's slot points at it. Unused records are
+ * left whole (an entry is only rewritten in place at the same size), so
+ * their size can be read from the record itself.
+ */
+u32 wallet_book_compact(WalletSystem* wallet) {
+    u8* heap = wallet->heap;
+    u32 src = 0;
+    u32 dst = 0;
+
+    while (src < wallet->heap_end) {
+        u16 id = heap[src] | (heap[src + 1] << 8);
+        bool used = id < wallet->id_count && wallet->slot_len[id] &&
+                    wallet->slot_offset[id] == src;
+        u32 len = used ? wallet->slot_len[id] :
+                  wallet_record_size(heap + src + WALLET_HEAP_HEAD,
+                                     wallet->heap_end - src - WALLET_HEAP_HEAD);
+        u32 size = WALLET_HEAP_HEAD + len;
+
+        if (used) {
+            if (dst != src) {
+                memmove(heap + dst, heap + src, size);
+                wallet->slot_offset[id] = dst;
+            }
+            dst += size;
+        }
+        src += size;
+    }
+
+    u32 reclaimed = wallet->heap_end - dst;
+    wallet->heap_end = dst;
+    wallet->garbage = 0;
+    return reclaimed;
+}
+
 /**
  * Initialize the wallet system
  */
 void wallet_system_init(void) {
-    memset(&g_wallet_system, 0, sizeof(WalletSystem));
-
-    g_wallet_system.count = 0;
-    g_wallet_system.selected_index = -1;
-    g_wallet_system.view_offset = 0;
-    g_wallet_system.is_encrypted = false;
-    g_wallet_system.password_hash = 0;
-    g_wallet_system.active_crypto_filter = 0xFF; // No filter
-    g_wallet_system.show_favorites_only = false;
+    // The book is reset whole; hand back a QR matrix from a previous session first
+    qr_free(&g_wallet_system.qr_state);
+    wallet_book_init(&g_wallet_system, s_wallet_heap, sizeof(s_wallet_heap));
+    qr_init(&g_wallet_system.qr_state);
+    wallet_search_init(&s_wallet_search, &g_wallet_system);
 
     // Initialize crypto types
     crypto_types_init();
@@ -69,18 +445,21 @@ void wallet_system_init(void) {
  * Load wallet data from SRAM
  */
 bool wallet_system_load(void) {
-    // TODO: Implement SRAM loading when GBA SRAM access is available
-    // For now, just return success
-    return true;
+    // Part of boot: log how long a load takes with the current book
+    profile_start();
+    bool loaded = wallet_storage_load(&g_wallet_system);
+    u32 cycles = profile_stop();
+
+    LOG_INFO(MODULE_WALLET, "Wallet load cycles", cycles);
+    wallet_search_init(&s_wallet_search, &g_wallet_system);
+    return loaded;
 }
 
 /**
  * Save wallet data to SRAM
  */
 bool wallet_system_save(void) {
-    // TODO: Implement SRAM saving when GBA SRAM access is available
-    // For now, just return success
-    return true;
+    return wallet_storage_save(&g_wallet_system);
 }
 
 /**
@@ -92,8 +471,12 @@ int wallet_add_entry(const WalletEntry* entry) {
     }
 
     int index = g_wallet_system.count;
-    memcpy(&g_wallet_system.entries[index], entry, sizeof(WalletEntry));
-    g_wallet_system.count++;
+    if (!wallet_book_put(&g_wallet_system, index, entry)) {
+        LOG_WARNING(MODULE_WALLET, "Wallet save space full", index);
+        return -1;
+    }
+    wallet_storage_entry_changed(index);
+    wallet_search_entry_changed(&s_wallet_search, index);
 
     // If this is the first entry, select it
     if (g_wallet_system.selected_index == -1) {
@@ -111,7 +494,12 @@ bool wallet_update_entry(int index, const WalletEntry* entry) {
         return false;
     }
 
-    memcpy(&g_wallet_system.entries[index], entry, sizeof(WalletEntry));
+    if (!wallet_book_put(&g_wallet_system, index, entry)) {
+        LOG_WARNING(MODULE_WALLET, "Wallet save space full", index);
+        return false;
+    }
+    wallet_storage_entry_changed(index);
+    wallet_search_entry_changed(&s_wallet_search, index);
     return true;
 }
 
@@ -123,13 +511,9 @@ bool wallet_delete_entry(int index) {
         return false;
     }
 
-    // Shift all entries after the deleted one
-    for (int i = index; i < g_wallet_system.count - 1; i++) {
-        memcpy(&g_wallet_system.entries[i], &g_wallet_system.entries[i + 1],
-               sizeof(WalletEntry));
-    }
-
-    g_wallet_system.count--;
+    wallet_book_remove(&g_wallet_system, index);
+    wallet_storage_entry_removed(index);
+    wallet_search_entry_removed(&s_wallet_search, index);
 
     // Adjust selected index if necessary
     if (g_wallet_system.selected_index >= g_wallet_system.count) {
@@ -147,11 +531,28 @@ bool wallet_delete_entry(int index) {
  * Get a wallet entry by index
  */
 WalletEntry* wallet_get_entry(int index) {
-    if (index < 0 || index >= g_wallet_system.count) {
+    u32 len;
+    const u8* record = wallet_book_record(&g_wallet_system, index, &len);
+    if (!record) {
         return NULL;
     }
 
-    return &g_wallet_system.entries[index];
+    for (int i = 0; i < WALLET_ENTRY_CACHE_SIZE; i++) {
+        WalletEntryCacheSlot* slot = &s_entry_cache[i];
+        if (slot->generation == s_book_generation && slot->index == index) {
+            return &slot->entry;
+        }
+    }
+
+    WalletEntryCacheSlot* slot = &s_entry_cache[s_entry_cache_next];
+    s_entry_cache_next = (s_entry_cache_next + 1) % WALLET_ENTRY_CACHE_SIZE;
+
+    // Records were checked when they entered the heap
+    memset(&slot->entry, 0, sizeof(WalletEntry));
+    wallet_record_decode(record, len, &slot->entry);
+    slot->index = index;
+    slot->generation = s_book_generation;
+    return &slot->entry;
 }
 
 /**
@@ -161,6 +562,37 @@ WalletEntry* wallet_get_selected_entry(void) {
     return wallet_get_entry(g_wallet_system.selected_index);
 }
 
+/**
+ * Get the type of an entry without expanding it
+ */
+u8 wallet_get_entry_type(int index) {
+    u32 len;
+    const u8* record = wallet_book_record(&g_wallet_system, index, &len);
+    return record ? wallet_record_type(record) : 0xFF;
+}
+
+/**
+ * Check whether an entry is a favorite without expanding it
+ */
+bool wallet_is_favorite(int index) {
+    u32 len;
+    const u8* record = wallet_book_record(&g_wallet_system, index, &len);
+    return record && wallet_record_favorite(record);
+}
+
+/**
+ * Copy the name of an entry without expanding the rest of it
+ */
+bool wallet_get_entry_name(int index, char* name) {
+    u32 len;
+    const u8* record = wallet_book_record(&g_wallet_system, index, &len);
+    if (!record || !wallet_record_name(record, len, name)) {
+        name[0] = '\0';
+        return false;
+    }
+    return true;
+}
+
 /**
  * Select a wallet entry by index
  */
@@ -171,87 +603,141 @@ void wallet_select_entry(int index) {
 }
 
 /**
- * Select the next wallet entry
+ * Count a book's entries that pass its filters
  */
-void wallet_next_entry(void) {
-    int filtered_count = wallet_get_filtered_count();
-    if (filtered_count == 0) return;
+static int wallet_book_filtered_count(const WalletSystem* wallet) {
+    u8 type = wallet->active_crypto_filter;
+
+    // The search has no counts per type, so its view is counted word by word
+    if (wallet->search_set) {
+        int count = 0;
+        for (u32 w = 0; w < BITSET_WORDS(wallet->count); w++) {
+            count += __builtin_popcount(wallet_filter_word(wallet, w));
+        }
+        return count;
+    }
 
-    int current_filtered = wallet_get_filtered_index(g_wallet_system.selected_index);
-    if (current_filtered == -1) current_filtered = 0;
+    if (type == WALLET_FILTER_NONE) {
+        return wallet->show_favorites_only ? wallet->favorite_count : wallet->count;
+    }
+    if (type >= MAX_CRYPTO_TYPES) {
+        return 0;
+    }
 
-    int next_filtered = (current_filtered + 1) % filtered_count;
-    g_wallet_system.selected_index = wallet_get_actual_index(next_filtered);
+    return wallet->show_favorites_only ? wallet->favorite_type_count[type] :
+                                         wallet->type_count[type];
 }
 
 /**
- * Select the previous wallet entry
+ * Convert a filtered index of a book to its actual index
+ *
+ * Whole words are skipped by their pop count; within the word holding
+ * the entry, lower set bits are cleared until it is the lowest.
  */
-void wallet_prev_entry(void) {
-    int filtered_count = wallet_get_filtered_count();
-    if (filtered_count == 0) return;
+static int wallet_book_actual_index(const WalletSystem* wallet, int filtered_index) {
+    if (filtered_index < 0 || filtered_index >= wallet_book_filtered_count(wallet)) {
+        return -1;
+    }
+
+    u32 rank = filtered_index;
+
+    for (u32 w = 0; w < BITSET_WORDS(wallet->count); w++) {
+        u32 word = wallet_filter_word(wallet, w);
+        u32 bits = __builtin_popcount(word);
 
-    int current_filtered = wallet_get_filtered_index(g_wallet_system.selected_index);
-    if (current_filtered == -1) current_filtered = 0;
+        if (rank < bits) {
+            while (rank--) {
+                word &= word - 1;
+            }
+            return w * 32 + __builtin_ctz(word);
+        }
+        rank -= bits;
+    }
 
-    int prev_filtered = (current_filtered - 1 + filtered_count) % filtered_count;
-    g_wallet_system.selected_index = wallet_get_actual_index(prev_filtered);
+    return -1;
 }
 
 /**
- * Get count of entries after applying filters
+ * Convert an actual index of a book to its filtered index
  */
-int wallet_get_filtered_count(void) {
-    int count = 0;
+static int wallet_book_filtered_index(const WalletSystem* wallet, int actual_index) {
+    if (!entry_passes_filter(wallet, actual_index)) {
+        return -1;
+    }
 
-    for (int i = 0; i < g_wallet_system.count; i++) {
-        if (entry_passes_filter(&g_wallet_system.entries[i])) {
-            count++;
-        }
+    u32 last = actual_index >> 5;
+    int filtered_index = __builtin_popcount(wallet_filter_word(wallet, last) &
+                                            BITSET_MASK(actual_index & 31));
+
+    for (u32 w = 0; w < last; w++) {
+        filtered_index += __builtin_popcount(wallet_filter_word(wallet, w));
     }
 
-    return count;
+    return filtered_index;
 }
 
 /**
- * Convert a filtered index to actual index
+ * Move a book's selection through the filtered list
+ *
+ * From an entry in the list this is a search for the nearest set bit,
+ * wrapping at the ends. A selection the filters hide counts as the first
+ * filtered entry.
+ *
+ * @param step 1 for the next entry, -1 for the previous one
  */
-int wallet_get_actual_index(int filtered_index) {
-    int count = 0;
+static void wallet_book_step(WalletSystem* wallet, int step) {
+    int current = wallet->selected_index;
 
-    for (int i = 0; i < g_wallet_system.count; i++) {
-        if (entry_passes_filter(&g_wallet_system.entries[i])) {
-            if (count == filtered_index) {
-                return i;
-            }
-            count++;
-        }
+    if (!entry_passes_filter(wallet, current)) {
+        int filtered_count = wallet_book_filtered_count(wallet);
+        if (filtered_count == 0) return;
+
+        wallet->selected_index = wallet_book_actual_index(wallet, (step + filtered_count) % filtered_count);
+        return;
     }
 
-    return -1;
+    int index = step > 0 ? wallet_filter_next(wallet, current + 1) :
+                           wallet_filter_prev(wallet, current - 1);
+    if (index < 0) {
+        index = step > 0 ? wallet_filter_next(wallet, 0) :
+                           wallet_filter_prev(wallet, wallet->count - 1);
+    }
+    wallet->selected_index = index;
 }
 
 /**
- * Convert an actual index to filtered index
+ * Select the next wallet entry
  */
-int wallet_get_filtered_index(int actual_index) {
-    if (actual_index < 0 || actual_index >= g_wallet_system.count) {
-        return -1;
-    }
+void wallet_next_entry(void) {
+    wallet_book_step(&g_wallet_system, 1);
+}
 
-    if (!entry_passes_filter(&g_wallet_system.entries[actual_index])) {
-        return -1;
-    }
+/**
+ * Select the previous wallet entry
+ */
+void wallet_prev_entry(void) {
+    wallet_book_step(&g_wallet_system, -1);
+}
 
-    int filtered_index = 0;
+/**
+ * Get count of entries after applying filters
+ */
+int wallet_get_filtered_count(void) {
+    return wallet_book_filtered_count(&g_wallet_system);
+}
 
-    for (int i = 0; i < actual_index; i++) {
-        if (entry_passes_filter(&g_wallet_system.entries[i])) {
-            filtered_index++;
-        }
-    }
+/**
+ * Convert a filtered index to actual index
+ */
+int wallet_get_actual_index(int filtered_index) {
+    return wallet_book_actual_index(&g_wallet_system, filtered_index);
+}
 
-    return filtered_index;
+/**
+ * Convert an actual index to filtered index
+ */
+int wallet_get_filtered_index(int actual_index) {
+    return wallet_book_filtered_index(&g_wallet_system, actual_index);
 }
 
 /**
@@ -268,6 +754,34 @@ void wallet_toggle_favorites_filter(void) {
     g_wallet_system.show_favorites_only = !g_wallet_system.show_favorites_only;
 }
 
+/**
+ * Add a character to the search query
+ */
+bool wallet_search_append(char c) {
+    return wallet_search_refine(&s_wallet_search, c);
+}
+
+/**
+ * Remove the last character of the search query
+ */
+void wallet_search_backspace(void) {
+    wallet_search_widen(&s_wallet_search);
+}
+
+/**
+ * Clear the search query
+ */
+void wallet_search_clear(void) {
+    wallet_search_reset(&s_wallet_search);
+}
+
+/**
+ * Get the search query
+ */
+const char* wallet_get_search_query(void) {
+    return s_wallet_search.query;
+}
+
 /**
  * Generate QR code for wallet entry
  */
@@ -277,8 +791,8 @@ bool wallet_generate_qr(int index) {
         return false;
     }
 
-    // Initialize QR state if not already done
-    qr_init(&g_wallet_system.qr_state);
+    // Return the previous entry's matrix to the pool before encoding this one
+    qr_free(&g_wallet_system.qr_state);
 
     // Set the address text
     if (!qr_set_text(&g_wallet_system.qr_state, entry->address)) {
@@ -348,6 +862,154 @@ bool wallet_decrypt_data(void) {
     return true;
 }
 
+/**
+ * Background upkeep
+ */
+void wallet_system_idle(void) {
+    if (g_wallet_system.garbage >= WALLET_HEAP_MIN_GARBAGE) {
+        wallet_book_compact(&g_wallet_system);
+    }
+}
+
+/**
+ * Fill a short benchmark entry
+ *
+ * A name and a lowercase ETH address pack to about 32 bytes, so a
+ * thousand of them fit in the shared scratch.
+ */
+static void wallet_bench_fill(WalletEntry* entry, u32 seed) {
+    static const char HEX[] = "0123456789abcdef";
+    u32 x = seed * 2654435761u + 1;
+
+    memset(entry, 0, sizeof(WalletEntry));
+    snprintf(entry->name, sizeof(entry->name), "#%lu", (unsigned long)seed);
+    entry->address[0] = '0';
+    entry->address[1] = 'x';
+    for (int i = 0; i < 40; i++) {
+        x = x * 1103515245u + 12345;
+        entry->address[2 + i] = HEX[(x >> 16) & 15];
+    }
+    entry->type_index = seed % CRYPTO_TYPE_COUNT;
+    entry->favorite = (seed % 8) == 0;
+}
+
+/**
+ * Time adding, deleting and navigating a thousand entries
+ *
+ * Entries are deleted from positions spread over the list, then added
+ * again, so the adds run into a full heap and compact. The deletes
+ * before the timed compaction leave a tenth of the book unused.
+ */
+bool wallet_book_benchmark(WalletBookBenchmark* result) {
+    if (!result) return false;
+    memset(result, 0, sizeof(WalletBookBenchmark));
+
+    u8* heap = mem_scratch_acquire(MEM_SCRATCH_SIZE, "wallet book benchmark");
+    if (!heap) {
+        LOG_ERROR(MODULE_OPTIMIZE, "Shared scratch busy", 0);
+        return false;
+    }
+
+    u32 mark = mem_arena_mark(&g_mem_frame);
+    WalletSystem* book = mem_arena_alloc(&g_mem_frame, sizeof(WalletSystem));
+    bool ok = book != NULL;
+    u64 total = 0;
+    u32 seed = 0;
+
+    if (ok) {
+        wallet_book_init(book, heap, MEM_SCRATCH_SIZE);
+
+        for (int i = 0; i < WALLET_BENCH_ENTRIES && ok; i++) {
+            WalletEntry entry;
+            wallet_bench_fill(&entry, seed++);
+
+            profile_start();
+            ok = wallet_book_put(book, book->count, &entry);
+            u32 cycles = profile_stop();
+            total += cycles;
+            if (cycles > result->add_max_cycles) result->add_max_cycles = cycles;
+        }
+        result->entries = book->count;
+
+        // Cycle through the whole list once, then the favorites
+        book->selected_index = 0;
+        profile_start();
+        for (int i = 0; i < book->count; i++) {
+            wallet_book_step(book, 1);
+        }
+        result->next_avg_cycles = ok ? profile_stop() / book->count : 0;
+
+        book->show_favorites_only = true;
+        int favorites = wallet_book_filtered_count(book);
+        profile_start();
+        for (int i = 0; i < favorites; i++) {
+            wallet_book_step(book, 1);
+        }
+        u32 cycles = profile_stop();
+        result->next_filtered_avg_cycles = favorites ? cycles / favorites : 0;
+
+        // Look every favorite up by its place in the list, as the rows of the list screen do
+        profile_start();
+        for (int i = 0; i < favorites; i++) {
+            ok = wallet_book_actual_index(book, i) >= 0 && ok;
+        }
+        cycles = profile_stop();
+        result->select_avg_cycles = favorites ? cycles / favorites : 0;
+        book->show_favorites_only = false;
+
+        // Delete half the book from spread positions, then fill it again
+        u64 deletes = 0;
+        for (int i = 0; i < WALLET_BENCH_ENTRIES / 2 && ok; i++) {
+            profile_start();
+            ok = wallet_book_remove(book, (i * 7919) % book->count);
+            cycles = profile_stop();
+            deletes += cycles;
+            if (cycles > result->delete_max_cycles) result->delete_max_cycles = cycles;
+        }
+        result->delete_avg_cycles = deletes / (WALLET_BENCH_ENTRIES / 2);
+
+        for (int i = 0; i < WALLET_BENCH_ENTRIES / 2 && ok; i++) {
+            WalletEntry entry;
+            wallet_bench_fill(&entry, seed++);
+
+            profile_start();
+            ok = wallet_book_put(book, book->count, &entry);
+            cycles = profile_stop();
+            total += cycles;
+            if (cycles > result->add_max_cycles) result->add_max_cycles = cycles;
+        }
+        result->add_avg_cycles = total / (WALLET_BENCH_ENTRIES + WALLET_BENCH_ENTRIES / 2);
+
+        for (int i = 0; i < WALLET_BENCH_DELETES && ok; i++) {
+            ok = wallet_book_remove(book, (i * 7919) % book->count);
+        }
+        profile_start();
+        result->compact_bytes = wallet_book_compact(book);
+        result->compact_cycles = profile_stop();
+
+        ok = ok && book->count == WALLET_BENCH_ENTRIES - WALLET_BENCH_DELETES;
+    }
+
+    mem_arena_release(&g_mem_frame, mark);
+    mem_scratch_release(heap);
+
+    LOG_INFO(MODULE_OPTIMIZE, "Book entries", result->entries);
+    LOG_INFO(MODULE_OPTIMIZE, "Book add avg cycles", result->add_avg_cycles);
+    LOG_INFO(MODULE_OPTIMIZE, "Book add max cycles", result->add_max_cycles);
+    LOG_INFO(MODULE_OPTIMIZE, "Book delete avg cycles", result->delete_avg_cycles);
+    LOG_INFO(MODULE_OPTIMIZE, "Book delete max cycles", result->delete_max_cycles);
+    LOG_INFO(MODULE_OPTIMIZE, "Book next avg cycles", result->next_avg_cycles);
+    LOG_INFO(MODULE_OPTIMIZE, "Book next (favorites) avg cycles", result->next_filtered_avg_cycles);
+    LOG_INFO(MODULE_OPTIMIZE, "Book select (favorites) avg cycles", result->select_avg_cycles);
+    LOG_INFO(MODULE_OPTIMIZE, "Book compact cycles", result->compact_cycles);
+    LOG_INFO(MODULE_OPTIMIZE, "Book compact bytes", result->compact_bytes);
+
+    if (!ok) {
+        LOG_ERROR(MODULE_OPTIMIZE, "Book benchmark failed", result->entries);
+    }
+    return ok;
+}
+
 /**
  * Get global wallet system instance
  */
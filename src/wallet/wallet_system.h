@@ -18,11 +18,30 @@
  #include "qr_system.h"
  #include "qr_debug.h"
  #include "crypto_types.h"
+ #include "bitset.h"
  
  /**
   * Maximum number of wallet entries
+  * How many of them the save chip can hold is set by the save backend
   */
- #define MAX_WALLET_ENTRIES 20
+ #define MAX_WALLET_ENTRIES 1024
+ 
+ /**
+  * Bytes of the record heap the wallet keeps in RAM
+  * Entries are held as compact records (see wallet_record.h) and
+  * expanded only when displayed or edited. Heap offsets are 16 bits.
+  */
+ #define WALLET_HEAP_BYTES 0x10000
+ 
+ /**
+  * Id of no entry (ends the free list)
+  */
+ #define WALLET_ID_NONE 0xFFFF
+ 
+ /**
+  * Crypto type filter value that shows every type
+  */
+ #define WALLET_FILTER_NONE 0xFF
  
  /**
   * Maximum length for wallet entry fields
@@ -60,18 +79,45 @@
  /**
   * Global wallet system state
   * Maintains all wallet entries and system settings
+  *
+  * Each entry has an id that stays the same while it exists. Its record
+  * lives in the heap, preceded by the id; changing an entry's size
+  * appends a new copy. Deleting only marks the id free. Records that are
+  * no longer used stay in the heap until it is compacted.
+  *
+  * The filter index keeps a bit per list position for each crypto type
+  * and for favorites, kept up to date by every change, so the filtered
+  * list is counted, ranked and walked without reading any record. A text
+  * search (see wallet_search.h) narrows it further through search_set.
   */
  typedef struct {
-     WalletEntry entries[MAX_WALLET_ENTRIES]; // Wallet entries
+     u8* heap;                       // Record heap: id u16, packed record, ...
+     u32 heap_bytes;                 // Size of the heap
+     u32 heap_end;                   // First unused heap byte
+     u32 garbage;                    // Heap bytes of records no longer used
+     u32 record_bytes;               // Bytes of the records in use
+     u32 record_limit;               // Save bytes the save chip can hold (0 = no limit)
+     u16 entry_limit;                // Entries the save chip can hold (0 = MAX_WALLET_ENTRIES)
+     u8 record_overhead;             // Save bytes per entry besides its record
+     u16 free_id;                    // First free id (WALLET_ID_NONE if none)
+     u16 id_count;                   // Ids handed out so far
+     u16 slot_offset[MAX_WALLET_ENTRIES]; // Heap offset of each id (next free id if free)
+     u16 slot_len[MAX_WALLET_ENTRIES];    // Record size of each id (0 = free)
+     u16 order[MAX_WALLET_ENTRIES];  // Id of each entry, in list order
+     u32 type_set[MAX_CRYPTO_TYPES][BITSET_WORDS(MAX_WALLET_ENTRIES)]; // Entries of each type
+     u32 favorite_set[BITSET_WORDS(MAX_WALLET_ENTRIES)];               // Favorite entries
+     u16 type_count[MAX_CRYPTO_TYPES];          // Entries of each type
+     u16 favorite_type_count[MAX_CRYPTO_TYPES]; // Favorites of each type
+     u16 favorite_count;             // Favorites of any type
      int count;                      // Current entry count
      int selected_index;             // Currently selected index
      int view_offset;                // Scroll offset for viewing
      bool is_encrypted;              // Whether data is encrypted
      u16 password_hash;              // Simple password hash
-     u8 active_crypto_filter;        // Active crypto type filter
+     u8 active_crypto_filter;        // Active crypto type filter (WALLET_FILTER_NONE = all)
      bool show_favorites_only;       // Show only favorites filter
+     const u32* search_set;          // Entries matching the search query (NULL = no search)
      QrState qr_state;               // QR state for address display
-     u16 qr_buffer[128*128];         // Buffer for QR rendering
  } WalletSystem;
  
  /**
@@ -102,7 +148,7 @@
  /**
   * Add a new wallet entry
   * @param entry Pointer to entry data to add
-  * @return Index of new entry or -1 on failure
+  * @return Index of new entry or -1 on failure (book or save space full)
   */
  int wallet_add_entry(const WalletEntry* entry);
  
@@ -123,6 +169,9 @@
  
  /**
   * Get a wallet entry by index
+  * The entry is expanded from its packed record into a small cache; the
+  * pointer stays valid until the book changes or several other entries
+  * have been fetched. Write changes back with wallet_update_entry().
   * @param index Index of entry to retrieve
   * @return Pointer to entry or NULL if invalid
   */
@@ -134,6 +183,100 @@
   */
  WalletEntry* wallet_get_selected_entry(void);
  
+ /**
+  * Get the type of an entry without expanding it
+  * @param index Entry index
+  * @return Cryptocurrency type index, or 0xFF if invalid
+  */
+ u8 wallet_get_entry_type(int index);
+ 
+ /**
+  * Check whether an entry is a favorite without expanding it
+  * @param index Entry index
+  * @return Whether the entry is marked as favorite
+  */
+ bool wallet_is_favorite(int index);
+ 
+ /**
+  * Copy the name of an entry without expanding the rest of it
+  * @param index Entry index
+  * @param name Output of MAX_NAME_LENGTH characters
+  * @return Success status
+  */
+ bool wallet_get_entry_name(int index, char* name);
+ 
+ /**
+  * Record heap
+  * Used by the save backends to fill and read a wallet's records
+  */
+ 
+ /**
+  * Set up an empty book on a heap
+  * Filters and limits are reset as well
+  * @param wallet Wallet to set up
+  * @param heap Heap memory (word-aligned)
+  * @param bytes Heap size, up to WALLET_HEAP_BYTES
+  */
+ void wallet_book_init(WalletSystem* wallet, u8* heap, u32 bytes);
+ 
+ /**
+  * Remove every entry
+  * @param wallet Wallet to clear
+  */
+ void wallet_book_clear(WalletSystem* wallet);
+ 
+ /**
+  * Get the packed record of an entry
+  * @param wallet Wallet
+  * @param index Entry index
+  * @param len Output: record size in bytes
+  * @return Record bytes, or NULL if invalid
+  */
+ const u8* wallet_book_record(const WalletSystem* wallet, int index, u32* len);
+ 
+ /**
+  * Append a record read from a save
+  * The record's structure is checked first
+  * @param wallet Wallet to append to
+  * @param record Record bytes
+  * @param len Record size in bytes
+  * @return False if the record is damaged or the heap is full
+  */
+ bool wallet_book_load_record(WalletSystem* wallet, const u8* record, u32 len);
+ 
+ /**
+  * Store an entry as a packed record
+  * @param wallet Wallet
+  * @param index Entry to replace, or count to append
+  * @param entry Entry data
+  * @return False if the index is invalid or the record does not fit the
+  *         heap or the save chip
+  */
+ bool wallet_book_put(WalletSystem* wallet, int index, const WalletEntry* entry);
+ 
+ /**
+  * Remove an entry; the entries after it move down
+  * Its record stays in the heap, unused, until the next compaction
+  * @param wallet Wallet
+  * @param index Entry index
+  * @return Success status
+  */
+ bool wallet_book_remove(WalletSystem* wallet, int index);
+ 
+ /**
+  * Slide the records in use over the unused ones
+  * Runs by itself when the heap is too full for a record
+  * @param wallet Wallet
+  * @return Heap bytes reclaimed
+  */
+ u32 wallet_book_compact(WalletSystem* wallet);
+ 
+ /**
+  * Background upkeep; call once per frame when the application is idle
+  * Compacts the heap once a quarter of it is unused
+  */
+ void wallet_system_idle(void);
+ 
  /**
   * Navigation and filtering
   */
@@ -163,7 +306,7 @@
  /**
   * Convert a filtered index to actual index
   * @param filtered_index Index in filtered list
-  * @return Actual index in entries array
+  * @return Actual index in entries array, or -1 if out of range
   */
  int wallet_get_actual_index(int filtered_index);
  
@@ -185,6 +328,30 @@
   */
  void wallet_toggle_favorites_filter(void);
  
+ /**
+  * Add a character to the search query; the filtered list narrows to the
+  * entries whose name, notes or tags hold the query (case ignored)
+  * @param c Character typed
+  * @return False if the query is full
+  */
+ bool wallet_search_append(char c);
+ 
+ /**
+  * Remove the last character of the search query
+  */
+ void wallet_search_backspace(void);
+ 
+ /**
+  * Clear the search query
+  */
+ void wallet_search_clear(void);
+ 
+ /**
+  * Get the search query
+  * @return Query, lowercase (empty if none)
+  */
+ const char* wallet_get_search_query(void);
+ 
  /**
   * QR code display
   */
@@ -249,6 +416,30 @@
   */
  bool wallet_decrypt_data(void);
  
+ /**
+  * Timings of book operations on a thousand entries
+  */
+ typedef struct {
+     u32 entries;                // Entries in the book
+     u32 add_avg_cycles;         // Appending an entry
+     u32 add_max_cycles;         // Slowest append (includes a compaction)
+     u32 delete_avg_cycles;      // Deleting an entry from anywhere in the list
+     u32 delete_max_cycles;
+     u32 next_avg_cycles;        // Selecting the next entry, no filter
+     u32 next_filtered_avg_cycles; // Selecting the next entry with the favorites filter
+     u32 select_avg_cycles;      // Finding an entry by filtered index (a list screen row)
+     u32 compact_cycles;         // Compacting after deleting a tenth of the book
+     u32 compact_bytes;          // Heap bytes that reclaimed
+ } WalletBookBenchmark;
+ 
+ /**
+  * Time adding, deleting and navigating a book of a thousand entries
+  * Uses its own book on the shared scratch; the wallet is not touched
+  * @param result Output timings
+  * @return Success status
+  */
+ bool wallet_book_benchmark(WalletBookBenchmark* result);
+ 
  /**
   * Get global wallet system instance
   * @return Pointer to wallet system